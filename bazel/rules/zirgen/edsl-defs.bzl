@@ -44,6 +44,7 @@ ZIRGEN_OUTS = [
     "types.cuh.inc",
     "types.rs.inc",
     "validity.ir",
+    "validity.zca",
 ]
 
 def _impl(ctx):
@@ -14,6 +14,8 @@
 
 #include "risc0/core/elf.h"
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <set>
 #include <sstream>
@@ -55,6 +57,41 @@ struct ProgHeader {
   uint32_t p_align;
 };
 
+struct SectionHeader {
+  uint32_t sh_name;
+  uint32_t sh_type;
+  uint32_t sh_flags;
+  uint32_t sh_addr;
+  uint32_t sh_offset;
+  uint32_t sh_size;
+  uint32_t sh_link;
+  uint32_t sh_info;
+  uint32_t sh_addralign;
+  uint32_t sh_entsize;
+};
+
+struct SymbolEntry {
+  uint32_t st_name;
+  uint32_t st_value;
+  uint32_t st_size;
+  uint8_t st_info;
+  uint8_t st_other;
+  uint16_t st_shndx;
+};
+
+constexpr uint32_t kSectionSymtab = 2;
+constexpr uint8_t kSymbolFunc = 2;
+
+// Copies a T out of the file at `offset`, checking bounds
+template <typename T> T readAt(const std::vector<uint8_t>& bytes, size_t offset) {
+  if (offset > bytes.size() || bytes.size() - offset < sizeof(T)) {
+    throw std::runtime_error("Truncated elf file");
+  }
+  T out;
+  memcpy(&out, bytes.data() + offset, sizeof(T));
+  return out;
+}
+
 } // namespace
 
 uint32_t loadElf(const std::vector<uint8_t>& elfBytes,
@@ -149,4 +186,71 @@ uint32_t loadElf(const std::vector<uint8_t>& elfBytes,
   return elfHeader.e_entry;
 }
 
+std::vector<ElfSymbol> loadElfSymbols(const std::vector<uint8_t>& elfBytes) {
+  auto elfHeader = readAt<ElfHeader>(elfBytes, 0);
+  if (elfHeader.ei_magic[0] != 0x7f || //
+      elfHeader.ei_magic[1] != 'E' ||  //
+      elfHeader.ei_magic[2] != 'L' ||  //
+      elfHeader.ei_magic[3] != 'F') {
+    throw std::runtime_error("Invalid magic number");
+  }
+  if (elfHeader.ei_class != 1 || elfHeader.ei_data != 1) {
+    throw std::runtime_error("Not a 32 bit little endian elf");
+  }
+  std::vector<ElfSymbol> symbols;
+  if (elfHeader.e_shoff == 0) {
+    return symbols;
+  }
+  if (elfHeader.e_shentsize != sizeof(SectionHeader)) {
+    throw std::runtime_error("Invalid section header size");
+  }
+  auto getSection = [&](size_t idx) {
+    if (idx >= elfHeader.e_shnum) {
+      throw std::runtime_error("Invalid section index");
+    }
+    return readAt<SectionHeader>(elfBytes, elfHeader.e_shoff + idx * sizeof(SectionHeader));
+  };
+  for (size_t i = 0; i < elfHeader.e_shnum; i++) {
+    auto symtab = getSection(i);
+    if (symtab.sh_type != kSectionSymtab) {
+      continue;
+    }
+    auto strtab = getSection(symtab.sh_link);
+    if (strtab.sh_offset > elfBytes.size() ||
+        elfBytes.size() - strtab.sh_offset < strtab.sh_size) {
+      throw std::runtime_error("Truncated string table");
+    }
+    const char* strings = reinterpret_cast<const char*>(elfBytes.data() + strtab.sh_offset);
+    for (size_t off = 0; off + sizeof(SymbolEntry) <= symtab.sh_size; off += sizeof(SymbolEntry)) {
+      auto sym = readAt<SymbolEntry>(elfBytes, symtab.sh_offset + off);
+      if ((sym.st_info & 0xf) != kSymbolFunc || sym.st_name >= strtab.sh_size) {
+        continue;
+      }
+      const char* name = strings + sym.st_name;
+      size_t len = strnlen(name, strtab.sh_size - sym.st_name);
+      symbols.push_back({sym.st_value, sym.st_size, std::string(name, len)});
+    }
+  }
+  std::sort(symbols.begin(), symbols.end(), [](const ElfSymbol& lhs, const ElfSymbol& rhs) {
+    return lhs.addr < rhs.addr;
+  });
+  return symbols;
+}
+
+const ElfSymbol* findElfSymbol(const std::vector<ElfSymbol>& symbols, uint32_t addr) {
+  auto it = std::upper_bound(
+      symbols.begin(), symbols.end(), addr, [](uint32_t addr, const ElfSymbol& sym) {
+        return addr < sym.addr;
+      });
+  if (it == symbols.begin()) {
+    return nullptr;
+  }
+  --it;
+  // Symbols without a size (e.g. from hand written assembly) extend to the next symbol
+  if (it->size && addr - it->addr >= it->size) {
+    return nullptr;
+  }
+  return &*it;
+}
+
 } // namespace risc0
@@ -32,4 +32,19 @@ uint32_t loadElf(const std::vector<uint8_t>& elfBytes,
                  uint32_t minWord = 0,
                  uint32_t maxWord = 0x40000000);
 
+struct ElfSymbol {
+  uint32_t addr;
+  uint32_t size;
+  std::string name;
+};
+
+// Reads the function symbols from the symbol table of an ELF file, sorted by
+// address.  Returns no symbols if the file has been stripped.  Throws
+// std::runtime_error if the file or its symbol table is malformed.
+std::vector<ElfSymbol> loadElfSymbols(const std::vector<uint8_t>& elfBytes);
+
+// Returns the symbol containing `addr`, or nullptr if there is none.
+// `symbols` must be sorted by address.
+const ElfSymbol* findElfSymbol(const std::vector<ElfSymbol>& symbols, uint32_t addr);
+
 } // namespace risc0
@@ -0,0 +1,114 @@
+// Copyright 2024 RISC Zero, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+/// \file
+/// Minimal fork/join helpers for host side data parallel loops.
+///
+/// Example:
+/// \code
+/// parallelFor(0, rows, [&](size_t row) { computeRow(row); });
+/// \endcode
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace risc0 {
+
+namespace detail {
+
+inline std::atomic<size_t>& parallelismOverride() {
+  static std::atomic<size_t> threads{0};
+  return threads;
+}
+
+} // namespace detail
+
+/// Returns the number of worker threads to use for parallel loops.
+inline size_t getParallelism() {
+  if (size_t threads = detail::parallelismOverride()) {
+    return threads;
+  }
+  return std::max<size_t>(1, std::thread::hardware_concurrency());
+}
+
+/// Sets the number of worker threads used by later parallel loops, or restores the default of one
+/// per hardware thread if `threads` is zero.  This lets tests compare a parallel run against a
+/// serial one on any machine.
+inline void setParallelism(size_t threads) {
+  detail::parallelismOverride() = threads;
+}
+
+/// Splits `[begin, end)` into at most `getParallelism()` contiguous blocks of at least `minBlock`
+/// elements and runs `fn(blockBegin, blockEnd)` for each block concurrently.  The first exception
+/// thrown by any block is rethrown on the calling thread once all blocks have finished.
+template <typename F> void parallelForBlocks(size_t begin, size_t end, F fn, size_t minBlock = 1) {
+  if (end <= begin) {
+    return;
+  }
+  size_t count = end - begin;
+  size_t maxBlocks = std::max<size_t>(1, count / std::max<size_t>(1, minBlock));
+  size_t blocks = std::min(getParallelism(), maxBlocks);
+  if (blocks == 1) {
+    fn(begin, end);
+    return;
+  }
+  std::exception_ptr error;
+  std::mutex errorLock;
+  std::vector<std::thread> threads;
+  threads.reserve(blocks - 1);
+  auto runBlock = [&](size_t block) {
+    size_t blockBegin = begin + count * block / blocks;
+    size_t blockEnd = begin + count * (block + 1) / blocks;
+    try {
+      fn(blockBegin, blockEnd);
+    } catch (...) {
+      std::lock_guard<std::mutex> guard(errorLock);
+      if (!error) {
+        error = std::current_exception();
+      }
+    }
+  };
+  for (size_t block = 1; block < blocks; block++) {
+    threads.emplace_back(runBlock, block);
+  }
+  runBlock(0);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+/// Runs `fn(i)` for every `i` in `[begin, end)`, distributing contiguous blocks across threads.
+template <typename F> void parallelFor(size_t begin, size_t end, F fn, size_t minBlock = 1) {
+  parallelForBlocks(
+      begin,
+      end,
+      [&](size_t blockBegin, size_t blockEnd) {
+        for (size_t i = blockBegin; i < blockEnd; i++) {
+          fn(i);
+        }
+      },
+      minBlock);
+}
+
+} // namespace risc0
@@ -19,6 +19,7 @@
 #include "risc0/core/util.h"
 #include "risc0/fp/fpext.h"
 #include "zirgen/Dialect/BigInt/IR/Eval.h"
+#include "zirgen/Dialect/BigInt/IR/Modulus.h"
 
 #include "llvm/Support/Format.h"
 
@@ -92,47 +93,24 @@ BytePoly mul(const BytePoly& lhs, const BytePoly& rhs) {
   return out;
 }
 
-BytePoly nondetQuot(const BytePoly& lhs, const BytePoly& rhs, size_t coeffs) {
-  auto lhsInt = toAPInt(lhs);
-  auto rhsInt = toAPInt(rhs);
-  size_t maxSize = std::max(lhsInt.getBitWidth(), rhsInt.getBitWidth());
-  auto quot = lhsInt.zext(maxSize).udiv(rhsInt.zext(maxSize));
+BytePoly nondetQuot(ModArith& arith, const BytePoly& lhs, const BytePoly& rhs, size_t coeffs) {
+  APInt quot, rem;
+  arith.get(toAPInt(rhs)).divRem(toAPInt(lhs), quot, rem);
   LLVM_DEBUG({ dbgs() << "quot: " << quot << "\n"; });
   return fromAPInt(quot, coeffs);
 }
 
-BytePoly nondetRem(const BytePoly& lhs, const BytePoly& rhs, size_t coeffs) {
-  auto lhsInt = toAPInt(lhs);
-  auto rhsInt = toAPInt(rhs);
-  size_t maxSize = std::max(lhsInt.getBitWidth(), rhsInt.getBitWidth());
-  auto rem = lhsInt.zext(maxSize).urem(rhsInt.zext(maxSize));
+BytePoly nondetRem(ModArith& arith, const BytePoly& lhs, const BytePoly& rhs, size_t coeffs) {
+  APInt quot, rem;
+  arith.get(toAPInt(rhs)).divRem(toAPInt(lhs), quot, rem);
   LLVM_DEBUG({ dbgs() << "rem: " << rem << "\n"; });
   return fromAPInt(rem, coeffs);
 }
 
-BytePoly nondetInv(const BytePoly& lhs, const BytePoly& rhs, size_t coeffs) {
-  // Uses the formula n^(p-2) * n = 1  (mod p) to invert `lhs` (mod `rhs`)
-  // (via the square and multiply technique)
-  auto lhsInt = toAPInt(lhs);
-  auto rhsInt = toAPInt(rhs);
-  size_t maxSize = rhsInt.getBitWidth();
-  APInt inv(2 * maxSize,
-            1); // Initialize inverse to zero, twice the width of `prime` to allow multiplication
-  APInt sqr(lhsInt);              // Will be repeatedly squared
-  APInt position(2 * maxSize, 1); // Bit at `idx` will be 1, other bits will be 0
-  sqr = sqr.zext(2 * maxSize);
-  rhsInt = rhsInt.zext(2 * maxSize);
-  APInt exp = rhsInt - 2;
-  for (size_t idx = 0; idx < maxSize; idx++) {
-    if (exp.intersects(position)) {
-      // multiply in the current power of n (i.e., n^(2^idx))
-      inv = (inv * sqr).urem(rhsInt);
-    }
-    position <<= 1;                 // increment the bit position to test in `exp`
-    sqr = (sqr * sqr).urem(rhsInt); // square `sqr` to increment to `n^(2^(idx+1))`
-  }
-  inv = inv.trunc(maxSize); // We don't need the extra space used as multiply buffer
-  LLVM_DEBUG({ dbgs() << "inv (mod " << rhsInt << "): " << inv << "\n"; });
+BytePoly nondetInv(ModArith& arith, const BytePoly& lhs, const BytePoly& rhs, size_t coeffs) {
+  const ModulusInfo& info = arith.get(toAPInt(rhs));
+  APInt inv = info.inverse(toAPInt(lhs));
+  LLVM_DEBUG({ dbgs() << "inv (mod " << info.modulus << "): " << inv << "\n"; });
   return fromAPInt(inv, coeffs);
 }
 
@@ -193,6 +171,15 @@ EvalOutput eval(func::FuncOp inFunc, BigIntIO& io, bool computeZ) {
 
   llvm::DenseMap<Value, BytePoly> polys;
 
+  // Precompute reduction constants for any moduli which are program constants
+  ModArith arith;
+  inFunc.walk([&](Operation* op) {
+    if (!isa<NondetRemOp, NondetQuotOp, NondetInvOp>(op))
+      return;
+    if (auto constOp = op->getOperand(1).getDefiningOp<ConstOp>())
+      arith.get(constOp.getValue());
+  });
+
   for (Operation& origOp : inFunc.getBody().front().without_terminator()) {
     llvm::TypeSwitch<Operation*>(&origOp)
         .Case<DefOp>([&](auto op) {
@@ -235,19 +222,19 @@ EvalOutput eval(func::FuncOp inFunc, BigIntIO& io, bool computeZ) {
             [&](auto op) { polys[op.getOut()] = mul(polys[op.getLhs()], polys[op.getRhs()]); })
         .Case<NondetRemOp>([&](auto op) {
           uint32_t coeffs = op.getOut().getType().getCoeffs();
-          auto poly = nondetRem(polys[op.getLhs()], polys[op.getRhs()], coeffs);
+          auto poly = nondetRem(arith, polys[op.getLhs()], polys[op.getRhs()], coeffs);
           polys[op.getOut()] = poly;
           ret.privateWitness.push_back(poly);
         })
         .Case<NondetQuotOp>([&](auto op) {
           uint32_t coeffs = op.getOut().getType().getCoeffs();
-          auto poly = nondetQuot(polys[op.getLhs()], polys[op.getRhs()], coeffs);
+          auto poly = nondetQuot(arith, polys[op.getLhs()], polys[op.getRhs()], coeffs);
           polys[op.getOut()] = poly;
           ret.privateWitness.push_back(poly);
         })
         .Case<NondetInvOp>([&](auto op) {
           uint32_t coeffs = op.getOut().getType().getCoeffs();
-          auto poly = nondetInv(polys[op.getLhs()], polys[op.getRhs()], coeffs);
+          auto poly = nondetInv(arith, polys[op.getLhs()], polys[op.getRhs()], coeffs);
           polys[op.getOut()] = poly;
           ret.privateWitness.push_back(poly);
         })
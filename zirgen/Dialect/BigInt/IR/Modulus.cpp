@@ -0,0 +1,122 @@
+// Copyright 2024 RISC Zero, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "zirgen/Dialect/BigInt/IR/Modulus.h"
+
+using namespace llvm;
+
+namespace zirgen::BigInt {
+
+ModulusInfo::ModulusInfo(const APInt& value) {
+  k = std::max(value.getActiveBits(), 1u);
+  modulus = value.zextOrTrunc(k);
+  if (k >= 2) {
+    unsigned width = 2 * k + 4;
+    mu = APInt::getOneBitSet(width, 2 * k).udiv(modulus.zext(width));
+  }
+}
+
+void ModulusInfo::divRem(const APInt& x, APInt& quot, APInt& rem) const {
+  if (!hasBarrett() || x.getActiveBits() > 2 * k) {
+    // Out of range for Barrett reduction; fall back to long division.
+    unsigned width = std::max(x.getBitWidth(), k);
+    APInt::udivrem(x.zextOrTrunc(width), modulus.zextOrTrunc(width), quot, rem);
+    return;
+  }
+  unsigned width = 2 * k + 4;
+  APInt xw = x.zextOrTrunc(width);
+  APInt mw = modulus.zext(width);
+  APInt q = (xw.lshr(k - 1) * mu).lshr(k + 1);
+  APInt r = xw - q * mw;
+  // The Barrett estimate is at most two less than the true quotient
+  while (r.uge(mw)) {
+    r -= mw;
+    q += 1;
+  }
+  quot = q;
+  rem = r;
+}
+
+APInt ModulusInfo::inverse(const APInt& x) const {
+  APInt quot, rem;
+  divRem(x, quot, rem);
+  if (!modulus[0]) {
+    // Binary extended GCD requires an odd modulus
+    return fermatInverse(rem);
+  }
+  unsigned width = k + 1;
+  APInt m = modulus.zext(width);
+  APInt u = rem.zextOrTrunc(width);
+  APInt v = m;
+  APInt x1(width, 1);
+  APInt x2(width, 0);
+  auto halve = [&](APInt& val, APInt& coeff) {
+    while (!val[0]) {
+      val.lshrInPlace(1);
+      if (coeff[0]) {
+        coeff += m;
+      }
+      coeff.lshrInPlace(1);
+    }
+  };
+  auto subMod = [&](APInt& lhs, const APInt& rhs) {
+    if (lhs.uge(rhs)) {
+      lhs -= rhs;
+    } else {
+      lhs += m - rhs;
+    }
+  };
+  while (!u.isOne() && !v.isOne()) {
+    if (u.isZero() || v.isZero()) {
+      return APInt(k, 0);
+    }
+    halve(u, x1);
+    halve(v, x2);
+    if (u.uge(v)) {
+      u -= v;
+      subMod(x1, x2);
+    } else {
+      v -= u;
+      subMod(x2, x1);
+    }
+  }
+  return (u.isOne() ? x1 : x2).trunc(k);
+}
+
+APInt ModulusInfo::fermatInverse(const APInt& x) const {
+  unsigned width = 2 * k;
+  APInt m = modulus.zext(width);
+  APInt inv(width, 1);
+  APInt sqr = x.zextOrTrunc(width);
+  APInt exp = m - 2;
+  for (unsigned idx = 0; idx < k; idx++) {
+    if (exp[idx]) {
+      // multiply in the current power of n (i.e., n^(2^idx))
+      inv = (inv * sqr).urem(m);
+    }
+    sqr = (sqr * sqr).urem(m); // square `sqr` to increment to `n^(2^(idx+1))`
+  }
+  return inv.trunc(k);
+}
+
+const ModulusInfo& ModArith::get(const APInt& modulus) {
+  APInt key = modulus.zextOrTrunc(std::max(modulus.getActiveBits(), 1u));
+  auto it = cache.find(key);
+  if (it == cache.end()) {
+    it = cache.try_emplace(key, key).first;
+  }
+  return it->second;
+}
+
+} // namespace zirgen::BigInt
@@ -0,0 +1,59 @@
+// Copyright 2024 RISC Zero, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "llvm/ADT/APInt.h"
+#include "llvm/ADT/DenseMap.h"
+
+namespace zirgen::BigInt {
+
+// Per-modulus constants used to speed up the nondeterministic modular
+// operations.  These are computed once per modulus and cached for the
+// duration of an evaluation.
+struct ModulusInfo {
+  llvm::APInt modulus;
+  // Number of significant bits in the modulus
+  unsigned k = 0;
+  // Barrett constant floor(2^(2k) / modulus), or zero if Barrett reduction
+  // isn't applicable to this modulus.
+  llvm::APInt mu;
+
+  explicit ModulusInfo(const llvm::APInt& value);
+
+  bool hasBarrett() const { return k >= 2; }
+
+  // Computes the quotient and remainder of `x` divided by the modulus.
+  void divRem(const llvm::APInt& x, llvm::APInt& quot, llvm::APInt& rem) const;
+
+  // Inverts `x` modulo the modulus using the binary extended GCD algorithm.
+  // Returns zero if `x` is not invertible.
+  llvm::APInt inverse(const llvm::APInt& x) const;
+
+  // Uses the formula n^(p-2) * n = 1  (mod p) to invert `x` (mod `modulus`)
+  // (via the square and multiply technique)
+  llvm::APInt fermatInverse(const llvm::APInt& x) const;
+};
+
+// Caches modulus constants across all the nondeterministic operations in a
+// program, keyed by the value of the modulus.
+class ModArith {
+public:
+  const ModulusInfo& get(const llvm::APInt& modulus);
+
+private:
+  llvm::DenseMap<llvm::APInt, ModulusInfo> cache;
+};
+
+} // namespace zirgen::BigInt
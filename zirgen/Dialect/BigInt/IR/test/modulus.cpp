@@ -0,0 +1,271 @@
+// Copyright 2024 RISC Zero, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <random>
+
+#include <gtest/gtest.h>
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringExtras.h"
+
+#include "zirgen/Dialect/BigInt/IR/Modulus.h"
+
+using namespace llvm;
+using namespace zirgen::BigInt;
+
+namespace {
+
+std::mt19937_64 rng(2024);
+
+APInt randomInt(unsigned bits) {
+  SmallVector<uint64_t> words((bits + 63) / 64);
+  for (auto& word : words) {
+    word = rng();
+  }
+  return APInt(bits, words);
+}
+
+// Picks a random modulus with exactly `bits` significant bits.
+APInt randomModulus(unsigned bits) {
+  APInt m = randomInt(bits);
+  m.setBit(bits - 1);
+  return m;
+}
+
+APInt fromString(StringRef str) {
+  return APInt(str.size() * 4 + 4, str, 16);
+}
+
+// The plain long division the evaluator used before moduli were cached.
+void refDivRem(const APInt& x, const APInt& m, APInt& quot, APInt& rem) {
+  unsigned width = std::max(x.getBitWidth(), m.getBitWidth());
+  quot = x.zext(width).udiv(m.zext(width));
+  rem = x.zext(width).urem(m.zext(width));
+}
+
+// The square and multiply inverse the evaluator used before moduli were
+// cached.
+APInt refInverse(const APInt& x, const APInt& m) {
+  unsigned maxSize = m.getBitWidth();
+  APInt inv(2 * maxSize, 1);
+  APInt sqr = x.zextOrTrunc(2 * maxSize);
+  APInt mod = m.zext(2 * maxSize);
+  APInt exp = mod - 2;
+  for (unsigned idx = 0; idx < maxSize; idx++) {
+    if (exp[idx]) {
+      inv = (inv * sqr).urem(mod);
+    }
+    sqr = (sqr * sqr).urem(mod);
+  }
+  return inv.trunc(maxSize);
+}
+
+void checkDivRem(const ModulusInfo& info, const APInt& x) {
+  APInt quot, rem, refQuot, refRem;
+  info.divRem(x, quot, rem);
+  refDivRem(x, info.modulus, refQuot, refRem);
+  unsigned width = std::max({quot.getBitWidth(), refQuot.getBitWidth(), x.getBitWidth()});
+  EXPECT_EQ(quot.zext(width), refQuot.zext(width))
+      << "x = " << toString(x, 16, false) << ", m = " << toString(info.modulus, 16, false);
+  EXPECT_EQ(rem.zext(width), refRem.zext(width))
+      << "x = " << toString(x, 16, false) << ", m = " << toString(info.modulus, 16, false);
+}
+
+// Checks inverse() against the old Fermat inverse, which is only correct for
+// prime moduli.
+void checkPrimeInverse(const APInt& prime, const APInt& x) {
+  ModulusInfo info(prime);
+  APInt inv = info.inverse(x);
+  APInt quot, rem;
+  refDivRem(x, info.modulus, quot, rem);
+  APInt ref = refInverse(rem.zextOrTrunc(info.k), info.modulus);
+  EXPECT_EQ(inv, ref.zextOrTrunc(inv.getBitWidth()))
+      << "x = " << toString(x, 16, false) << ", m = " << toString(prime, 16, false);
+}
+
+// Checks inverse() by multiplying back, or that it returns zero when `x`
+// shares a factor with the modulus.
+void checkInverse(const ModulusInfo& info, const APInt& x) {
+  APInt inv = info.inverse(x);
+  unsigned width = std::max(x.getBitWidth(), info.k) * 2;
+  APInt m = info.modulus.zext(width);
+  APInt xr = x.zext(width).urem(m);
+  if (APIntOps::GreatestCommonDivisor(xr, m).isOne()) {
+    EXPECT_EQ((xr * inv.zext(width)).urem(m), APInt(width, 1).urem(m))
+        << "x = " << toString(x, 16, false) << ", m = " << toString(info.modulus, 16, false);
+  } else {
+    EXPECT_TRUE(inv.isZero()) << "x = " << toString(x, 16, false)
+                              << ", m = " << toString(info.modulus, 16, false);
+  }
+}
+
+} // namespace
+
+TEST(BigIntModulus, DivRemRandom) {
+  for (unsigned bits : {2, 3, 8, 31, 64, 65, 127, 256, 384}) {
+    for (size_t i = 0; i < 20; i++) {
+      APInt m = randomModulus(bits);
+      if (i % 2) {
+        // Cover even moduli too
+        m.clearBit(0);
+      }
+      ModulusInfo info(m);
+      ASSERT_TRUE(info.hasBarrett());
+      for (unsigned xbits : {1u, bits - 1 ? bits - 1 : 1, bits, bits + 1, 2 * bits - 1, 2 * bits}) {
+        checkDivRem(info, randomInt(xbits));
+      }
+      // Too wide for Barrett reduction; takes the long division path
+      checkDivRem(info, randomInt(2 * bits + 1));
+      checkDivRem(info, randomInt(4 * bits + 7));
+    }
+  }
+}
+
+TEST(BigIntModulus, DivRemBarrettBoundary) {
+  for (unsigned bits : {2, 3, 17, 64, 255, 256}) {
+    for (size_t i = 0; i < 10; i++) {
+      APInt m = randomModulus(bits);
+      if (i == 0) {
+        // Smallest and largest moduli with `bits` significant bits
+        m = APInt::getOneBitSet(bits, bits - 1);
+      } else if (i == 1) {
+        m = APInt::getAllOnes(bits);
+      }
+      ModulusInfo info(m);
+      unsigned width = 2 * bits + 1;
+      APInt shifted = m.zext(width).shl(bits);
+      // x = m * 2^k - 1 is the largest multiple boundary within 2k bits
+      checkDivRem(info, shifted - 1);
+      checkDivRem(info, shifted);
+      checkDivRem(info, shifted + 1);
+      checkDivRem(info, APInt::getAllOnes(2 * bits));
+      checkDivRem(info, APInt::getOneBitSet(width, 2 * bits));
+      checkDivRem(info, m - 1);
+      checkDivRem(info, m);
+      checkDivRem(info, APInt(bits, 0));
+    }
+  }
+}
+
+TEST(BigIntModulus, ModulusOne) {
+  ModulusInfo info(APInt(64, 1));
+  EXPECT_FALSE(info.hasBarrett());
+  for (unsigned bits : {1, 7, 64, 200}) {
+    APInt x = randomInt(bits);
+    checkDivRem(info, x);
+    EXPECT_TRUE(info.inverse(x).isZero());
+    EXPECT_EQ(info.inverse(x), refInverse(x, info.modulus).zextOrTrunc(info.k));
+  }
+}
+
+TEST(BigIntModulus, WideInputWidth) {
+  // Moduli arrive with the width of their BytePoly, well above their value
+  ModulusInfo info(APInt(512, 1000003));
+  EXPECT_EQ(info.k, 20u);
+  checkDivRem(info, APInt(512, 123456789012345ull));
+  checkPrimeInverse(APInt(512, 1000003), APInt(512, 123456789012345ull));
+}
+
+TEST(BigIntModulus, PrimeInverseMatchesFermat) {
+  std::vector<APInt> primes = {
+      APInt(8, 3),
+      APInt(8, 5),
+      APInt(8, 251),
+      APInt(32, 65537),
+      APInt(32, 15 * (1 << 27) + 1),
+      APInt::getAllOnes(61),
+      APInt::getAllOnes(127),
+      // secp256k1 field prime
+      fromString("fffffffffffffffffffffffffffffffffffffffffffffffffffffffefffffc2f"),
+      // secp256k1 group order
+      fromString("fffffffffffffffffffffffffffffffebaaedce6af48a03bbfd25e8cd0364141"),
+  };
+  for (const APInt& prime : primes) {
+    unsigned bits = prime.getActiveBits();
+    for (size_t i = 0; i < 20; i++) {
+      checkPrimeInverse(prime, randomInt(bits));
+      checkPrimeInverse(prime, randomInt(2 * bits + 3));
+    }
+    checkPrimeInverse(prime, APInt(bits, 1));
+    checkPrimeInverse(prime, prime - 1);
+    checkPrimeInverse(prime, prime + 1);
+  }
+}
+
+TEST(BigIntModulus, EvenModulusInverseMatchesFermat) {
+  // Even moduli keep using the square and multiply inverse
+  for (unsigned bits : {2, 9, 64, 256}) {
+    for (size_t i = 0; i < 10; i++) {
+      APInt m = randomModulus(bits);
+      m.clearBit(0);
+      ModulusInfo info(m);
+      APInt x = randomInt(bits + 5);
+      APInt quot, rem;
+      refDivRem(x, m, quot, rem);
+      EXPECT_EQ(info.inverse(x), refInverse(rem.zextOrTrunc(bits), m));
+    }
+  }
+}
+
+TEST(BigIntModulus, OddModulusInverse) {
+  for (unsigned bits : {2, 3, 16, 64, 130, 256}) {
+    for (size_t i = 0; i < 20; i++) {
+      APInt m = randomModulus(bits);
+      m.setBit(0);
+      ModulusInfo info(m);
+      checkInverse(info, randomInt(bits));
+      checkInverse(info, randomInt(2 * bits + 1));
+    }
+  }
+}
+
+TEST(BigIntModulus, NonInvertible) {
+  // 3 * 5 * 7 * 11 * 13
+  ModulusInfo info(APInt(32, 15015));
+  for (uint64_t x : {0ull, 3ull, 5ull, 77ull, 15015ull, 30030ull, 3003ull * 4}) {
+    EXPECT_TRUE(info.inverse(APInt(32, x)).isZero()) << x;
+  }
+  for (uint64_t x : {1ull, 2ull, 4ull, 15014ull, 15016ull}) {
+    checkInverse(info, APInt(32, x));
+  }
+
+  // Zero never has an inverse, even modulo a prime
+  ModulusInfo prime(APInt::getAllOnes(127));
+  EXPECT_TRUE(prime.inverse(APInt(127, 0)).isZero());
+  EXPECT_TRUE(prime.inverse(APInt::getAllOnes(127)).isZero());
+
+  // Random composite moduli with a shared factor
+  for (unsigned bits : {16, 64, 200}) {
+    for (size_t i = 0; i < 10; i++) {
+      APInt a = randomModulus(bits);
+      a.setBit(0);
+      APInt b = randomModulus(bits);
+      b.setBit(0);
+      APInt factor = randomModulus(bits / 2);
+      factor.setBit(0);
+      unsigned width = 2 * bits + bits / 2;
+      ModulusInfo info(a.zext(width) * factor.zext(width));
+      checkInverse(info, b.zext(width) * factor.zext(width));
+    }
+  }
+}
+
+TEST(BigIntModulus, CacheKeyIgnoresWidth) {
+  ModArith arith;
+  const ModulusInfo& narrow = arith.get(APInt(32, 65537));
+  const ModulusInfo& wide = arith.get(APInt(256, 65537));
+  EXPECT_EQ(&narrow, &wide);
+  EXPECT_EQ(wide.k, 17u);
+  EXPECT_NE(&arith.get(APInt(32, 65539)), &narrow);
+}
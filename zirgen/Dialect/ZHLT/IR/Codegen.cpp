@@ -81,6 +81,23 @@ struct CppEmitZhlt : public EmitZhlt {
     }
     return success();
   }
+
+  LogicalResult emitStepRows() override {
+    auto stepTop = module.lookupSymbol<StepFuncOp>("step$Top");
+    if (!stepTop)
+      return success();
+    auto name = CodegenIdent<IdentKind::Func>(stepTop.getNameAttr());
+    // The context is moved from row to row, and everything else (the buffers in
+    // particular) is set up once for the whole range.
+    cg << "template <typename Context, typename... Bufs>\n";
+    cg << "void " << name << "_rows(Context& ctx, size_t begin, size_t end, Bufs... bufs) {\n";
+    cg << "  for (size_t cycle = begin; cycle != end; cycle++) {\n";
+    cg << "    ctx.setCycle(cycle);\n";
+    cg << "    " << name << "(ctx, bufs...);\n";
+    cg << "  }\n";
+    cg << "}\n";
+    return success();
+  }
 };
 
 } // namespace
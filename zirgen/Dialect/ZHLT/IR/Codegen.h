@@ -34,6 +34,10 @@ public:
     return mlir::success();
   }
 
+  // Emits an entry point which runs step$Top over a range of rows, for circuits
+  // whose rows can be generated independently (built with --parallel-witgen).
+  virtual mlir::LogicalResult emitStepRows() { return mlir::success(); }
+
 protected:
   virtual mlir::LogicalResult emitBufferList(llvm::ArrayRef<Zll::BufferDescAttr> bufs) {
     return mlir::success();
@@ -58,10 +58,11 @@ class ZhltInlinerInterface : public DialectInlinerInterface {
     // ReturnOp is the only teriminator in the dialect
     auto returnOp = cast<Zhlt::ReturnOp>(op);
 
-    // Replace the values directly with the return operand.
+    // Replace the values directly with the return operands.
     if (!valuesToRepl.empty()) {
-      assert(valuesToRepl.size() == 1);
-      valuesToRepl[0].replaceAllUsesWith(returnOp.getValue());
+      for (auto [value, returned] : llvm::zip_equal(valuesToRepl, returnOp.getValues())) {
+        value.replaceAllUsesWith(returned);
+      }
     }
   }
 };
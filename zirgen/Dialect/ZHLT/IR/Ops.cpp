@@ -33,6 +33,15 @@ mlir::LogicalResult MagicOp::verify() {
   return emitError() << "a MagicOp is never valid";
 }
 
+mlir::LogicalResult ReturnOp::verify() {
+  // Only step functions, whose parts may be outlined by split-step-funcs,
+  // return more than one value.
+  if (getValues().size() > 1 && !llvm::isa<StepFuncOp>((*this)->getParentOp())) {
+    return emitError() << "a component constructor returns at most one value";
+  }
+  return success();
+}
+
 mlir::LogicalResult BackOp::verify() {
   if (getLayout()) {
     auto layoutType = getLayout().getType();
@@ -0,0 +1,6 @@
+// RUN: zirgen-opt --verify-diagnostics %s
+
+zhlt.component @TwoValues(%arg0: !zll.val<BabyBear>) -> !zll.val<BabyBear> {
+  // expected-error@+1 {{a component constructor returns at most one value}}
+  zhlt.return %arg0, %arg0 : !zll.val<BabyBear>, !zll.val<BabyBear>
+}
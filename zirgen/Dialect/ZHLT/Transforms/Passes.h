@@ -28,6 +28,7 @@ std::unique_ptr<mlir::OperationPass<mlir::ModuleOp>> createBuffersToArgsPass();
 std::unique_ptr<mlir::OperationPass<mlir::ModuleOp>> createAnalyzeBuffersPass();
 std::unique_ptr<mlir::OperationPass<mlir::ModuleOp>> createOptimizeParWitgenPass();
 std::unique_ptr<mlir::OperationPass<mlir::ModuleOp>> createOutlineIfsPass();
+std::unique_ptr<mlir::OperationPass<mlir::ModuleOp>> createSplitStepFuncsPass(size_t maxOps = 5000);
 
 #define GEN_PASS_REGISTRATION
 #include "zirgen/Dialect/ZHLT/Transforms/Passes.h.inc"
@@ -0,0 +1,295 @@
+// Copyright 2024 RISC Zero, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mlir/IR/IRMapping.h"
+#include "mlir/Interfaces/SideEffectInterfaces.h"
+#include "llvm/ADT/DenseMap.h"
+
+#include "zirgen/Dialect/ZHLT/IR/ZHLT.h"
+#include "zirgen/Dialect/ZHLT/Transforms/PassDetail.h"
+
+#include <algorithm>
+#include <functional>
+#include <optional>
+
+using namespace mlir;
+using namespace zirgen::Zll;
+using namespace zirgen::ZStruct;
+
+namespace zirgen::Zhlt {
+
+namespace {
+
+// Splits the top level of a single step function into pieces of roughly
+// `maxOps` operations each.  The first piece stays in the original function,
+// and each of the others is outlined into its own step function which takes
+// the values it uses as arguments and returns the values used after it.
+class FuncSplitter {
+public:
+  FuncSplitter(StepFuncOp funcOp, size_t maxOps) : funcOp(funcOp), maxOps(maxOps) {}
+
+  void run();
+
+private:
+  bool isRematerializable(Operation* op);
+  void analyze();
+  SmallVector<size_t> chooseCuts();
+  void outlinePart(ArrayRef<Operation*> partOps, size_t partIdx);
+
+  StepFuncOp funcOp;
+  size_t maxOps;
+
+  // Top level operations of the function, excluding the terminator
+  SmallVector<Operation*> ops;
+  // prefixWeight[i] is the number of operations (including nested ones) in ops[0..i)
+  SmallVector<size_t> prefixWeight;
+  // live[i] is the number of values which would have to be passed between
+  // parts if we cut just before ops[i]
+  SmallVector<size_t> live;
+  // unpassable[i] is the number of those which can't be returned from a function
+  SmallVector<size_t> unpassable;
+
+  DenseMap<Operation*, bool> rematerializable;
+};
+
+// Constants and layouts are cheaper to recompute in each part that uses them
+// than to pass around, and layouts can't be returned from a step function.
+bool FuncSplitter::isRematerializable(Operation* op) {
+  auto it = rematerializable.find(op);
+  if (it != rematerializable.end())
+    return it->second;
+
+  bool result = op->getNumRegions() == 0 && op->getNumResults() == 1 && isPure(op) &&
+                (op->hasTrait<OpTrait::ConstantLike>() ||
+                 op->getResult(0).getType().hasTrait<CodegenLayoutTypeTrait>());
+  for (Value operand : op->getOperands()) {
+    if (!result)
+      break;
+    if (auto arg = llvm::dyn_cast<BlockArgument>(operand))
+      result = arg.getOwner() == &funcOp.getBody().front();
+    else
+      result = isRematerializable(operand.getDefiningOp());
+  }
+  rematerializable[op] = result;
+  return result;
+}
+
+void FuncSplitter::analyze() {
+  Block* body = &funcOp.getBody().front();
+  DenseMap<Operation*, size_t> index;
+  for (Operation& op : body->without_terminator()) {
+    index[&op] = ops.size();
+    ops.push_back(&op);
+  }
+  size_t n = ops.size();
+
+  prefixWeight.assign(n + 1, 0);
+  for (size_t i = 0; i != n; ++i) {
+    size_t weight = 0;
+    ops[i]->walk([&](Operation*) { ++weight; });
+    prefixWeight[i + 1] = prefixWeight[i] + weight;
+  }
+
+  // A value defined by ops[def] and last used by ops[lastUse] has to be
+  // passed across every cut in (def, lastUse]; accumulate these as
+  // differences and then sum them up.  Uses by the terminator count as uses
+  // after the last operation.
+  SmallVector<ptrdiff_t> liveDelta(n + 2, 0);
+  SmallVector<ptrdiff_t> unpassableDelta(n + 2, 0);
+  for (size_t def = 0; def != n; ++def) {
+    if (isRematerializable(ops[def]))
+      continue;
+    for (Value result : ops[def]->getResults()) {
+      size_t lastUse = def;
+      for (Operation* user : result.getUsers()) {
+        auto it = index.find(body->findAncestorOpInBlock(*user));
+        lastUse = std::max(lastUse, it == index.end() ? n : it->second);
+      }
+      if (lastUse == def)
+        continue;
+      liveDelta[def + 1]++;
+      liveDelta[lastUse + 1]--;
+      if (result.getType().hasTrait<CodegenLayoutTypeTrait>()) {
+        unpassableDelta[def + 1]++;
+        unpassableDelta[lastUse + 1]--;
+      }
+    }
+  }
+
+  live.assign(n + 1, 0);
+  unpassable.assign(n + 1, 0);
+  ptrdiff_t curLive = 0, curUnpassable = 0;
+  for (size_t i = 0; i <= n; ++i) {
+    curLive += liveDelta[i];
+    curUnpassable += unpassableDelta[i];
+    live[i] = curLive;
+    unpassable[i] = curUnpassable;
+  }
+}
+
+// Chooses where to start each part after the first.  Each cut is placed
+// within a window around its evenly balanced position, at the point where
+// the fewest values are live across it.
+SmallVector<size_t> FuncSplitter::chooseCuts() {
+  size_t n = ops.size();
+  size_t total = prefixWeight.back();
+  size_t nparts = (total + maxOps - 1) / maxOps;
+  if (nparts < 2 || n < 2)
+    return {};
+
+  size_t window = total / nparts / 4;
+  SmallVector<size_t> cuts;
+  size_t prev = 0;
+  for (size_t k = 1; k != nparts; ++k) {
+    size_t target = total * k / nparts;
+    size_t lo = std::lower_bound(prefixWeight.begin(),
+                                 prefixWeight.end(),
+                                 target > window ? target - window : 0) -
+                prefixWeight.begin();
+    size_t hi =
+        std::upper_bound(prefixWeight.begin(), prefixWeight.end(), target + window) -
+        prefixWeight.begin();
+
+    std::optional<size_t> best;
+    size_t bestDist = 0;
+    for (size_t pos = std::max(lo, prev + 1); pos < std::min(hi, n); ++pos) {
+      if (unpassable[pos])
+        continue;
+      size_t weight = prefixWeight[pos];
+      size_t dist = weight > target ? weight - target : target - weight;
+      if (!best || live[pos] < live[*best] || (live[pos] == live[*best] && dist < bestDist)) {
+        best = pos;
+        bestDist = dist;
+      }
+    }
+    if (best) {
+      cuts.push_back(*best);
+      prev = *best;
+    }
+  }
+  return cuts;
+}
+
+void FuncSplitter::outlinePart(ArrayRef<Operation*> partOps, size_t partIdx) {
+  // Rematerializable operations stay where they are, and get cloned into
+  // whichever parts use them.
+  SmallVector<Operation*> moved =
+      llvm::to_vector(llvm::make_filter_range(partOps, [&](Operation* op) {
+        return !isRematerializable(op);
+      }));
+  if (moved.empty())
+    return;
+  Location loc = moved.front()->getLoc();
+  Operation* callPoint = moved.back()->getNextNode();
+
+  OpBuilder builder(funcOp.getContext());
+  builder.setInsertionPointToEnd(funcOp->getParentOfType<ModuleOp>().getBody());
+  std::string newFuncName = (funcOp.getSymName() + "$split" + std::to_string(partIdx)).str();
+  auto newFunc = builder.create<StepFuncOp>(loc,
+                                            builder.getStringAttr(newFuncName),
+                                            TypeAttr::get(builder.getFunctionType({}, {})),
+                                            /*visibility=*/mlir::StringAttr{},
+                                            /*argAttrs=*/mlir::ArrayAttr{},
+                                            /*res_attrs=*/mlir::ArrayAttr{});
+  Block* block = builder.createBlock(&newFunc.getBody());
+  for (Operation* op : moved) {
+    op->moveBefore(block, block->end());
+  }
+
+  // Capture anything defined outside this part, recomputing what we can.
+  IRMapping mapper;
+  SmallVector<Value> inputs;
+  OpBuilder cloneBuilder = OpBuilder::atBlockBegin(block);
+  std::function<Value(Value)> materialize = [&](Value value) -> Value {
+    if (Value mapped = mapper.lookupOrNull(value))
+      return mapped;
+    Operation* defOp = value.getDefiningOp();
+    if (defOp && isRematerializable(defOp)) {
+      for (Value operand : defOp->getOperands()) {
+        materialize(operand);
+      }
+      return cloneBuilder.clone(*defOp, mapper)->getResult(0);
+    }
+    Value arg = block->addArgument(value.getType(), value.getLoc());
+    inputs.push_back(value);
+    mapper.map(value, arg);
+    return arg;
+  };
+  Region* newBody = &newFunc.getBody();
+  block->walk([&](Operation* op) {
+    for (OpOperand& operand : op->getOpOperands()) {
+      if (!newBody->isAncestor(operand.get().getParentRegion()))
+        operand.set(materialize(operand.get()));
+    }
+  });
+
+  // Return anything used after this part.
+  SmallVector<Value> outputs;
+  for (Operation* op : moved) {
+    for (Value result : op->getResults()) {
+      if (llvm::any_of(result.getUsers(),
+                       [&](Operation* user) { return !newFunc->isProperAncestor(user); }))
+        outputs.push_back(result);
+    }
+  }
+  builder.setInsertionPointToEnd(block);
+  builder.create<Zhlt::ReturnOp>(loc, outputs);
+  newFunc.setFunctionTypeAttr(TypeAttr::get(builder.getFunctionType(
+      ValueRange(inputs).getTypes(), ValueRange(outputs).getTypes())));
+
+  builder.setInsertionPoint(callPoint);
+  auto callOp = builder.create<StepCallOp>(loc, newFunc, inputs);
+  for (auto [output, result] : llvm::zip_equal(outputs, callOp.getResults())) {
+    output.replaceUsesWithIf(
+        result, [&](OpOperand& use) { return !newFunc->isProperAncestor(use.getOwner()); });
+  }
+}
+
+void FuncSplitter::run() {
+  analyze();
+  SmallVector<size_t> cuts = chooseCuts();
+  if (cuts.empty())
+    return;
+  cuts.push_back(ops.size());
+  for (size_t i = 0; i + 1 != cuts.size(); ++i) {
+    outlinePart(ArrayRef(ops).slice(cuts[i], cuts[i + 1] - cuts[i]), i + 1);
+  }
+
+  // Rematerializable operations that were only used in outlined parts are now dead.
+  for (Operation* op : llvm::reverse(ops)) {
+    if (isRematerializable(op) && op->use_empty())
+      op->erase();
+  }
+}
+
+struct SplitStepFuncsPass : public SplitStepFuncsBase<SplitStepFuncsPass> {
+  SplitStepFuncsPass() = default;
+  SplitStepFuncsPass(size_t maxOps) { this->maxOps = maxOps; }
+
+  void runOnOperation() override {
+    if (!maxOps)
+      return;
+    for (auto f : llvm::to_vector(getOperation().getBody()->getOps<StepFuncOp>())) {
+      FuncSplitter(f, maxOps).run();
+    }
+  }
+};
+
+} // namespace
+
+std::unique_ptr<OperationPass<ModuleOp>> createSplitStepFuncsPass(size_t maxOps) {
+  return std::make_unique<SplitStepFuncsPass>(maxOps);
+}
+
+} // namespace zirgen::Zhlt
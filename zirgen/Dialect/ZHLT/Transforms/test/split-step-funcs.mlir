@@ -0,0 +1,51 @@
+// RUN: zirgen-opt --split-step-funcs="max-ops=3" %s | FileCheck %s
+
+// Functions under the limit are left alone.
+
+// CHECK-LABEL: zhlt.step_func @small
+// CHECK-NOT: zhlt.call_step
+// CHECK: zhlt.return
+zhlt.step_func @small(%arg0: !zll.val<BabyBear>) -> !zll.val<BabyBear> {
+  %0 = zll.add %arg0 : <BabyBear>, %arg0 : <BabyBear>
+  zhlt.return %0 : !zll.val<BabyBear>
+}
+
+// Nine operations are split into three parts of three; the middle part passes
+// two values on to the last.
+
+// CHECK-LABEL: zhlt.step_func @big
+// CHECK-SAME: (%[[ARG:.*]]: !zll.val<BabyBear>) -> !zll.val<BabyBear>
+// CHECK: %[[A0:.*]] = zll.add %[[ARG]] : <BabyBear>, %[[ARG]] : <BabyBear>
+// CHECK: %[[M0:.*]] = zll.mul %[[ARG]] : <BabyBear>, %[[ARG]] : <BabyBear>
+// CHECK: %[[A1:.*]] = zll.add %[[A0]] : <BabyBear>, %[[M0]] : <BabyBear>
+// CHECK: %[[P1:.*]]:2 = zhlt.call_step @"big$split1"(%[[A0]], %[[M0]], %[[A1]])
+// CHECK: %[[P2:.*]] = zhlt.call_step @"big$split2"(%[[P1]]#0, %[[P1]]#1)
+// CHECK: zhlt.return %[[P2]] : !zll.val<BabyBear>
+
+// CHECK-LABEL: zhlt.step_func @"big$split1"
+// CHECK-SAME: (%[[A0:.*]]: !zll.val<BabyBear>, %[[M0:.*]]: !zll.val<BabyBear>,
+// CHECK-SAME: %[[A1:.*]]: !zll.val<BabyBear>)
+// CHECK-SAME: -> (!zll.val<BabyBear>, !zll.val<BabyBear>)
+// CHECK: %[[M1:.*]] = zll.mul %[[A0]] : <BabyBear>, %[[M0]] : <BabyBear>
+// CHECK: %[[A2:.*]] = zll.add %[[A1]] : <BabyBear>, %[[M1]] : <BabyBear>
+// CHECK: %[[M2:.*]] = zll.mul %[[A1]] : <BabyBear>, %[[M1]] : <BabyBear>
+// CHECK: zhlt.return %[[A2]], %[[M2]] : !zll.val<BabyBear>, !zll.val<BabyBear>
+
+// CHECK-LABEL: zhlt.step_func @"big$split2"
+// CHECK-SAME: -> !zll.val<BabyBear>
+// CHECK: zll.add
+// CHECK: zll.mul
+// CHECK: %[[A4:.*]] = zll.add
+// CHECK: zhlt.return %[[A4]] : !zll.val<BabyBear>
+zhlt.step_func @big(%arg0: !zll.val<BabyBear>) -> !zll.val<BabyBear> {
+  %0 = zll.add %arg0 : <BabyBear>, %arg0 : <BabyBear>
+  %1 = zll.mul %arg0 : <BabyBear>, %arg0 : <BabyBear>
+  %2 = zll.add %0 : <BabyBear>, %1 : <BabyBear>
+  %3 = zll.mul %0 : <BabyBear>, %1 : <BabyBear>
+  %4 = zll.add %2 : <BabyBear>, %3 : <BabyBear>
+  %5 = zll.mul %2 : <BabyBear>, %3 : <BabyBear>
+  %6 = zll.add %4 : <BabyBear>, %5 : <BabyBear>
+  %7 = zll.mul %4 : <BabyBear>, %5 : <BabyBear>
+  %8 = zll.add %6 : <BabyBear>, %7 : <BabyBear>
+  zhlt.return %8 : !zll.val<BabyBear>
+}
@@ -221,6 +221,14 @@ public:
     abort();
   }
 
+  // Assigns the result of `emitExpression' to a variable previously declared by
+  // emitSaveResults.  Only used if CodegenOptions::reuseVarSlots is set.
+  virtual void
+  emitAssignResult(CodegenEmitter& cg, CodegenIdent<IdentKind::Var> name, EmitPart emitExpression) {
+    llvm::errs() << "Variable reuse is not available for this language syntax.\n";
+    abort();
+  }
+
   virtual ~LanguageSyntax() {}
 };
 
@@ -280,6 +288,19 @@ struct CodegenOptions {
 
   LanguageSyntax* lang = nullptr;
 
+  // If true, a Val which is saved to a variable reuses the variable of an
+  // earlier Val in the same or an enclosing scope which has no uses left,
+  // instead of declaring a new one.  This keeps the number of locals in very
+  // large functions proportional to the number of values live at once rather
+  // than the number of operations, which is what the C++ compiler's register
+  // allocator and optimizer scale with.
+  bool reuseVarSlots = false;
+
+  // Externs whose first argument, when it's a constant, is passed to the
+  // implementation as a template argument instead.  This lets e.g. a lookup
+  // into a table known at compile time go straight to that table.
+  llvm::StringSet<> specializedExterns;
+
   llvm::StringMap<llvm::SmallVector<std::string>> funcContextArgs;
   llvm::StringMap<llvm::SmallVector<std::string>> callContextArgs;
 
@@ -458,6 +479,12 @@ private:
   bool inlineDepthLessThan(mlir::Operation* op, size_t n);
   bool shouldInlineConstant(mlir::Operation* op);
 
+  // Support for CodegenOptions::reuseVarSlots.
+  bool isSlotType(mlir::Type type);
+  void emitSaveSlot(mlir::Value result, EmitPart expr);
+  void finishStatement(mlir::Operation* op);
+  void markUseDone(mlir::Value value);
+
   CodegenOptions opts;
 
   size_t nextVarId = 0;
@@ -466,8 +493,27 @@ private:
     // Number of uses needed of this variable that we haven't
     // processed yet that might potentially need an owned copy.
     size_t usesRemaining = 0;
+
+    // If this variable is a reusable slot, the block whose scope declared it
+    // and the number of references still to be emitted before it may be reused.
+    mlir::Block* slotBlock = nullptr;
+    size_t refsRemaining = 0;
+    // True if the slot has since been reused for another value.
+    bool clobbered = false;
   };
   llvm::DenseMap<mlir::Value, VarInfo> varNames;
+
+  struct BlockSlots {
+    // Slots which have no references remaining, but which may not be reused
+    // until the statement currently being emitted is complete.
+    llvm::SmallVector<mlir::Value> pending;
+    // Slots available for reuse by a later statement in this block or any
+    // block nested within it.
+    llvm::SmallVector<mlir::Value> free;
+  };
+  llvm::DenseMap<mlir::Block*, BlockSlots> blockSlots;
+  // Number of uses of each value whose generated code hasn't been completely emitted yet.
+  llvm::DenseMap<mlir::Value, size_t> usesLeft;
   llvm::DenseSet<mlir::Type> types;
   llvm::DenseMap<mlir::StringAttr, mlir::Type> typeNames;
   llvm::raw_ostream* outStream = nullptr;
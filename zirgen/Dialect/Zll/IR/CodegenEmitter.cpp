@@ -119,6 +119,8 @@ StringAttr CodegenEmitter::canonIdent(StringAttr identAttr, IdentKind idt) {
 
 void CodegenEmitter::resetValueNumbering() {
   nextVarId = 0;
+  blockSlots.clear();
+  usesLeft.clear();
 }
 
 void CodegenEmitter::emitFuncDecl(FunctionOpInterface op) {
@@ -326,6 +328,7 @@ void CodegenEmitter::emitStatement(Operation* op) {
   // If it handles this case specially, let it do its thing.
   if (auto statementOp = dyn_cast<CodegenStatementOpInterface>(op)) {
     statementOp.emitStatement(*this);
+    finishStatement(op);
     return;
   }
 
@@ -338,15 +341,21 @@ void CodegenEmitter::emitStatement(Operation* op) {
         *this,
         llvm::to_vector_of<CodegenValue>(llvm::map_range(
             op->getOperands(), [&](auto operand) { return CodegenValue(operand).owned(); })));
+    finishStatement(op);
     return;
   }
 
   emitLoc(op->getLoc());
 
   emitSaveResults(op->getResults(), [&]() { emitExpr(op); });
+  finishStatement(op);
 }
 
 void CodegenEmitter::emitSaveResults(ValueRange results, EmitPart expr) {
+  if (opts.reuseVarSlots && results.size() == 1 && isSlotType(results[0].getType())) {
+    emitSaveSlot(results[0], expr);
+    return;
+  }
   auto newNames =
       llvm::to_vector(llvm::map_range(results, [&](Value v) { return getNewValueName(v); }));
   opts.lang->emitSaveResults(*this,
@@ -355,12 +364,102 @@ void CodegenEmitter::emitSaveResults(ValueRange results, EmitPart expr) {
                              expr);
 }
 
+bool CodegenEmitter::isSlotType(Type type) {
+  // Other types may be references (e.g. BoundLayout) or need to be
+  // cloned, so can't be reassigned.
+  return llvm::isa<ValType>(type);
+}
+
+void CodegenEmitter::emitSaveSlot(Value result, EmitPart expr) {
+  // Blocks nest the same way as the scopes of the generated code, so a
+  // slot declared in this block or any enclosing one is visible here.
+  Block* block = result.getParentBlock();
+  for (Block* scope = block; scope;) {
+    auto& freeSlots = blockSlots[scope].free;
+    auto it = llvm::find_if(llvm::reverse(freeSlots),
+                            [&](Value slot) { return slot.getType() == result.getType(); });
+    if (it != freeSlots.rend()) {
+      VarInfo& prev = varNames[*it];
+      prev.clobbered = true;
+      VarInfo varInfo = {.ident = prev.ident, .slotBlock = prev.slotBlock};
+      freeSlots.erase(std::next(it).base());
+      bool didEmplace = varNames.try_emplace(result, varInfo).second;
+      assert(didEmplace);
+      opts.lang->emitAssignResult(*this, varInfo.ident, expr);
+      if (result.use_empty())
+        blockSlots[varInfo.slotBlock].pending.push_back(result);
+      return;
+    }
+
+    Operation* parent = scope->getParentOp();
+    if (!parent || parent->hasTrait<OpTrait::IsIsolatedFromAbove>())
+      break;
+    scope = parent->getBlock();
+  }
+
+  // Nothing available; declare a new slot.
+  auto name = getNewValueName(result);
+  varNames[result].slotBlock = block;
+  opts.lang->emitSaveResults(*this, {name}, {result.getType()}, expr);
+  if (result.use_empty())
+    blockSlots[block].pending.push_back(result);
+}
+
+void CodegenEmitter::finishStatement(Operation* op) {
+  if (!opts.reuseVarSlots)
+    return;
+
+  // Everything `op' references has now been emitted.
+  for (Value operand : op->getOperands()) {
+    markUseDone(operand);
+  }
+
+  // Any slots which became dead while emitting `op' may now be reused.  We
+  // wait until the statement is complete since it may reference a value
+  // more than once, or from within a loop.
+  auto& slots = blockSlots[op->getBlock()];
+  slots.free.append(slots.pending);
+  slots.pending.clear();
+}
+
+void CodegenEmitter::markUseDone(Value value) {
+  auto it = usesLeft.try_emplace(value, llvm::range_size(value.getUses())).first;
+  if (it->second == 0 || --it->second)
+    return;
+
+  auto varIt = varNames.find(value);
+  if (varIt != varNames.end()) {
+    if (varIt->second.slotBlock)
+      blockSlots[varIt->second.slotBlock].pending.push_back(value);
+    return;
+  }
+
+  // This value was inlined into its users, so its own operands are done once
+  // every result of its definition is.
+  Operation* op = value.getDefiningOp();
+  if (!op)
+    return;
+  bool allDone = llvm::all_of(op->getResults(), [&](Value result) {
+    auto resultIt = usesLeft.find(result);
+    return resultIt == usesLeft.end() ? result.use_empty() : resultIt->second == 0;
+  });
+  if (!allDone)
+    return;
+  for (Value operand : op->getOperands()) {
+    markUseDone(operand);
+  }
+}
+
 void CodegenEmitter::emitValue(CodegenValue val) {
   if (val.value) {
     // If this comes from a mlir::Value, either reference the
     // previously emitted operation or emit it inline.
     if (varNames.contains(val.value)) {
       VarInfo& varInfo = varNames[val.value];
+      if (varInfo.clobbered) {
+        llvm::errs() << "Reference to " << val.value << " after its variable was reused\n";
+        abort();
+      }
 
       if (varInfo.usesRemaining) {
         varInfo.usesRemaining--;
@@ -1286,9 +1286,20 @@ void VariadicPackOp::emitExpr(codegen::CodegenEmitter& cg) {
 }
 
 void ExternOp::emitExpr(codegen::CodegenEmitter& cg) {
-  llvm::SmallVector<codegen::EmitPart> macroParts = {
-      /*extern name=*/codegen::CodegenIdent<codegen::IdentKind::Func>(getNameAttr())};
-  llvm::append_range(macroParts, getOperands());
+  codegen::CodegenIdent<codegen::IdentKind::Func> name(getNameAttr());
+  ValueRange args = getIn();
+  llvm::SmallVector<codegen::EmitPart> macroParts;
+  auto constArg = args.empty() ? ConstOp() : args.front().getDefiningOp<ConstOp>();
+  if (constArg && constArg.getCoefficients().size() == 1 &&
+      cg.getOpts().specializedExterns.contains(getName())) {
+    uint64_t value = constArg.getCoefficients()[0];
+    macroParts.push_back(
+        [name, value](codegen::CodegenEmitter& out) { out << name << "<" << value << ">"; });
+    args = args.drop_front();
+  } else {
+    macroParts.push_back(name);
+  }
+  llvm::append_range(macroParts, args);
   cg.emitInvokeMacro(cg.getStringAttr("invokeExtern"), /*contextArgs=*/{"ctx"}, macroParts);
 }
 
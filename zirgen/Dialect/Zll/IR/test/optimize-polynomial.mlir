@@ -0,0 +1,98 @@
+// RUN: zirgen-opt --optimize-polynomial="report=true" %s 2>&1 | FileCheck %s
+
+// Functions may be optimized in any order, so their reports may be too.
+// CHECK-DAG: cond: 48 -> 10 multiplications per row, 2 -> 0 conditions, degree 2 -> 2
+// CHECK-DAG: factor: 60 -> 44 multiplications per row, 0 -> 1 conditions, degree 2 -> 2
+// CHECK-DAG: merge: 80 -> 48 multiplications per row, 2 -> 1 conditions, degree 2 -> 2
+
+// Conditions on a couple of constraints are cheaper to multiply into each
+// constraint than to evaluate as an and_cond.
+
+// CHECK-LABEL: func.func @cond
+// CHECK: %[[TRUE:.*]] = zll.true
+// CHECK: %[[C:.*]] = zll.get %arg0[0]
+// CHECK: %[[A:.*]] = zll.get %arg0[1]
+// CHECK: %[[B:.*]] = zll.get %arg0[2]
+// CHECK-NOT: zll.and_cond
+// CHECK: %[[CA:.*]] = zll.mul %[[C]] : <BabyBear>, %[[A]] : <BabyBear>
+// CHECK: %[[S1:.*]] = zll.and_eqz %[[TRUE]], %[[CA]]
+// CHECK: %[[CB:.*]] = zll.mul %[[C]] : <BabyBear>, %[[B]] : <BabyBear>
+// CHECK: %[[S2:.*]] = zll.and_eqz %[[S1]], %[[CB]]
+// CHECK: return %[[S2]]
+func.func @cond(%arg0: !zll.buffer<3, mutable>) -> !zll.constraint {
+  %0 = zll.true
+  %1 = zll.get %arg0[0] back 0 : <3, mutable>
+  %2 = zll.get %arg0[1] back 0 : <3, mutable>
+  %3 = zll.get %arg0[2] back 0 : <3, mutable>
+  %4 = zll.and_eqz %0, %2 : <BabyBear>
+  %5 = zll.and_cond %0, %1 : <BabyBear>, %4
+  %6 = zll.and_eqz %0, %3 : <BabyBear>
+  %7 = zll.and_cond %5, %1 : <BabyBear>, %6
+  return %7 : !zll.constraint
+}
+
+// A run of constraints with an extension field factor in common is cheaper as
+// an and_cond on that factor.
+
+// CHECK-LABEL: func.func @factor
+// CHECK: %[[TRUE:.*]] = zll.true
+// CHECK: %[[F:.*]] = zll.get %arg1[0]
+// CHECK: %[[A:.*]] = zll.get %arg0[0]
+// CHECK: %[[B:.*]] = zll.get %arg0[1]
+// CHECK: %[[C:.*]] = zll.get %arg0[2]
+// CHECK-NOT: zll.mul
+// CHECK: %[[INNER:.*]] = zll.true
+// CHECK: %[[S1:.*]] = zll.and_eqz %[[INNER]], %[[A]] : <BabyBear>
+// CHECK: %[[S2:.*]] = zll.and_eqz %[[S1]], %[[B]] : <BabyBear>
+// CHECK: %[[S3:.*]] = zll.and_eqz %[[S2]], %[[C]] : <BabyBear>
+// CHECK: %[[OUT:.*]] = zll.and_cond %[[TRUE]], %[[F]] : <BabyBear ext>, %[[S3]]
+// CHECK-NEXT: return %[[OUT]]
+func.func @factor(%arg0: !zll.buffer<3, mutable>,
+                  %arg1: !zll.buffer<1, constant, <BabyBear ext>>) -> !zll.constraint {
+  %0 = zll.true
+  %1 = zll.get %arg1[0] back 0 : <1, constant, <BabyBear ext>>
+  %2 = zll.get %arg0[0] back 0 : <3, mutable>
+  %3 = zll.get %arg0[1] back 0 : <3, mutable>
+  %4 = zll.get %arg0[2] back 0 : <3, mutable>
+  %5 = zll.mul %1 : <BabyBear ext>, %2 : <BabyBear>
+  %6 = zll.and_eqz %0, %5 : <BabyBear ext>
+  %7 = zll.mul %3 : <BabyBear>, %1 : <BabyBear ext>
+  %8 = zll.and_eqz %6, %7 : <BabyBear ext>
+  %9 = zll.mul %1 : <BabyBear ext>, %4 : <BabyBear>
+  %10 = zll.and_eqz %8, %9 : <BabyBear ext>
+  return %10 : !zll.constraint
+}
+
+// Adjacent and_conds on the same condition become one, when the condition is
+// too expensive to multiply into their constraints.
+
+// CHECK-LABEL: func.func @merge
+// CHECK: %[[TRUE:.*]] = zll.true
+// CHECK: %[[C:.*]] = zll.get %arg1[0]
+// CHECK: %[[A:.*]] = zll.get %arg0[0]
+// CHECK: %[[B:.*]] = zll.get %arg0[1]
+// CHECK: %[[X:.*]] = zll.get %arg0[2]
+// CHECK: %[[Y:.*]] = zll.get %arg0[3]
+// CHECK-NOT: zll.and_cond
+// CHECK: %[[S1:.*]] = zll.and_eqz %[[TRUE]], %[[A]] : <BabyBear>
+// CHECK: %[[S2:.*]] = zll.and_eqz %[[S1]], %[[B]] : <BabyBear>
+// CHECK: %[[S3:.*]] = zll.and_eqz %[[S2]], %[[X]] : <BabyBear>
+// CHECK: %[[S4:.*]] = zll.and_eqz %[[S3]], %[[Y]] : <BabyBear>
+// CHECK: %[[OUT:.*]] = zll.and_cond %[[TRUE]], %[[C]] : <BabyBear ext>, %[[S4]]
+// CHECK-NEXT: return %[[OUT]]
+func.func @merge(%arg0: !zll.buffer<4, mutable>,
+                 %arg1: !zll.buffer<1, constant, <BabyBear ext>>) -> !zll.constraint {
+  %0 = zll.true
+  %1 = zll.get %arg1[0] back 0 : <1, constant, <BabyBear ext>>
+  %2 = zll.get %arg0[0] back 0 : <4, mutable>
+  %3 = zll.get %arg0[1] back 0 : <4, mutable>
+  %4 = zll.get %arg0[2] back 0 : <4, mutable>
+  %5 = zll.get %arg0[3] back 0 : <4, mutable>
+  %6 = zll.and_eqz %0, %2 : <BabyBear>
+  %7 = zll.and_eqz %6, %3 : <BabyBear>
+  %8 = zll.and_cond %0, %1 : <BabyBear ext>, %7
+  %9 = zll.and_eqz %0, %4 : <BabyBear>
+  %10 = zll.and_eqz %9, %5 : <BabyBear>
+  %11 = zll.and_cond %8, %1 : <BabyBear ext>, %10
+  return %11 : !zll.constraint
+}
@@ -0,0 +1,314 @@
+// Copyright 2024 RISC Zero, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mlir/Analysis/DataFlowFramework.h"
+#include "mlir/IR/BuiltinOps.h"
+#include "mlir/Interfaces/SideEffectInterfaces.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/TypeSwitch.h"
+
+#include "zirgen/Dialect/Zll/Analysis/DegreeAnalysis.h"
+#include "zirgen/Dialect/Zll/IR/IR.h"
+#include "zirgen/Dialect/Zll/Transforms/PassDetail.h"
+
+#include <algorithm>
+#include <optional>
+
+using namespace mlir;
+
+namespace zirgen::Zll {
+
+namespace {
+
+size_t extDegree(Value value) {
+  return llvm::cast<ValType>(value.getType()).getExtensionField().degree;
+}
+
+// The number of base field multiplications needed to evaluate `op` for a row,
+// where constraints are combined using precomputed powers of the (extension
+// field) mix as in the generated CPU and GPU evaluators.
+size_t getMulCost(Operation* op, size_t mixDegree) {
+  return TypeSwitch<Operation*, size_t>(op)
+      .Case<MulOp>([&](MulOp op) { return extDegree(op.getLhs()) * extDegree(op.getRhs()); })
+      .Case<PowOp>([&](PowOp op) {
+        size_t degree = extDegree(op.getIn());
+        return degree * degree * (op.getExponent() > 1 ? op.getExponent() - 1 : 0);
+      })
+      .Case<AndEqzOp>([&](AndEqzOp op) { return extDegree(op.getVal()) * mixDegree; })
+      .Case<AndCondOp>([&](AndCondOp op) {
+        return extDegree(op.getCond()) * mixDegree + mixDegree * mixDegree;
+      })
+      .Default([](Operation*) { return 0; });
+}
+
+struct PolyStats {
+  size_t muls = 0;
+  size_t conds = 0;
+  unsigned degree = 0;
+};
+
+// Rewrites the and_eqz/and_cond chains of a polynomial to need fewer
+// multiplications, without changing the value of the polynomial.  Each rewrite
+// only regroups the terms of a chain, so every constraint keeps its power of
+// the mix:
+//
+//   * Adjacent and_conds with the same condition are merged.
+//   * An and_cond with a short inner chain is inlined into its parent by
+//     multiplying the condition into each of the inner constraints.
+//   * A long run of and_eqzs which are all multiplied by the same factor is
+//     turned into an and_cond on that factor.
+//
+// None of these can increase the degree of any constraint.
+class PolyOptimizer {
+public:
+  PolyOptimizer(func::FuncOp func, size_t mixDegree) : func(func), mixDegree(mixDegree) {}
+
+  PolyStats getStats();
+  bool runOnce();
+
+private:
+  std::optional<SmallVector<Operation*>> getChain(Value state);
+  Value append(OpBuilder& builder, Value state, Operation* entry, Value factor);
+  size_t factorCost(Operation* entry, Value factor);
+
+  bool tryMerge(AndCondOp op);
+  bool tryDistribute(AndCondOp op);
+  bool tryFactor(AndEqzOp op, DenseSet<Operation*>& visited);
+  void eraseDead();
+
+  func::FuncOp func;
+  size_t mixDegree;
+};
+
+PolyStats PolyOptimizer::getStats() {
+  PolyStats stats;
+  func.walk([&](Operation* op) {
+    stats.muls += getMulCost(op, mixDegree);
+    if (llvm::isa<AndCondOp>(op))
+      stats.conds++;
+  });
+
+  DataFlowSolver solver;
+  solver.load<DegreeAnalysis>();
+  if (succeeded(solver.initializeAndRun(func))) {
+    func.walk([&](func::ReturnOp op) {
+      for (Value operand : op.getOperands()) {
+        auto* lattice = solver.lookupState<DegreeAnalysis::Element>(operand);
+        if (lattice && lattice->getValue().isDefined())
+          stats.degree = std::max(stats.degree, lattice->getValue().get());
+      }
+    });
+  }
+  return stats;
+}
+
+// Returns the entries of the chain that computes `state`, in order, if it
+// starts with a `true` and nothing else uses its intermediate states.
+std::optional<SmallVector<Operation*>> PolyOptimizer::getChain(Value state) {
+  SmallVector<Operation*> chain;
+  while (!state.getDefiningOp<TrueOp>()) {
+    Operation* op = state.getDefiningOp();
+    if (!op || !llvm::isa<AndEqzOp, AndCondOp>(op) || !state.hasOneUse())
+      return std::nullopt;
+    chain.push_back(op);
+    state = op->getOperand(0);
+  }
+  std::reverse(chain.begin(), chain.end());
+  return chain;
+}
+
+// Adds a copy of the chain entry `entry` to `state`, multiplied by `factor` if present.
+Value PolyOptimizer::append(OpBuilder& builder, Value state, Operation* entry, Value factor) {
+  if (auto eqz = llvm::dyn_cast<AndEqzOp>(entry)) {
+    Value val = eqz.getVal();
+    if (factor)
+      val = builder.create<MulOp>(eqz.getLoc(), factor, val);
+    return builder.create<AndEqzOp>(eqz.getLoc(), state, val);
+  }
+  auto cond = llvm::cast<AndCondOp>(entry);
+  Value condVal = cond.getCond();
+  if (factor)
+    condVal = builder.create<MulOp>(cond.getLoc(), factor, condVal);
+  return builder.create<AndCondOp>(cond.getLoc(), state, condVal, cond.getInner());
+}
+
+// Returns the additional cost of multiplying the chain entry `entry` by `factor`.
+size_t PolyOptimizer::factorCost(Operation* entry, Value factor) {
+  Value val = llvm::isa<AndEqzOp>(entry) ? llvm::cast<AndEqzOp>(entry).getVal()
+                                          : llvm::cast<AndCondOp>(entry).getCond();
+  size_t cost = extDegree(factor) * extDegree(val);
+  size_t newDegree = std::max(extDegree(factor), extDegree(val));
+  return cost + (newDegree - extDegree(val)) * mixDegree;
+}
+
+bool PolyOptimizer::tryMerge(AndCondOp op) {
+  auto prev = op.getIn().getDefiningOp<AndCondOp>();
+  if (!prev || prev.getCond() != op.getCond() || !op.getIn().hasOneUse())
+    return false;
+  auto entries = getChain(op.getInner());
+  if (!entries)
+    return false;
+
+  OpBuilder builder(op);
+  Value inner = prev.getInner();
+  for (Operation* entry : *entries) {
+    inner = append(builder, inner, entry, /*factor=*/Value());
+  }
+  Value merged = builder.create<AndCondOp>(op.getLoc(), prev.getIn(), op.getCond(), inner);
+  op.getOut().replaceAllUsesWith(merged);
+  return true;
+}
+
+bool PolyOptimizer::tryDistribute(AndCondOp op) {
+  auto entries = getChain(op.getInner());
+  if (!entries)
+    return false;
+  size_t cost = 0;
+  for (Operation* entry : *entries) {
+    cost += factorCost(entry, op.getCond());
+  }
+  if (cost >= getMulCost(op, mixDegree))
+    return false;
+
+  OpBuilder builder(op);
+  Value state = op.getIn();
+  for (Operation* entry : *entries) {
+    state = append(builder, state, entry, op.getCond());
+  }
+  op.getOut().replaceAllUsesWith(state);
+  return true;
+}
+
+bool PolyOptimizer::tryFactor(AndEqzOp op, DenseSet<Operation*>& visited) {
+  auto getMul = [](AndEqzOp eqz) {
+    auto mul = eqz.getVal().getDefiningOp<MulOp>();
+    return mul && mul->hasOneUse() ? mul : MulOp();
+  };
+  auto getOther = [](MulOp mul, Value factor) {
+    return mul.getLhs() == factor ? mul.getRhs() : mul.getLhs();
+  };
+
+  MulOp firstMul = getMul(op);
+  if (!firstMul)
+    return false;
+
+  // Find the longest run of and_eqzs starting here which share a factor.
+  SmallVector<AndEqzOp> run = {op};
+  Value factor;
+  while (run.back().getOut().hasOneUse()) {
+    auto next = llvm::dyn_cast<AndEqzOp>(*run.back().getOut().getUsers().begin());
+    if (!next || next.getIn() != run.back().getOut())
+      break;
+    MulOp mul = getMul(next);
+    if (!mul)
+      break;
+    if (!factor) {
+      for (Value candidate : {firstMul.getLhs(), firstMul.getRhs()}) {
+        if (mul.getLhs() == candidate || mul.getRhs() == candidate)
+          factor = candidate;
+      }
+      if (!factor)
+        break;
+    } else if (mul.getLhs() != factor && mul.getRhs() != factor) {
+      break;
+    }
+    run.push_back(next);
+  }
+  for (AndEqzOp eqz : run) {
+    visited.insert(eqz);
+  }
+  if (run.size() < 2)
+    return false;
+
+  size_t cost = 0, newCost = mixDegree * mixDegree + extDegree(factor) * mixDegree;
+  for (AndEqzOp eqz : run) {
+    MulOp mul = getMul(eqz);
+    cost += getMulCost(mul, mixDegree) + getMulCost(eqz, mixDegree);
+    newCost += extDegree(getOther(mul, factor)) * mixDegree;
+  }
+  if (newCost >= cost)
+    return false;
+
+  OpBuilder builder(run.back());
+  Value inner = builder.create<TrueOp>(op.getLoc());
+  for (AndEqzOp eqz : run) {
+    inner = builder.create<AndEqzOp>(eqz.getLoc(), inner, getOther(getMul(eqz), factor));
+  }
+  Value factored = builder.create<AndCondOp>(op.getLoc(), op.getIn(), factor, inner);
+  run.back().getOut().replaceAllUsesWith(factored);
+  return true;
+}
+
+void PolyOptimizer::eraseDead() {
+  for (Block& block : func.getBody()) {
+    for (Operation& op : llvm::make_early_inc_range(llvm::reverse(block))) {
+      if (isOpTriviallyDead(&op))
+        op.erase();
+    }
+  }
+}
+
+bool PolyOptimizer::runOnce() {
+  bool changed = false;
+  for (auto op : llvm::to_vector(func.getOps<AndCondOp>())) {
+    if (op.use_empty())
+      continue;
+    changed |= tryMerge(op) || tryDistribute(op);
+  }
+  eraseDead();
+
+  DenseSet<Operation*> visited;
+  for (auto op : llvm::to_vector(func.getOps<AndEqzOp>())) {
+    if (op.use_empty() || visited.contains(op))
+      continue;
+    changed |= tryFactor(op, visited);
+  }
+  eraseDead();
+  return changed;
+}
+
+struct OptimizePolynomialPass : public OptimizePolynomialBase<OptimizePolynomialPass> {
+  OptimizePolynomialPass() = default;
+  OptimizePolynomialPass(bool report) { this->report = report; }
+
+  void runOnOperation() override {
+    auto func = getOperation();
+    size_t mixDegree = ValType::getExtensionType(&getContext()).getExtensionField().degree;
+    PolyOptimizer optimizer(func, mixDegree);
+
+    PolyStats before = optimizer.getStats();
+    while (optimizer.runOnce()) {
+    }
+    PolyStats after = optimizer.getStats();
+
+    if (after.degree > before.degree) {
+      func.emitError() << "optimize-polynomial increased the degree from " << before.degree
+                       << " to " << after.degree;
+      return signalPassFailure();
+    }
+    if (report) {
+      llvm::errs() << func.getName() << ": " << before.muls << " -> " << after.muls
+                   << " multiplications per row, " << before.conds << " -> " << after.conds
+                   << " conditions, degree " << before.degree << " -> " << after.degree << "\n";
+    }
+  }
+};
+
+} // End namespace
+
+std::unique_ptr<OperationPass<func::FuncOp>> createOptimizePolynomialPass(bool report) {
+  return std::make_unique<OptimizePolynomialPass>(report);
+}
+
+} // namespace zirgen::Zll
@@ -23,6 +23,8 @@ namespace zirgen::Zll {
 // Pass constructors
 std::unique_ptr<mlir::OperationPass<mlir::func::FuncOp>> createComputeTapsPass();
 std::unique_ptr<mlir::OperationPass<mlir::func::FuncOp>> createMakePolynomialPass();
+std::unique_ptr<mlir::OperationPass<mlir::func::FuncOp>>
+createOptimizePolynomialPass(bool report = false);
 std::unique_ptr<mlir::OperationPass<mlir::func::FuncOp>> createSplitStagePass();
 std::unique_ptr<mlir::OperationPass<mlir::func::FuncOp>> createDropConstraintsPass();
 std::unique_ptr<mlir::OperationPass<mlir::func::FuncOp>> createSplitStagePass(unsigned stage);
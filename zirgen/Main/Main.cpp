@@ -14,9 +14,11 @@
 
 #include "zirgen/Main/Main.h"
 
+#include "mlir/Bytecode/BytecodeWriter.h"
 #include "mlir/Debug/CLOptionsSetup.h"
 #include "mlir/Dialect/Func/Extensions/InlinerExtension.h"
 #include "mlir/IR/AsmState.h"
+#include "mlir/Parser/Parser.h"
 #include "mlir/Transforms/Passes.h"
 #include "risc0/core/elf.h"
 #include "risc0/core/util.h"
@@ -28,10 +30,57 @@
 #include "zirgen/Dialect/Zll/IR/IR.h"
 #include "zirgen/Dialect/Zll/Transforms/Passes.h"
 #include "zirgen/dsl/passes/Passes.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SHA256.h"
 
 namespace zirgen {
 
+namespace {
+
+struct TypingCacheCLOptions {
+  llvm::cl::opt<std::string> cacheDir{
+      "typing-cache-dir",
+      llvm::cl::desc("Directory to cache type checked modules in between compilations"),
+      llvm::cl::value_desc("dir")};
+};
+
+llvm::ManagedStatic<TypingCacheCLOptions> typingCacheOpts;
+
+// Returns a hash of everything the type checked module depends on: the
+// compiler itself (which includes the builtin preamble), and the contents of
+// every source buffer.  Returns an empty string if the compiler binary can't be
+// identified.
+std::string getTypingCacheKey(const llvm::SourceMgr& sourceManager) {
+  std::string exe =
+      llvm::sys::fs::getMainExecutable(nullptr, reinterpret_cast<void*>(&registerZirgenCommon));
+  llvm::sys::fs::file_status status;
+  if (exe.empty() || llvm::sys::fs::status(exe, status))
+    return "";
+
+  llvm::SHA256 hasher;
+  auto add = [&](llvm::StringRef str) {
+    hasher.update(std::to_string(str.size()) + ":");
+    hasher.update(str);
+  };
+  add(exe);
+  add(std::to_string(status.getSize()));
+  add(std::to_string(status.getLastModificationTime().time_since_epoch().count()));
+  for (unsigned i = 1; i <= sourceManager.getNumBuffers(); i++) {
+    const llvm::MemoryBuffer* buffer = sourceManager.getMemoryBuffer(i);
+    add(buffer->getBufferIdentifier());
+    add(buffer->getBuffer());
+  }
+  return llvm::toHex(hasher.final(), /*LowerCase=*/true);
+}
+
+} // namespace
+
 void registerZirgenCommon() {
+  *typingCacheOpts;
   mlir::registerAsmPrinterCLOptions();
   mlir::registerMLIRContextCLOptions();
   mlir::registerPassManagerCLOptions();
@@ -98,4 +147,50 @@ mlir::LogicalResult checkDegreeExceeded(mlir::ModuleOp module, size_t maxDegree)
   return mlir::success();
 }
 
+std::optional<mlir::ModuleOp>
+typeCheckCached(mlir::MLIRContext& context,
+                const llvm::SourceMgr& sourceManager,
+                llvm::function_ref<std::optional<mlir::ModuleOp>()> typeCheck) {
+  const std::string& cacheDir = typingCacheOpts->cacheDir;
+  std::string key = cacheDir.empty() ? "" : getTypingCacheKey(sourceManager);
+  if (key.empty())
+    return typeCheck();
+
+  llvm::SmallString<128> path(cacheDir);
+  llvm::sys::path::append(path, key + ".mlirbc");
+  if (llvm::sys::fs::exists(path)) {
+    mlir::ParserConfig config(&context);
+    if (auto cached = mlir::parseSourceFile<mlir::ModuleOp>(path, config))
+      return cached.release();
+    llvm::errs() << "warning: ignoring unreadable typing cache entry " << path << "\n";
+  }
+
+  std::optional<mlir::ModuleOp> typedModule = typeCheck();
+  if (!typedModule)
+    return typedModule;
+
+  // Write to a temporary file and rename it into place, so that concurrent
+  // compilations never see a partially written entry.
+  int fd;
+  llvm::SmallString<128> tmpPath;
+  if (llvm::sys::fs::create_directories(cacheDir) ||
+      llvm::sys::fs::createUniqueFile(path + ".%%%%%%.tmp", fd, tmpPath)) {
+    llvm::errs() << "warning: unable to write typing cache entry " << path << "\n";
+    return typedModule;
+  }
+  bool written;
+  {
+    llvm::raw_fd_ostream os(fd, /*shouldClose=*/true);
+    written = succeeded(mlir::writeBytecodeToFile(*typedModule, os));
+    os.close();
+    written = written && !os.has_error();
+    os.clear_error();
+  }
+  if (!written || llvm::sys::fs::rename(tmpPath, path)) {
+    llvm::errs() << "warning: unable to write typing cache entry " << path << "\n";
+    llvm::sys::fs::remove(tmpPath);
+  }
+  return typedModule;
+}
+
 } // namespace zirgen
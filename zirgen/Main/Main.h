@@ -16,6 +16,9 @@
 
 #include "mlir/IR/BuiltinOps.h"
 #include "mlir/Pass/PassManager.h"
+#include "llvm/Support/SourceMgr.h"
+
+#include <optional>
 
 namespace zirgen {
 
@@ -29,4 +32,13 @@ void addTypingPasses(mlir::PassManager& pm);
 
 mlir::LogicalResult checkDegreeExceeded(mlir::ModuleOp module, size_t maxDegree);
 
+// Returns the module produced by `typeCheck` from the sources loaded into
+// `sourceManager`.  If --typing-cache-dir is given, the result is saved there
+// keyed by a hash of the compiler and of every source buffer, and later
+// compilations of the same sources load it instead of type checking again.
+std::optional<mlir::ModuleOp>
+typeCheckCached(mlir::MLIRContext& context,
+                const llvm::SourceMgr& sourceManager,
+                llvm::function_ref<std::optional<mlir::ModuleOp>()> typeCheck);
+
 } // namespace zirgen
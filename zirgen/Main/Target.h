@@ -43,6 +43,10 @@ public:
   virtual Template getStepDeclTemplate() const { return Template{}; }
   virtual Template getStepTemplate() const { return Template{}; }
 
+  // Returns true if the step declarations can carry a row-range entry point for
+  // circuits with parallel witness generation.
+  virtual bool hasStepRows() const { return false; }
+
 protected:
   // TODO: Remove this mutable when MLIR generates const getter methods on CircuitNameAttr.
   mutable zirgen::Zll::CircuitNameAttr circuitName;
@@ -55,6 +59,7 @@ struct CppCodegenTarget : public CodegenTarget {
   llvm::StringRef getImplExtension() const override;
   Template getStepDeclTemplate() const override;
   Template getStepTemplate() const override;
+  bool hasStepRows() const override { return true; }
 };
 
 struct RustCodegenTarget : public CodegenTarget {
@@ -62,6 +62,11 @@ static cl::opt<bool> multiplyIf("multiply-if",
                                 cl::desc("Mulitply out and refactor `if` statements when "
                                          "generating constraints, which can improve CSE."),
                                 cl::init(false));
+static cl::opt<bool>
+    polyReport("poly-report",
+               cl::desc("Print the multiplications per row and degree of the validity polynomial "
+                        "before and after optimizing it"),
+               cl::init(false));
 static cl::opt<bool>
     parallelWitgen("parallel-witgen",
                    cl::desc("Assume the witness can be generated in parallel, and that all externs "
@@ -76,6 +81,14 @@ llvm::cl::opt<size_t> stepSplitCount{
     llvm::cl::value_desc("numParts"),
     llvm::cl::init(1)};
 
+llvm::cl::opt<size_t> stepSplitOps{
+    "step-split-ops",
+    llvm::cl::desc("Outline parts of step functions with more than this many operations into "
+                   "separate functions, so they can be compiled and split across files "
+                   "independently; 0 to disable"),
+    llvm::cl::value_desc("numOps"),
+    llvm::cl::init(0)};
+
 namespace {
 
 void openMainFile(llvm::SourceMgr& sourceManager, std::string filename) {
@@ -140,7 +153,11 @@ void emitOps(CodegenEmitter& cg,
 }
 
 template <typename... OpT>
-void emitOpDecls(CodegenEmitter& cg, ModuleOp mod, const Twine& filename, const Template& tmpl) {
+void emitOpDecls(CodegenEmitter& cg,
+                 ModuleOp mod,
+                 const Twine& filename,
+                 const Template& tmpl,
+                 bool stepRows = false) {
   auto os = openOutput(filename.str());
   *os << tmpl.header;
   CodegenEmitter::StreamOutputGuard guard(cg, os.get());
@@ -149,6 +166,10 @@ void emitOpDecls(CodegenEmitter& cg, ModuleOp mod, const Twine& filename, const
       cg.emitTopLevelDecl(&op);
     }
   }
+  if (stepRows && Zhlt::getEmitter(mod, cg)->emitStepRows().failed()) {
+    llvm::errs() << "Failed to emit row steps to " << filename << "\n";
+    exit(1);
+  }
   *os << tmpl.footer;
 }
 
@@ -171,7 +192,13 @@ void emitTarget(const CodegenTarget& target,
       cg, mod, "layout." + implExt + ".inc", target.getLayoutTemplate());
 
   if (implExt != declExt) {
-    emitOpDecls<Zhlt::StepFuncOp>(cg, stepFuncs, "steps." + declExt, target.getStepDeclTemplate());
+    // Rows are independent with parallel witness generation, so they can be
+    // run in ranges
+    emitOpDecls<Zhlt::StepFuncOp>(cg,
+                                  stepFuncs,
+                                  "steps." + declExt,
+                                  target.getStepDeclTemplate(),
+                                  parallelWitgen && target.hasStepRows());
   }
   if (stepSplitCount == 1) {
     emitOps<Zhlt::StepFuncOp>(cg, stepFuncs, "steps." + implExt, target.getStepTemplate());
@@ -221,6 +248,8 @@ void emitPoly(ModuleOp mod, StringRef circuitName) {
     opm.addPass(Zll::createMakePolynomialPass());
     opm.addPass(createCanonicalizerPass());
     opm.addPass(createCSEPass());
+    opm.addPass(Zll::createOptimizePolynomialPass(polyReport));
+    opm.addPass(createCSEPass());
     opm.addPass(Zll::createComputeTapsPass());
   }
 
@@ -274,13 +303,19 @@ ModuleOp makeStepFuncs(ModuleOp mod) {
 
   if (parallelWitgen) {
     pm.addPass(mlir::createInlinerPass());
-    pm.addPass(zirgen::ZStruct::createInlineLayoutPass());
-    pm.addPass(zirgen::ZStruct::createUnrollPass());
+    // Once everything is inlined, run the function-local passes on each step
+    // function in parallel
+    auto& stepPasses = pm.nest<zirgen::Zhlt::StepFuncOp>();
+    stepPasses.addPass(zirgen::ZStruct::createInlineLayoutPass());
+    stepPasses.addPass(zirgen::ZStruct::createUnrollPass());
     pm.addPass(zirgen::Zhlt::createOptimizeParWitgenPass());
-    pm.addPass(createCSEPass());
+    pm.nest<zirgen::Zhlt::StepFuncOp>().addPass(createCSEPass());
     pm.addPass(zirgen::Zhlt::createOutlineIfsPass());
     pm.addPass(zirgen::Zhlt::createOptimizeParWitgenPass());
   }
+  if (stepSplitOps) {
+    pm.addPass(zirgen::Zhlt::createSplitStepFuncsPass(stepSplitOps));
+  }
 
   if (failed(pm.run(stepFuncs))) {
     llvm::errs()
@@ -327,12 +362,15 @@ int main(int argc, char* argv[]) {
     return 1;
   }
 
-  std::optional<mlir::ModuleOp> zhlModule = zirgen::dsl::lower(context, sourceManager, ast.get());
-  if (!zhlModule) {
-    return 1;
-  }
-
-  std::optional<mlir::ModuleOp> typedModule = zirgen::Typing::typeCheck(context, zhlModule.value());
+  std::optional<mlir::ModuleOp> typedModule =
+      zirgen::typeCheckCached(context, sourceManager, [&]() -> std::optional<mlir::ModuleOp> {
+        std::optional<mlir::ModuleOp> zhlModule =
+            zirgen::dsl::lower(context, sourceManager, ast.get());
+        if (!zhlModule) {
+          return std::nullopt;
+        }
+        return zirgen::Typing::typeCheck(context, zhlModule.value());
+      });
   if (!typedModule) {
     return 1;
   }
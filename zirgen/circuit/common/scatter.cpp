@@ -0,0 +1,153 @@
+// Copyright 2024 RISC Zero, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "zirgen/circuit/common/scatter.h"
+#include "risc0/core/parallel.h"
+
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <stdexcept>
+
+namespace zirgen {
+
+using risc0::Fp;
+
+namespace {
+
+// Don't split up scattering into less than this many entries per thread
+constexpr size_t kMinInfosPerThread = 4096;
+
+// Entries are ordered by row; the order within a row doesn't matter for locality.
+bool rowLess(const ScatterInfo& lhs, const ScatterInfo& rhs) {
+  return lhs.row < rhs.row;
+}
+
+[[noreturn]] void conflict(const ScatterInfo& info, size_t i, Fp cur, Fp val) {
+  std::cerr << "Inconsistent scatter: row = " << info.row << ", col = " << info.column + i << "\n";
+  std::cerr << "Current = " << cur.asUInt32() << ", new = " << val.asUInt32() << "\n";
+  throw std::runtime_error("Inconsistant set");
+}
+
+// As with TraceGroup::set, a cell which already holds a value may only be set
+// to that same value again.
+inline void put(Fp* out, const ScatterInfo& info, size_t i, Fp val) {
+  Fp& cell = out[i];
+  if (cell != Fp::invalid() && cell != val) {
+    conflict(info, i, cell, val);
+  }
+  cell = val;
+}
+
+template <unsigned Bits> void unpack(Fp* out, const uint32_t* words, const ScatterInfo& info) {
+  constexpr unsigned perWord = 32 / Bits;
+  constexpr uint32_t mask = (uint32_t(1) << Bits) - 1;
+  size_t count = info.count;
+  size_t i = 0;
+  for (; i + perWord <= count; i += perWord) {
+    uint32_t word = *words++;
+    for (unsigned j = 0; j < perWord; j++) {
+      put(out, info, i + j, Fp((word >> (j * Bits)) & mask));
+    }
+  }
+  if (i < count) {
+    uint32_t word = *words;
+    for (unsigned j = 0; i + j < count; j++) {
+      put(out, info, i + j, Fp((word >> (j * Bits)) & mask));
+    }
+  }
+}
+
+// Bits are common enough (keccak scatters 800 per row) to skip the encode
+template <> void unpack<1>(Fp* out, const uint32_t* words, const ScatterInfo& info) {
+  const std::array<Fp, 2> values = {Fp(0), Fp(1)};
+  for (size_t i = 0; i < info.count; i++) {
+    put(out, info, i, values[(words[i / 32] >> (i % 32)) & 1]);
+  }
+}
+
+void unpackWords(Fp* out, const uint32_t* words, const ScatterInfo& info) {
+  for (size_t i = 0; i < info.count; i++) {
+    put(out, info, i, Fp(words[i]));
+  }
+}
+
+void applyOne(Fp* dest, size_t cols, const uint32_t* data, const ScatterInfo& info) {
+  Fp* out = dest + size_t(info.row) * cols + info.column;
+  const uint32_t* words = data + info.dataOffset;
+  switch (info.bitPerElem) {
+  case 1:
+    unpack<1>(out, words, info);
+    break;
+  case 8:
+    unpack<8>(out, words, info);
+    break;
+  case 16:
+    unpack<16>(out, words, info);
+    break;
+  case 32:
+    unpackWords(out, words, info);
+    break;
+  }
+}
+
+void check(size_t rows, size_t cols, size_t dataSize, const ScatterInfo& info) {
+  if (info.bitPerElem != 1 && info.bitPerElem != 8 && info.bitPerElem != 16 &&
+      info.bitPerElem != 32) {
+    throw std::runtime_error("Invalid scatter element size");
+  }
+  size_t words = (size_t(info.count) * info.bitPerElem + 31) / 32;
+  if (info.row >= rows || size_t(info.column) + info.count > cols ||
+      size_t(info.dataOffset) + words > dataSize) {
+    throw std::runtime_error("Scatter out of range");
+  }
+}
+
+} // namespace
+
+void applyScatter(Fp* dest,
+                  size_t rows,
+                  size_t cols,
+                  const std::vector<uint32_t>& data,
+                  const std::vector<ScatterInfo>& infos) {
+  // Preflights usually emit entries in row order already, so only sort if needed.
+  const std::vector<ScatterInfo>* sorted = &infos;
+  std::vector<ScatterInfo> sortedCopy;
+  if (!std::is_sorted(infos.begin(), infos.end(), rowLess)) {
+    sortedCopy = infos;
+    std::stable_sort(sortedCopy.begin(), sortedCopy.end(), rowLess);
+    sorted = &sortedCopy;
+  }
+  // Move the ends of each block to row boundaries, so that all the entries for
+  // a row are applied by the same thread and any conflict between them is seen.
+  auto rowStart = [&](size_t i) {
+    while (i > 0 && i < sorted->size() && (*sorted)[i].row == (*sorted)[i - 1].row) {
+      i++;
+    }
+    return i;
+  };
+  risc0::parallelForBlocks(
+      0,
+      sorted->size(),
+      [&](size_t begin, size_t end) {
+        for (size_t i = rowStart(begin); i < rowStart(end); i++) {
+          const ScatterInfo& info = (*sorted)[i];
+          check(rows, cols, data.size(), info);
+          applyOne(dest, cols, data.data(), info);
+        }
+      },
+      kMinInfosPerThread);
+}
+
+} // namespace zirgen
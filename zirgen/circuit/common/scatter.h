@@ -0,0 +1,65 @@
+// Copyright 2024 RISC Zero, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "risc0/fp/fp.h"
+
+namespace zirgen {
+
+// Describes a run of consecutive columns in a single row of a trace which are
+// filled from packed words of data.
+struct ScatterInfo {
+  uint32_t dataOffset; // Place to get the data from (as u32 words)
+  uint32_t row;        // Cycle # to write to
+  uint16_t column;     // Column number to start at
+  uint16_t count;      // Number of words to write
+  uint16_t bitPerElem; // How many bits per element (1, 8, 16 or 32)
+};
+
+// Packed data along with where to scatter it.
+struct ScatterList {
+  std::vector<uint32_t> data;
+  std::vector<ScatterInfo> infos;
+
+  // Appends a word to the data, returning its offset
+  uint32_t addWord(uint32_t word) {
+    data.push_back(word);
+    return data.size() - 1;
+  }
+
+  void add(uint32_t dataOffset, uint32_t row, size_t column, size_t count, size_t bitPerElem) {
+    infos.push_back({dataOffset, row, uint16_t(column), uint16_t(count), uint16_t(bitPerElem)});
+  }
+};
+
+// Writes all of `infos` into `dest`, a row major matrix of `rows` x `cols`
+// field elements in which unset cells hold Fp::invalid().  Entries are applied
+// in row order, with each thread taking whole rows.  Entries may overlap only
+// if they agree on the values of the cells they share.  Conflicting and out of
+// range entries throw.
+void applyScatter(risc0::Fp* dest,
+                  size_t rows,
+                  size_t cols,
+                  const std::vector<uint32_t>& data,
+                  const std::vector<ScatterInfo>& infos);
+
+inline void applyScatter(risc0::Fp* dest, size_t rows, size_t cols, const ScatterList& list) {
+  applyScatter(dest, rows, cols, list.data, list.infos);
+}
+
+} // namespace zirgen
@@ -0,0 +1,165 @@
+// Copyright 2024 RISC Zero, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+
+#include "risc0/core/parallel.h"
+#include "zirgen/circuit/common/scatter.h"
+
+using namespace zirgen;
+using risc0::Fp;
+
+namespace {
+
+// The cell by cell scatter that applyScatter replaced
+void serialScatter(std::vector<Fp>& dest,
+                   size_t cols,
+                   const std::vector<uint32_t>& data,
+                   const std::vector<ScatterInfo>& infos) {
+  for (const auto& info : infos) {
+    uint32_t innerCount = 32 / info.bitPerElem;
+    uint32_t mask = info.bitPerElem == 32 ? 0xffffffff : (1 << info.bitPerElem) - 1;
+    for (size_t i = 0; i < info.count; i++) {
+      uint32_t word = data[info.dataOffset + (i / innerCount)];
+      size_t j = i % innerCount;
+      Fp val = (word >> (j * info.bitPerElem)) & mask;
+      Fp& elem = dest[info.row * cols + info.column + i];
+      if (elem != Fp::invalid() && elem != val) {
+        throw std::runtime_error("Inconsistant set");
+      }
+      elem = val;
+    }
+  }
+}
+
+// Builds a list of non-overlapping entries of every element size, with
+// several entries per row
+ScatterList randomList(std::mt19937& rng, size_t rows, size_t cols) {
+  const uint16_t sizes[] = {1, 8, 16, 32};
+  ScatterList list;
+  for (size_t row = 0; row < rows; row++) {
+    size_t col = 0;
+    while (true) {
+      uint16_t bits = sizes[rng() % 4];
+      uint16_t count = 1 + rng() % 40;
+      if (col + count > cols) {
+        break;
+      }
+      uint32_t offset = list.data.size();
+      for (size_t i = 0; i < (count * bits + 31) / 32; i++) {
+        list.addWord(bits == 32 ? rng() % Fp::P : rng());
+      }
+      list.add(offset, row, col, count, bits);
+      col += count + rng() % 3;
+    }
+  }
+  return list;
+}
+
+std::vector<Fp> scatter(size_t rows, size_t cols, const ScatterList& list) {
+  std::vector<Fp> dest(rows * cols, Fp::invalid());
+  applyScatter(dest.data(), rows, cols, list);
+  return dest;
+}
+
+} // namespace
+
+// Enough entries to be split across several threads must give the same trace as
+// scattering each cell in turn
+TEST(Scatter, MatchesSerial) {
+  std::mt19937 rng(2);
+  size_t rows = 2048;
+  size_t cols = 200;
+  ScatterList list = randomList(rng, rows, cols);
+  ASSERT_GT(list.infos.size(), 4 * 4096u);
+
+  std::vector<Fp> expected(rows * cols, Fp::invalid());
+  serialScatter(expected, cols, list.data, list.infos);
+  risc0::setParallelism(4);
+  EXPECT_EQ(scatter(rows, cols, list), expected);
+  risc0::setParallelism(0);
+}
+
+TEST(Scatter, Unsorted) {
+  std::mt19937 rng(3);
+  size_t rows = 64;
+  size_t cols = 100;
+  ScatterList list = randomList(rng, rows, cols);
+  std::vector<Fp> expected = scatter(rows, cols, list);
+  std::shuffle(list.infos.begin(), list.infos.end(), rng);
+  ASSERT_FALSE(std::is_sorted(list.infos.begin(), list.infos.end(), [](auto& lhs, auto& rhs) {
+    return lhs.row < rhs.row;
+  }));
+  EXPECT_EQ(scatter(rows, cols, list), expected);
+}
+
+// The same values packed as bits, bytes, shorts and whole words
+TEST(Scatter, PackedMatchesWords) {
+  for (uint16_t bits : {1, 8, 16}) {
+    SCOPED_TRACE("bits " + std::to_string(bits));
+    std::vector<uint32_t> values;
+    for (uint32_t i = 0; i < 37; i++) {
+      values.push_back((i * 2654435761u >> 7) & ((1u << bits) - 1));
+    }
+    ScatterList list;
+    uint32_t wordOffset = list.data.size();
+    for (uint32_t val : values) {
+      list.addWord(val);
+    }
+    list.add(wordOffset, 0, 0, values.size(), 32);
+    uint32_t packedOffset = list.data.size();
+    size_t perWord = 32 / bits;
+    for (size_t i = 0; i < values.size(); i += perWord) {
+      uint32_t word = 0;
+      for (size_t j = 0; j < perWord && i + j < values.size(); j++) {
+        word |= values[i + j] << (j * bits);
+      }
+      list.addWord(word);
+    }
+    list.add(packedOffset, 1, 0, values.size(), bits);
+
+    std::vector<Fp> dest = scatter(2, values.size(), list);
+    for (size_t i = 0; i < values.size(); i++) {
+      EXPECT_EQ(dest[i], Fp(values[i])) << "col " << i;
+      EXPECT_EQ(dest[values.size() + i], Fp(values[i])) << "col " << i;
+    }
+  }
+}
+
+TEST(Scatter, OutOfRange) {
+  std::vector<Fp> dest(4 * 8, Fp::invalid());
+  std::vector<uint32_t> data = {1, 2, 3, 4};
+  auto apply = [&](ScatterInfo info) { applyScatter(dest.data(), 4, 8, data, {info}); };
+  EXPECT_NO_THROW(apply({0, 3, 4, 4, 32}));
+  EXPECT_THROW(apply({0, 4, 0, 1, 32}), std::runtime_error);  // Row
+  EXPECT_THROW(apply({0, 0, 5, 4, 32}), std::runtime_error);  // Column
+  EXPECT_THROW(apply({1, 1, 0, 4, 32}), std::runtime_error);  // Data
+  EXPECT_THROW(apply({3, 1, 0, 33, 1}), std::runtime_error);  // Packed data
+  EXPECT_THROW(apply({0, 1, 0, 1, 4}), std::runtime_error);   // Element size
+}
+
+// Overlapping entries are fine as long as they agree
+TEST(Scatter, Overlap) {
+  std::vector<Fp> dest(2 * 8, Fp::invalid());
+  std::vector<uint32_t> data = {1, 2, 3, 4, 9};
+  applyScatter(dest.data(), 2, 8, data, {{0, 0, 0, 4, 32}, {1, 0, 1, 2, 32}});
+  EXPECT_EQ(dest[2], Fp(3));
+  EXPECT_THROW(applyScatter(dest.data(), 2, 8, data, {{4, 0, 3, 1, 32}}), std::runtime_error);
+  EXPECT_THROW(applyScatter(dest.data(), 2, 8, data, {{0, 1, 0, 1, 32}, {4, 1, 0, 1, 32}}),
+               std::runtime_error);
+}
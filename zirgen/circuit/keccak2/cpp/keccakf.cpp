@@ -0,0 +1,177 @@
+// Copyright 2024 RISC Zero, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "zirgen/circuit/keccak2/cpp/keccakf.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define KECCAK_X86_DISPATCH 1
+#endif
+
+namespace zirgen::keccak2 {
+
+namespace {
+
+const uint64_t keccak_iota[24] = {
+    0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808aULL, 0x8000000080008000ULL,
+    0x000000000000808bULL, 0x0000000080000001ULL, 0x8000000080008081ULL, 0x8000000000008009ULL,
+    0x000000000000008aULL, 0x0000000000000088ULL, 0x0000000080008009ULL, 0x000000008000000aULL,
+    0x000000008000808bULL, 0x800000000000008bULL, 0x8000000000008089ULL, 0x8000000000008003ULL,
+    0x8000000000008002ULL, 0x8000000000000080ULL, 0x000000000000800aULL, 0x800000008000000aULL,
+    0x8000000080008081ULL, 0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL};
+
+const unsigned keccak_rho[24] = {1,  3,  6,  10, 15, 21, 28, 36, 45, 55, 2,  14,
+                                 27, 41, 56, 8,  25, 43, 62, 18, 39, 61, 20, 44};
+
+const unsigned keccak_pi[24] = {10, 7,  11, 17, 18, 3, 5,  16, 8,  21, 24, 4,
+                                15, 23, 19, 13, 12, 2, 20, 14, 22, 9,  6,  1};
+
+#define ROTL64(x, y) (((x) << (y)) | ((x) >> (64 - (y))))
+
+#if defined(__GNUC__) || defined(__clang__)
+#define KECCAK_INLINE inline __attribute__((always_inline))
+#else
+#define KECCAK_INLINE inline
+#endif
+
+#ifdef KECCAK_X86_DISPATCH
+typedef uint64_t Lanes4 __attribute__((vector_size(32)));
+typedef uint64_t Lanes8 __attribute__((vector_size(64)));
+#endif
+
+template <typename W, size_t N> KECCAK_INLINE uint64_t getLane(const W& w, size_t lane) {
+  if constexpr (N == 1) {
+    return w;
+  } else {
+    return w[lane];
+  }
+}
+
+template <typename W, size_t N> KECCAK_INLINE void setLane(W& w, size_t lane, uint64_t val) {
+  if constexpr (N == 1) {
+    w = val;
+  } else {
+    w[lane] = val;
+  }
+}
+
+// Permutes N states at once, with one state in each lane of W.  Everything is
+// forced inline so that the SIMD entry points below are compiled entirely
+// with their target's instruction set.
+template <typename W, size_t N>
+KECCAK_INLINE void permuteLanes(KeccakState* states, KeccakRounds* rounds) {
+  W s[25];
+  for (size_t i = 0; i < 25; i++) {
+    for (size_t lane = 0; lane < N; lane++) {
+      setLane<W, N>(s[i], lane, states[lane][i]);
+    }
+  }
+  for (size_t round = 0; round < kKeccakRounds; round++) {
+    // Theta
+    W c[5];
+    for (size_t i = 0; i < 5; i++) {
+      c[i] = s[i] ^ s[i + 5] ^ s[i + 10] ^ s[i + 15] ^ s[i + 20];
+    }
+    if (rounds) {
+      for (size_t lane = 0; lane < N; lane++) {
+        for (size_t i = 0; i < 5; i++) {
+          rounds[lane][round].theta[i] = getLane<W, N>(c[i], lane);
+        }
+      }
+    }
+    for (size_t i = 0; i < 5; i++) {
+      W t = c[(i + 4) % 5] ^ ROTL64(c[(i + 1) % 5], 1);
+      for (size_t j = 0; j < 25; j += 5) {
+        s[j + i] ^= t;
+      }
+    }
+    // Rho Pi
+    W t1 = s[1];
+    for (size_t i = 0; i < 24; i++) {
+      size_t j = keccak_pi[i];
+      W t2 = s[j];
+      s[j] = ROTL64(t1, keccak_rho[i]);
+      t1 = t2;
+    }
+    if (rounds) {
+      for (size_t lane = 0; lane < N; lane++) {
+        for (size_t i = 0; i < 25; i++) {
+          rounds[lane][round].rhoPi[i] = getLane<W, N>(s[i], lane);
+        }
+      }
+    }
+    // Chi
+    for (size_t j = 0; j < 25; j += 5) {
+      W t[5];
+      for (size_t i = 0; i < 5; i++) {
+        t[i] = s[j + i];
+      }
+      for (size_t i = 0; i < 5; i++) {
+        s[j + i] ^= (~t[(i + 1) % 5]) & t[(i + 2) % 5];
+      }
+    }
+    // Iota
+    s[0] ^= keccak_iota[round];
+    if (rounds) {
+      for (size_t lane = 0; lane < N; lane++) {
+        for (size_t i = 0; i < 25; i++) {
+          rounds[lane][round].chiIota[i] = getLane<W, N>(s[i], lane);
+        }
+      }
+    }
+  }
+  for (size_t i = 0; i < 25; i++) {
+    for (size_t lane = 0; lane < N; lane++) {
+      states[lane][i] = getLane<W, N>(s[i], lane);
+    }
+  }
+}
+
+#ifdef KECCAK_X86_DISPATCH
+
+__attribute__((target("avx2"))) void permuteAvx2(KeccakState* states, KeccakRounds* rounds) {
+  permuteLanes<Lanes4, 4>(states, rounds);
+}
+
+__attribute__((target("avx512f"))) void permuteAvx512(KeccakState* states, KeccakRounds* rounds) {
+  permuteLanes<Lanes8, 8>(states, rounds);
+}
+
+#endif
+
+} // namespace
+
+void keccakf(KeccakState& state, KeccakRounds* rounds) {
+  permuteLanes<uint64_t, 1>(&state, rounds);
+}
+
+void keccakfBatch(KeccakState* states, KeccakRounds* rounds, size_t count) {
+  size_t i = 0;
+#ifdef KECCAK_X86_DISPATCH
+  if (__builtin_cpu_supports("avx512f")) {
+    for (; i + 8 <= count; i += 8) {
+      permuteAvx512(states + i, rounds ? rounds + i : nullptr);
+    }
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    for (; i + 4 <= count; i += 4) {
+      permuteAvx2(states + i, rounds ? rounds + i : nullptr);
+    }
+  }
+#endif
+  for (; i < count; i++) {
+    keccakf(states[i], rounds ? rounds + i : nullptr);
+  }
+}
+
+} // namespace zirgen::keccak2
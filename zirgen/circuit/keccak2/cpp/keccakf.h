@@ -0,0 +1,45 @@
+// Copyright 2024 RISC Zero, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "zirgen/circuit/keccak2/cpp/trace.h"
+
+namespace zirgen::keccak2 {
+
+constexpr size_t kKeccakRounds = 24;
+
+// The intermediate values of a single keccak-f round which the preflight
+// scatters into the trace.
+struct KeccakRoundState {
+  // Column parities computed by the first half of theta
+  std::array<uint64_t, 5> theta;
+  // State after the rest of theta, rho and pi
+  KeccakState rhoPi;
+  // State after chi and iota
+  KeccakState chiIota;
+};
+
+using KeccakRounds = std::array<KeccakRoundState, kKeccakRounds>;
+
+// Applies the keccak-f[1600] permutation to `state`, optionally recording
+// the intermediate state of each round.
+void keccakf(KeccakState& state, KeccakRounds* rounds = nullptr);
+
+// Permutes `count` independent states, optionally recording the rounds of
+// each in `rounds[i]`.  Uses 8 or 4 SIMD lanes when the host supports AVX-512
+// or AVX2, and the scalar permutation otherwise.
+void keccakfBatch(KeccakState* states, KeccakRounds* rounds, size_t count);
+
+} // namespace zirgen::keccak2
@@ -13,6 +13,8 @@
 // limitations under the License.
 
 #include "zirgen/circuit/keccak2/cpp/preflight.h"
+#include "risc0/core/parallel.h"
+#include "zirgen/circuit/keccak2/cpp/keccakf.h"
 #include "zirgen/circuit/keccak2/cpp/wrap_dsl.h"
 
 #include <arpa/inet.h>
@@ -24,64 +26,10 @@ namespace zirgen::keccak2 {
 
 namespace {
 
-// Duplicate Internal implementations of Keccak + Sha because preflight needs
-// all the details exposed.
+// Duplicate Internal implementation of Sha because preflight needs all the
+// details exposed.
 
-#define ROTL64(x, y) (((x) << (y)) | ((x) >> ((sizeof(uint64_t) * 8) - (y))))
-
-const uint64_t keccak_iota[24] = {
-    0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808aULL, 0x8000000080008000ULL,
-    0x000000000000808bULL, 0x0000000080000001ULL, 0x8000000080008081ULL, 0x8000000000008009ULL,
-    0x000000000000008aULL, 0x0000000000000088ULL, 0x0000000080008009ULL, 0x000000008000000aULL,
-    0x000000008000808bULL, 0x800000000000008bULL, 0x8000000000008089ULL, 0x8000000000008003ULL,
-    0x8000000000008002ULL, 0x8000000000000080ULL, 0x000000000000800aULL, 0x800000008000000aULL,
-    0x8000000080008081ULL, 0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL};
-
-const unsigned keccak_rho[24] = {1,  3,  6,  10, 15, 21, 28, 36, 45, 55, 2,  14,
-                                 27, 41, 56, 8,  25, 43, 62, 18, 39, 61, 20, 44};
-
-const unsigned keccak_pi[24] = {10, 7,  11, 17, 18, 3, 5,  16, 8,  21, 24, 4,
-                                15, 23, 19, 13, 12, 2, 20, 14, 22, 9,  6,  1};
-
-using keccak_t = std::array<uint64_t, 25>;
-using theta_b_t = std::array<uint64_t, 5>;
-
-theta_b_t theta_p1(const keccak_t& s) {
-  theta_b_t b;
-  for (unsigned i = 0; i < 5; i++) {
-    b[i] = s[i] ^ s[i + 5] ^ s[i + 10] ^ s[i + 15] ^ s[i + 20];
-  }
-  return b;
-}
-
-void theta_p2_rho_pi(keccak_t& s, const theta_b_t& bc) {
-  for (unsigned i = 0; i < 5; i++) {
-    uint64_t t = bc[(i + 4) % 5] ^ ROTL64(bc[(i + 1) % 5], 1);
-    for (unsigned j = 0; j < 25; j += 5) {
-      s[j + i] ^= t;
-    }
-  }
-  uint64_t t1 = s[1];
-  for (unsigned i = 0; i < 24; i++) {
-    unsigned j = keccak_pi[i];
-    uint64_t t2 = s[j];
-    s[j] = ROTL64(t1, keccak_rho[i]);
-    t1 = t2;
-  }
-}
-
-void chi_iota(keccak_t& s, uint32_t round) {
-  uint64_t t[5];
-  for (unsigned j = 0; j < 25; j += 5) {
-    for (unsigned i = 0; i < 5; i++) {
-      t[i] = s[j + i];
-    }
-    for (unsigned i = 0; i < 5; i++) {
-      s[j + i] ^= (~t[(i + 1) % 5]) & t[(i + 2) % 5];
-    }
-  }
-  s[0] ^= keccak_iota[round];
-}
+using keccak_t = KeccakState;
 
 uint32_t sha_k[64] = {
     0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
@@ -206,23 +154,40 @@ struct ControlState {
   static ControlState Init() { return ControlState{11, 0, 0, 0}; }
 };
 
-} // namespace
+// Each keccak permutation takes a fixed number of cycles: a read cycle, 4 SHA
+// blocks of 9 cycles for the input, 2 expand cycles, 24 rounds of 5 cycles, a
+// write cycle and 4 more SHA blocks for the output.
+constexpr size_t kCyclesPerInput = 1 + 4 * 9 + 2 + 24 * 5 + 1 + 4 * 9;
 
-PreflightTrace preflightSegment(const std::vector<KeccakState>& inputs, size_t cycles) {
-  auto li = getLayoutInfo();
-  PreflightTrace ret;
-  ret.preimages = inputs;
-  uint32_t curPreimage = 0;
-  uint32_t cycle = 0;
-  auto addBits = [&](uint16_t col, uint32_t data, uint16_t len) {
-    assert(len % 32 == 0);
-    ret.scatter.push_back({data, cycle, col, len, 1});
-  };
-  auto addShorts = [&](uint16_t col, uint32_t data, uint16_t len) {
-    assert(len % 2 == 0);
-    ret.scatter.push_back({data, cycle, col, len, 16});
-  };
-  auto addCycle = [&](const ControlState& cstate, uint32_t bits, uint32_t kflat, uint32_t sflat) {
+// Don't bother splitting up the preflight into less than this many inputs per thread
+constexpr size_t kMinInputsPerThread = 16;
+
+// Number of permutations to compute at once when recording rounds
+constexpr size_t kBatchSize = 8;
+
+// Builds preflight data for a contiguous range of cycles.  All offsets written
+// into the scatter list are relative to the start of this builder's data.
+class PreflightBuilder {
+public:
+  PreflightBuilder(PreflightTrace& ret, uint32_t cycle, uint32_t curPreimage)
+      : ret(ret), li(getLayoutInfo()), cycle(cycle), curPreimage(curPreimage) {}
+
+  uint32_t getCycle() const { return cycle; }
+
+  uint32_t writeZeros() {
+    // 100 zeros (for whereever we need zero)
+    uint32_t offset = ret.data.size();
+    ret.data.resize(offset + 100, 0);
+    return offset;
+  }
+
+  uint32_t writeShaState(const sha_state& state) {
+    uint32_t offset = ret.data.size();
+    ret.data.insert(ret.data.end(), state.begin(), state.end());
+    return offset;
+  }
+
+  void addCycle(const ControlState& cstate, uint32_t bits, uint32_t kflat, uint32_t sflat) {
     uint32_t offset = ret.data.size();
     ret.data.push_back(cstate.asWord());
     ret.scatter.push_back({offset, cycle, uint16_t(li.control), 4, 8});
@@ -234,8 +199,75 @@ PreflightTrace preflightSegment(const std::vector<KeccakState>& inputs, size_t c
     addShorts(li.sflat, sflat, 16);
     ret.curPreimage.push_back(curPreimage);
     cycle++;
-  };
-  auto writeTheta = [&](const theta_b_t& theta) {
+  }
+
+  // Adds all the cycles for a single keccak permutation of preimage number
+  // `input`, starting with the given sha state.  `rounds` holds the
+  // intermediate states of the permutation.
+  void addInput(uint32_t input,
+                const KeccakState& preimage,
+                const KeccakRounds& rounds,
+                sha_state currentSha) {
+    std::vector<uint32_t> data;
+    curPreimage = input;
+    size_t sflatOffset = writeShaState(currentSha);
+    // Do 'read' cycle
+    size_t kflatOffset = writeKFlat(data, preimage);
+    addCycle(ControlState::Read(), writeShaInfo(sha_info(currentSha)), kflatOffset, sflatOffset);
+    curPreimage++;
+    // Sha and write all for blocks
+    for (size_t block = 0; block < 4; block++) {
+      auto infos = compute_sha_infos(currentSha, data.data() + 16 * block);
+      for (size_t i = 0; i < 8; i++) {
+        addCycle(ControlState::ShaIn(block, i), writeShaInfo(infos[i]), kflatOffset, sflatOffset);
+      }
+      sflatOffset = writeShaState(currentSha);
+      addCycle(
+          ControlState::ShaNextBlockIn(block), writeShaInfo(infos[8]), kflatOffset, sflatOffset);
+    }
+    // Expand
+    addCycle(ControlState::Expand(0), writeKeccak(preimage, false), kflatOffset, sflatOffset);
+    addCycle(ControlState::Expand(1), writeKeccak(preimage, true), kflatOffset, sflatOffset);
+    // Now do the Keccack cycles
+    for (size_t round = 0; round < kKeccakRounds; round++) {
+      const auto& info = rounds[round];
+      addCycle(ControlState::Keccak0(round), writeTheta(info.theta), kflatOffset, sflatOffset);
+      addCycle(
+          ControlState::Keccak1(round), writeKeccak(info.rhoPi, false), kflatOffset, sflatOffset);
+      addCycle(
+          ControlState::Keccak2(round), writeKeccak(info.rhoPi, true), kflatOffset, sflatOffset);
+      addCycle(
+          ControlState::Keccak3(round), writeKeccak(info.chiIota, false), kflatOffset, sflatOffset);
+      addCycle(
+          ControlState::Keccak4(round), writeKeccak(info.chiIota, true), kflatOffset, sflatOffset);
+    }
+    // Do 'write' cycle
+    kflatOffset = writeKFlat(data, rounds.back().chiIota);
+    addCycle(ControlState::Write(), writeShaInfo(sha_info(currentSha)), kflatOffset, sflatOffset);
+    // Sha and write all for blocks
+    for (size_t block = 0; block < 4; block++) {
+      auto infos = compute_sha_infos(currentSha, data.data() + 16 * block);
+      for (size_t i = 0; i < 8; i++) {
+        addCycle(ControlState::ShaOut(block, i), writeShaInfo(infos[i]), kflatOffset, sflatOffset);
+      }
+      sflatOffset = writeShaState(currentSha);
+      addCycle(
+          ControlState::ShaNextBlockOut(block), writeShaInfo(infos[8]), kflatOffset, sflatOffset);
+    }
+  }
+
+private:
+  void addBits(uint16_t col, uint32_t data, uint16_t len) {
+    assert(len % 32 == 0);
+    ret.scatter.push_back({data, cycle, col, len, 1});
+  }
+
+  void addShorts(uint16_t col, uint32_t data, uint16_t len) {
+    assert(len % 2 == 0);
+    ret.scatter.push_back({data, cycle, col, len, 16});
+  }
+
+  uint32_t writeTheta(const std::array<uint64_t, 5>& theta) {
     uint32_t offset = ret.data.size();
     for (size_t i = 0; i < 5; i++) {
       ret.data.push_back(theta[i]);
@@ -245,8 +277,9 @@ PreflightTrace preflightSegment(const std::vector<KeccakState>& inputs, size_t c
       ret.data.push_back(0);
     }
     return offset;
-  };
-  auto writeKeccak = [&](const keccak_t& s, bool high) {
+  }
+
+  uint32_t writeKeccak(const keccak_t& s, bool high) {
     uint32_t offset = ret.data.size();
     for (size_t i = 0; i < 25; i++) {
       if (high) {
@@ -256,8 +289,9 @@ PreflightTrace preflightSegment(const std::vector<KeccakState>& inputs, size_t c
       }
     }
     return offset;
-  };
-  auto writeKFlat = [&](std::vector<uint32_t>& data, const keccak_t& s) {
+  }
+
+  uint32_t writeKFlat(std::vector<uint32_t>& data, const keccak_t& s) {
     data.clear();
     // Write in normal order
     for (size_t i = 0; i < 25; i++) {
@@ -270,15 +304,9 @@ PreflightTrace preflightSegment(const std::vector<KeccakState>& inputs, size_t c
       data.push_back(0); // Pad out sha blocks
     }
     return offset;
-  };
-  auto writeShaState = [&](const sha_state& state) {
-    uint32_t offset = ret.data.size();
-    for (size_t i = 0; i < 8; i++) {
-      ret.data.push_back(state[i]);
-    }
-    return offset;
-  };
-  auto writeShaInfo = [&](const sha_info& info) {
+  }
+
+  uint32_t writeShaInfo(const sha_info& info) {
     uint32_t offset = ret.data.size();
     for (size_t i = 0; i < 8; i++) {
       ret.data.push_back(info.a[i]);
@@ -291,84 +319,130 @@ PreflightTrace preflightSegment(const std::vector<KeccakState>& inputs, size_t c
     }
     ret.data.push_back(0);
     return offset;
-  };
-  // 100 zeros @ offset zero (for whereever we need zero)
-  uint32_t zeroOffset = ret.data.size();
-  for (size_t i = 0; i < 100; i++) {
-    ret.data.push_back(0);
   }
-  // Initalize sha state (and current data offset)
-  sha_state currentSha = sha_init;
-  size_t sflatOffset = writeShaState(currentSha);
-  // Do an initial 'init' cycle
-  addCycle(ControlState::Init(), zeroOffset, zeroOffset, sflatOffset);
-  // Do each permutation
-  for (size_t input = 0; input < inputs.size(); input++) {
-    KeccakState kstate = inputs[input];
-    std::vector<uint32_t> data;
-    // Do 'read' cycle
-    size_t kflatOffset = writeKFlat(data, kstate);
-    addCycle(ControlState::Read(), writeShaInfo(sha_info(currentSha)), kflatOffset, sflatOffset);
-    curPreimage++;
-    // Sha and write all for blocks
-    for (size_t block = 0; block < 4; block++) {
-      auto infos = compute_sha_infos(currentSha, data.data() + 16 * block);
-      for (size_t i = 0; i < 8; i++) {
-        addCycle(ControlState::ShaIn(block, i), writeShaInfo(infos[i]), kflatOffset, sflatOffset);
+
+  PreflightTrace& ret;
+  LayoutInfo li;
+  uint32_t cycle;
+  uint32_t curPreimage;
+};
+
+// Applies the sha compression function to the 64 byte-swapped words of a
+// keccak state, as done by the SHA cycles of each permutation.
+void sha_keccak_state(sha_state& state, const keccak_t& s) {
+  std::array<uint32_t, 64> data = {0};
+  for (size_t i = 0; i < 25; i++) {
+    data[2 * i] = s[i];
+    data[2 * i + 1] = s[i] >> 32;
+  }
+  for (size_t block = 0; block < 4; block++) {
+    compute_sha_infos(state, data.data() + 16 * block);
+  }
+}
+
+// Appends `part` to `ret`, relocating the scatter data offsets.  `ret` must
+// already be large enough; `dataPos`, `scatterPos` and `cyclePos` are where
+// to place the part within it.
+void copyPart(PreflightTrace& ret,
+              const PreflightTrace& part,
+              size_t dataPos,
+              size_t scatterPos,
+              size_t cyclePos) {
+  std::copy(part.data.begin(), part.data.end(), ret.data.begin() + dataPos);
+  std::copy(part.curPreimage.begin(), part.curPreimage.end(), ret.curPreimage.begin() + cyclePos);
+  for (size_t i = 0; i < part.scatter.size(); i++) {
+    ScatterInfo info = part.scatter[i];
+    info.dataOffset += dataPos;
+    ret.scatter[scatterPos + i] = info;
+  }
+}
+
+} // namespace
+
+PreflightTrace preflightSegment(const std::vector<KeccakState>& inputs, size_t cycles) {
+  if (1 + inputs.size() * kCyclesPerInput > cycles) {
+    throw std::runtime_error("Too many keccak inputs for segment");
+  }
+
+  // The only dependency between permutations is the running sha digest, so
+  // compute the outputs in parallel, and then chain the digest serially.
+  std::vector<keccak_t> outputs = inputs;
+  risc0::parallelForBlocks(0, inputs.size(), [&](size_t begin, size_t end) {
+    keccakfBatch(outputs.data() + begin, nullptr, end - begin);
+  });
+  std::vector<sha_state> shaStates(inputs.size() + 1);
+  shaStates[0] = sha_init;
+  for (size_t i = 0; i < inputs.size(); i++) {
+    sha_state state = shaStates[i];
+    sha_keccak_state(state, inputs[i]);
+    sha_keccak_state(state, outputs[i]);
+    shaStates[i + 1] = state;
+  }
+
+  // Part 0 is the initial cycle, the last part contains the shutdown cycles,
+  // and the rest contain a block of inputs each.
+  size_t blocks = std::max<size_t>(
+      1, std::min(risc0::getParallelism(), inputs.size() / kMinInputsPerThread));
+  std::vector<PreflightTrace> parts(blocks + 2);
+  {
+    PreflightBuilder builder(parts.front(), 0, 0);
+    uint32_t zeroOffset = builder.writeZeros();
+    uint32_t sflatOffset = builder.writeShaState(sha_init);
+    // Do an initial 'init' cycle
+    builder.addCycle(ControlState::Init(), zeroOffset, zeroOffset, sflatOffset);
+  }
+  risc0::parallelFor(0, blocks, [&](size_t block) {
+    size_t begin = inputs.size() * block / blocks;
+    size_t end = inputs.size() * (block + 1) / blocks;
+    PreflightBuilder builder(parts[block + 1], 1 + begin * kCyclesPerInput, begin);
+    // Record the rounds of a few permutations at a time, so they can share SIMD lanes
+    std::array<KeccakState, kBatchSize> states;
+    std::array<KeccakRounds, kBatchSize> rounds;
+    for (size_t batch = begin; batch < end; batch += kBatchSize) {
+      size_t count = std::min(kBatchSize, end - batch);
+      std::copy(inputs.begin() + batch, inputs.begin() + batch + count, states.begin());
+      keccakfBatch(states.data(), rounds.data(), count);
+      for (size_t i = 0; i < count; i++) {
+        builder.addInput(batch + i, inputs[batch + i], rounds[i], shaStates[batch + i]);
       }
-      sflatOffset = writeShaState(currentSha);
-      addCycle(
-          ControlState::ShaNextBlockIn(block), writeShaInfo(infos[8]), kflatOffset, sflatOffset);
     }
-    // Expand
-    addCycle(ControlState::Expand(0), writeKeccak(kstate, false), kflatOffset, sflatOffset);
-    addCycle(ControlState::Expand(1), writeKeccak(kstate, true), kflatOffset, sflatOffset);
-    // Now do the Keccack cycles
-    for (size_t round = 0; round < 24; round++) {
-      auto theta = theta_p1(kstate);
-      addCycle(ControlState::Keccak0(round), writeTheta(theta), kflatOffset, sflatOffset);
-      theta_p2_rho_pi(kstate, theta);
-      addCycle(ControlState::Keccak1(round), writeKeccak(kstate, false), kflatOffset, sflatOffset);
-      addCycle(ControlState::Keccak2(round), writeKeccak(kstate, true), kflatOffset, sflatOffset);
-      chi_iota(kstate, round);
-      addCycle(ControlState::Keccak3(round), writeKeccak(kstate, false), kflatOffset, sflatOffset);
-      addCycle(ControlState::Keccak4(round), writeKeccak(kstate, true), kflatOffset, sflatOffset);
-    }
-    // Do 'write' cycle
-    kflatOffset = writeKFlat(data, kstate);
-    addCycle(ControlState::Write(), writeShaInfo(sha_info(currentSha)), kflatOffset, sflatOffset);
-    // Sha and write all for blocks
-    for (size_t block = 0; block < 4; block++) {
-      auto infos = compute_sha_infos(currentSha, data.data() + 16 * block);
-      for (size_t i = 0; i < 8; i++) {
-        addCycle(ControlState::ShaOut(block, i), writeShaInfo(infos[i]), kflatOffset, sflatOffset);
-      }
-      sflatOffset = writeShaState(currentSha);
-      addCycle(
-          ControlState::ShaNextBlockOut(block), writeShaInfo(infos[8]), kflatOffset, sflatOffset);
+  });
+  {
+    PreflightBuilder builder(parts.back(), 1 + inputs.size() * kCyclesPerInput, inputs.size());
+    uint32_t zeroOffset = builder.writeZeros();
+    uint32_t sflatOffset = builder.writeShaState(shaStates.back());
+    // Do 'shudown' cycles until we are done
+    while (builder.getCycle() < cycles) {
+      builder.addCycle(ControlState::Shutdown(), zeroOffset, zeroOffset, sflatOffset);
     }
   }
-  // Do 'shudown' cycles until we are done
-  while (cycle < cycles) {
-    addCycle(ControlState::Shutdown(), zeroOffset, zeroOffset, sflatOffset);
-  }
 
+  // Concatenate all the parts together
+  std::vector<size_t> dataPos(parts.size() + 1);
+  std::vector<size_t> scatterPos(parts.size() + 1);
+  std::vector<size_t> cyclePos(parts.size() + 1);
+  for (size_t i = 0; i < parts.size(); i++) {
+    dataPos[i + 1] = dataPos[i] + parts[i].data.size();
+    scatterPos[i + 1] = scatterPos[i] + parts[i].scatter.size();
+    cyclePos[i + 1] = cyclePos[i] + parts[i].curPreimage.size();
+  }
+  PreflightTrace ret;
+  ret.preimages = inputs;
+  ret.data.resize(dataPos.back());
+  ret.scatter.resize(scatterPos.back());
+  ret.curPreimage.resize(cyclePos.back());
+  risc0::parallelFor(0, parts.size(), [&](size_t i) {
+    copyPart(ret, parts[i], dataPos[i], scatterPos[i], cyclePos[i]);
+  });
   return ret;
 }
 
 void applyPreflight(ExecutionTrace& exec, const PreflightTrace& preflight) {
-  for (const auto& info : preflight.scatter) {
-    uint32_t innerCount = 32 / info.bitPerElem;
-    uint32_t mask = (1 << (info.bitPerElem)) - 1;
-    for (size_t i = 0; i < info.count; i++) {
-      uint32_t word = preflight.data[info.dataOffset + (i / innerCount)];
-      size_t j = i % innerCount;
-      uint32_t val = (word >> (j * info.bitPerElem)) & mask;
-      // std::cout << "row = " << info.row << ", col = " << info.column + i << ", val = " << val <<
-      // "\n";
-      exec.data.set(info.row, info.column + i, val);
-    }
-  }
+  applyScatter(exec.data.getBuffer(),
+               exec.data.getRows(),
+               exec.data.getCols(),
+               preflight.data,
+               preflight.scatter);
 }
 
 } // namespace zirgen::keccak2
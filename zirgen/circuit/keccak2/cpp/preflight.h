@@ -14,18 +14,11 @@
 
 #pragma once
 
+#include "zirgen/circuit/common/scatter.h"
 #include "zirgen/circuit/keccak2/cpp/trace.h"
 
 namespace zirgen::keccak2 {
 
-struct ScatterInfo {
-  uint32_t dataOffset; // Place to get the data from (as u32 words)
-  uint32_t row;        // Cycle # to write to
-  uint16_t column;     // Column number to start at
-  uint16_t count;      // Number of words to write
-  uint16_t bitPerElem; // How many bits per element
-};
-
 struct PreflightTrace {
   // All the preimages
   std::vector<std::array<uint64_t, 25>> preimages;
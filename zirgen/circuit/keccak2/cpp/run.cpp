@@ -0,0 +1,34 @@
+// Copyright 2024 RISC Zero, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "zirgen/circuit/keccak2/cpp/run.h"
+#include "zirgen/circuit/keccak2/cpp/wrap_dsl.h"
+
+namespace zirgen::keccak2 {
+
+ExecutionTrace runSegment(const std::vector<KeccakState>& inputs, size_t cycles) {
+  auto preflight = preflightSegment(inputs, cycles);
+  ExecutionTrace trace(cycles, getDslParams());
+  applyPreflight(trace, preflight);
+  // The step code included here is built without --parallel-witgen, so a step
+  // may read values written by the steps of earlier rows, and rows must be
+  // computed in order.
+  for (size_t cycle = 0; cycle < cycles; cycle++) {
+    StepHandler ctx(preflight, cycle);
+    DslStep(ctx, trace, cycle);
+  }
+  return trace;
+}
+
+} // namespace zirgen::keccak2
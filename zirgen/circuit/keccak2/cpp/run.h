@@ -0,0 +1,26 @@
+// Copyright 2024 RISC Zero, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "zirgen/circuit/keccak2/cpp/preflight.h"
+
+namespace zirgen::keccak2 {
+
+// Builds the full execution trace for a segment of `cycles` rows that
+// permutes each of `inputs` in turn.  Preflight and scatter are spread across
+// threads; the witness steps then run row by row.
+ExecutionTrace runSegment(const std::vector<KeccakState>& inputs, size_t cycles);
+
+} // namespace zirgen::keccak2
@@ -0,0 +1,81 @@
+// Copyright 2024 RISC Zero, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <random>
+
+#include "zirgen/circuit/keccak2/cpp/keccakf.h"
+
+using namespace zirgen::keccak2;
+
+namespace {
+
+std::vector<KeccakState> randomStates(size_t count) {
+  std::mt19937_64 rng(count);
+  std::vector<KeccakState> states(count);
+  for (auto& state : states) {
+    for (auto& lane : state) {
+      lane = rng();
+    }
+  }
+  return states;
+}
+
+void expectRoundsEq(const KeccakRounds& lhs, const KeccakRounds& rhs) {
+  for (size_t round = 0; round < kKeccakRounds; round++) {
+    SCOPED_TRACE("round " + std::to_string(round));
+    EXPECT_EQ(lhs[round].theta, rhs[round].theta);
+    EXPECT_EQ(lhs[round].rhoPi, rhs[round].rhoPi);
+    EXPECT_EQ(lhs[round].chiIota, rhs[round].chiIota);
+  }
+}
+
+// Checks keccakfBatch against the scalar permutation, with and without
+// recording rounds.  The sizes cover an empty batch, a lone state, remainders
+// after the 8 and 4 lane paths, and a large batch.
+class KeccakfBatch : public testing::TestWithParam<size_t> {};
+
+} // namespace
+
+TEST(Keccakf, ZeroState) {
+  // First lane of keccak-f[1600] applied once to the all zero state
+  KeccakState state = {};
+  keccakf(state);
+  EXPECT_EQ(state[0], 0xf1258f7940e1dde7ULL);
+}
+
+TEST_P(KeccakfBatch, MatchesScalar) {
+  size_t count = GetParam();
+  std::vector<KeccakState> expected = randomStates(count);
+  std::vector<KeccakRounds> expectedRounds(count);
+  for (size_t i = 0; i < count; i++) {
+    keccakf(expected[i], &expectedRounds[i]);
+  }
+
+  std::vector<KeccakState> states = randomStates(count);
+  keccakfBatch(states.data(), nullptr, count);
+  EXPECT_EQ(states, expected);
+
+  states = randomStates(count);
+  std::vector<KeccakRounds> rounds(count);
+  keccakfBatch(states.data(), rounds.data(), count);
+  for (size_t i = 0; i < count; i++) {
+    SCOPED_TRACE("state " + std::to_string(i));
+    EXPECT_EQ(states[i], expected[i]);
+    expectRoundsEq(rounds[i], expectedRounds[i]);
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(Sizes, KeccakfBatch, testing::Values(0, 1, 3, 7, 13, 1000));
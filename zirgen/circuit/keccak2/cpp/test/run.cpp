@@ -0,0 +1,89 @@
+// Copyright 2024 RISC Zero, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <random>
+
+#include "risc0/core/parallel.h"
+#include "zirgen/circuit/keccak2/cpp/run.h"
+
+using namespace zirgen;
+using namespace zirgen::keccak2;
+
+namespace {
+
+// Enough inputs for preflight to split them into several blocks of at least
+// 16 inputs each
+constexpr size_t kInputs = 64;
+constexpr size_t kThreads = 4;
+constexpr size_t kCycles = 16384;
+
+std::vector<KeccakState> randomInputs() {
+  std::mt19937_64 rng(2);
+  std::vector<KeccakState> inputs(kInputs);
+  for (auto& state : inputs) {
+    for (auto& lane : state) {
+      lane = rng();
+    }
+  }
+  return inputs;
+}
+
+void expectPreflightEq(const PreflightTrace& lhs, const PreflightTrace& rhs) {
+  EXPECT_EQ(lhs.preimages, rhs.preimages);
+  EXPECT_EQ(lhs.curPreimage, rhs.curPreimage);
+  EXPECT_EQ(lhs.data, rhs.data);
+  ASSERT_EQ(lhs.scatter.size(), rhs.scatter.size());
+  for (size_t i = 0; i < lhs.scatter.size(); i++) {
+    SCOPED_TRACE("scatter " + std::to_string(i));
+    EXPECT_EQ(lhs.scatter[i].dataOffset, rhs.scatter[i].dataOffset);
+    EXPECT_EQ(lhs.scatter[i].row, rhs.scatter[i].row);
+    EXPECT_EQ(lhs.scatter[i].column, rhs.scatter[i].column);
+    EXPECT_EQ(lhs.scatter[i].count, rhs.scatter[i].count);
+    EXPECT_EQ(lhs.scatter[i].bitPerElem, rhs.scatter[i].bitPerElem);
+  }
+}
+
+} // namespace
+
+// Splitting preflight and scatter across threads must not change the trace
+TEST(Keccak2, ParallelMatchesSerial) {
+  auto inputs = randomInputs();
+
+  risc0::setParallelism(1);
+  PreflightTrace serialPreflight = preflightSegment(inputs, kCycles);
+  ExecutionTrace serial = runSegment(inputs, kCycles);
+
+  risc0::setParallelism(kThreads);
+  PreflightTrace parallelPreflight = preflightSegment(inputs, kCycles);
+  ExecutionTrace parallel = runSegment(inputs, kCycles);
+  risc0::setParallelism(0);
+
+  expectPreflightEq(serialPreflight, parallelPreflight);
+
+  size_t rows = serial.data.getRows();
+  size_t cols = serial.data.getCols();
+  ASSERT_EQ(parallel.data.getRows(), rows);
+  ASSERT_EQ(parallel.data.getCols(), cols);
+  EXPECT_EQ(memcmp(serial.data.getBuffer(), parallel.data.getBuffer(), rows * cols * sizeof(Fp)),
+            0);
+  ASSERT_EQ(parallel.global.getCols(), serial.global.getCols());
+  serial.global.setUnsafe();
+  parallel.global.setUnsafe();
+  for (size_t col = 0; col < serial.global.getCols(); col++) {
+    EXPECT_EQ(serial.global.get(col), parallel.global.get(col)) << "global " << col;
+  }
+}
@@ -32,6 +32,9 @@ public:
   size_t getRows() { return rows; }
   size_t getCols() { return cols; }
 
+  // Raw row major access to the trace, for bulk initialization
+  Fp* getBuffer() { return vec.data(); }
+
   void set(size_t row, size_t col, Fp val);
   Fp get(size_t row, size_t col);
   void setUnset();
@@ -0,0 +1,307 @@
+// Copyright 2024 RISC Zero, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Benchmarks for the rv32im v2 executor, preflight and trace generation.
+//
+// Usage: bench [--po2=N] [--filter=NAME] [--skip-run] [--out=FILE] [--profile=DIR]
+//
+// Each workload is executed, preflighted (both by emulation and from a
+// recording made by the executor) and run through runSegment, and the timings
+// are written as JSON to FILE, or to stdout if no file is given.  With
+// --profile, each workload is also executed with a Profiler, and its cycle
+// profile written to DIR/<workload>.pb for use with pprof.
+
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+
+#include "zirgen/circuit/rv32im/v2/emu/preflight.h"
+#include "zirgen/circuit/rv32im/v2/emu/profile.h"
+#include "zirgen/circuit/rv32im/v2/run/run.h"
+
+using namespace zirgen::rv32im_v2;
+
+namespace {
+
+const std::string kernelName = "zirgen/circuit/rv32im/v2/kernel/kernel";
+const std::string guestName = "zirgen/circuit/rv32im/v2/bench/guest";
+const std::string p2KernelName = "zirgen/circuit/rv32im/v2/bench/p2_kernel";
+
+// Workload selectors understood by the guest
+enum GuestWorkload : uint32_t {
+  MEMORY_STREAM = 0,
+  BRANCHY = 1,
+  HOST_IO = 2,
+  PAGING = 3,
+};
+
+struct Workload {
+  std::string name;
+  std::function<MemoryImage()> loadImage;
+  std::function<void(TestIoHandler&)> setupIo;
+  // ELF files to take profiling symbols from
+  std::vector<std::string> elfs;
+};
+
+MemoryImage guestImage() {
+  return MemoryImage::fromElfs(kernelName, guestName);
+}
+
+Workload guestWorkload(const std::string& name, uint32_t mode, uint32_t scale) {
+  return {name, guestImage, [=](TestIoHandler& io) {
+            io.push_u32(0, mode);
+            io.push_u32(0, scale);
+            if (mode == HOST_IO) {
+              for (size_t i = 0; i < scale * 13; i++) {
+                io.input[0].push_back(i);
+              }
+            }
+          },
+          {kernelName, guestName}};
+}
+
+std::vector<Workload> getWorkloads() {
+  return {
+      guestWorkload("memory_stream", MEMORY_STREAM, 8),
+      guestWorkload("branchy", BRANCHY, 3000),
+      guestWorkload("host_io", HOST_IO, 4000),
+      guestWorkload("paging", PAGING, 1024),
+      {"poseidon2",
+       [] { return MemoryImage::fromRawElf(p2KernelName); },
+       [](TestIoHandler& io) { io.push_u32(0, 2000); },
+       {p2KernelName}},
+  };
+}
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Times `fn` and returns the elapsed seconds
+template <typename F> double timed(F fn) {
+  auto start = Clock::now();
+  fn();
+  return secondsSince(start);
+}
+
+double rate(double count, double seconds) {
+  return seconds > 0 ? count / seconds : 0;
+}
+
+struct PhaseResult {
+  std::string name;
+  double seconds;
+  // The amount of work done, and the rate in the given unit
+  std::string unit;
+  double count;
+  double throughput;
+};
+
+struct WorkloadResult {
+  std::string name;
+  size_t segments = 0;
+  size_t execCycles = 0;
+  size_t pagingCycles = 0;
+  // Pages held by all segment images, counting shared pages once per segment
+  size_t segmentPages = 0;
+  // Distinct pages actually allocated for those images
+  size_t uniquePages = 0;
+  std::vector<PhaseResult> phases;
+};
+
+WorkloadResult runWorkload(const Workload& workload,
+                           size_t segmentPo2,
+                           bool skipRun,
+                           const std::string& profileDir) {
+  size_t segmentSize = size_t(1) << segmentPo2;
+  // Leave some slack for the cycles of the instruction which crosses the threshold
+  size_t threshold = segmentSize * 125 / 128;
+  size_t maxCycles = 100 * 1000 * 1000;
+
+  WorkloadResult result;
+  result.name = workload.name;
+
+  std::vector<Segment> segments;
+  double execTime = timed([&] {
+    auto image = workload.loadImage();
+    TestIoHandler io;
+    workload.setupIo(io);
+    segments = execute(image, io, threshold, maxCycles);
+  });
+  result.segments = segments.size();
+  for (const auto& segment : segments) {
+    result.execCycles += segment.suspendCycle;
+    result.pagingCycles += segment.pagingCycles;
+    result.segmentPages += segment.image.getKnownPages().size();
+  }
+  result.uniquePages = PageStore::global().size();
+  result.phases.push_back({"execute",
+                           execTime,
+                           "MIPS",
+                           double(result.execCycles),
+                           rate(result.execCycles, execTime) / 1e6});
+
+  std::vector<Segment> recorded;
+  double recordTime = timed([&] {
+    auto image = workload.loadImage();
+    TestIoHandler io;
+    workload.setupIo(io);
+    recorded = execute(image, io, threshold, maxCycles, zirgen::Digest::zero(), true);
+  });
+  result.phases.push_back({"execute_record",
+                           recordTime,
+                           "MIPS",
+                           double(result.execCycles),
+                           rate(result.execCycles, recordTime) / 1e6});
+
+  if (!profileDir.empty()) {
+    Profiler profiler;
+    for (const auto& elf : workload.elfs) {
+      profiler.addSymbols(elf);
+    }
+    double profileTime = timed([&] {
+      auto image = workload.loadImage();
+      TestIoHandler io;
+      workload.setupIo(io);
+      execute(image, io, threshold, maxCycles, zirgen::Digest::zero(), false, &profiler);
+    });
+    result.phases.push_back({"execute_profile",
+                             profileTime,
+                             "MIPS",
+                             double(result.execCycles),
+                             rate(result.execCycles, profileTime) / 1e6});
+    std::ofstream out(profileDir + "/" + workload.name + ".pb", std::ios::binary);
+    profiler.writePprof(out);
+  }
+
+  size_t traceCycles = 0;
+  double preflightTime = timed([&] {
+    for (const auto& segment : segments) {
+      traceCycles += preflightSegment(segment, segmentSize).cycles.size();
+    }
+  });
+  result.phases.push_back({"preflight",
+                           preflightTime,
+                           "cycles/s",
+                           double(traceCycles),
+                           rate(traceCycles, preflightTime)});
+
+  double replayTime = timed([&] {
+    for (const auto& segment : recorded) {
+      preflightSegment(segment, segmentSize);
+    }
+  });
+  result.phases.push_back({"preflight_replay",
+                           replayTime,
+                           "cycles/s",
+                           double(traceCycles),
+                           rate(traceCycles, replayTime)});
+
+  if (!skipRun) {
+    size_t rows = 0;
+    double runTime = timed([&] {
+      for (const auto& segment : recorded) {
+        rows += runSegment(segment, segmentSize).data.getRows();
+      }
+    });
+    result.phases.push_back({"run_segment", runTime, "rows/s", double(rows), rate(rows, runTime)});
+  }
+  return result;
+}
+
+std::string jsonEscape(const std::string& str) {
+  std::string out;
+  for (char c : str) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+    }
+    out += c;
+  }
+  return out;
+}
+
+void writeJson(std::ostream& os, size_t segmentPo2, const std::vector<WorkloadResult>& results) {
+  os << "{\n  \"segment_po2\": " << segmentPo2 << ",\n  \"workloads\": [";
+  for (size_t i = 0; i < results.size(); i++) {
+    const auto& result = results[i];
+    os << (i ? "," : "") << "\n    {\n";
+    os << "      \"name\": \"" << jsonEscape(result.name) << "\",\n";
+    os << "      \"segments\": " << result.segments << ",\n";
+    os << "      \"exec_cycles\": " << result.execCycles << ",\n";
+    os << "      \"paging_cycles\": " << result.pagingCycles << ",\n";
+    size_t totalCycles = result.execCycles + result.pagingCycles;
+    os << "      \"paging_overhead\": "
+       << (totalCycles ? double(result.pagingCycles) / totalCycles : 0) << ",\n";
+    os << "      \"segment_pages\": " << result.segmentPages << ",\n";
+    os << "      \"unique_pages\": " << result.uniquePages << ",\n";
+    os << "      \"phases\": [";
+    for (size_t j = 0; j < result.phases.size(); j++) {
+      const auto& phase = result.phases[j];
+      os << (j ? "," : "") << "\n        {\"name\": \"" << phase.name
+         << "\", \"seconds\": " << phase.seconds << ", \"count\": " << phase.count
+         << ", \"unit\": \"" << phase.unit << "\", \"rate\": " << phase.throughput << "}";
+    }
+    os << "\n      ]\n    }";
+  }
+  os << "\n  ]\n}\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  size_t segmentPo2 = 16;
+  std::string filter;
+  std::string outPath;
+  std::string profileDir;
+  bool skipRun = false;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg.rfind("--po2=", 0) == 0) {
+      segmentPo2 = std::stoul(arg.substr(6));
+    } else if (arg.rfind("--filter=", 0) == 0) {
+      filter = arg.substr(9);
+    } else if (arg.rfind("--out=", 0) == 0) {
+      outPath = arg.substr(6);
+    } else if (arg.rfind("--profile=", 0) == 0) {
+      profileDir = arg.substr(10);
+    } else if (arg == "--skip-run") {
+      skipRun = true;
+    } else {
+      std::cerr << "Usage: " << argv[0]
+                << " [--po2=N] [--filter=NAME] [--skip-run] [--out=FILE] [--profile=DIR]\n";
+      return 1;
+    }
+  }
+
+  std::vector<WorkloadResult> results;
+  for (const auto& workload : getWorkloads()) {
+    if (!filter.empty() && workload.name.find(filter) == std::string::npos) {
+      continue;
+    }
+    std::cerr << "Running " << workload.name << "\n";
+    results.push_back(runWorkload(workload, segmentPo2, skipRun, profileDir));
+  }
+
+  if (outPath.empty()) {
+    writeJson(std::cout, segmentPo2, results);
+  } else {
+    std::ofstream out(outPath);
+    writeJson(out, segmentPo2, results);
+  }
+  return 0;
+}
@@ -0,0 +1,106 @@
+#!/usr/bin/env python
+#
+# Compares the generated rv32im v2 witness code with and without
+# --codegen-reuse-var-slots: how long the generated code takes to compile, how
+# big the resulting object is, and how long runSegment takes per row.
+#
+# Usage (from the root of the repository):
+#   zirgen/circuit/rv32im/v2/bench/codegen_bench.py [--filter=NAME] [--out=FILE] [-- BAZEL_ARGS]
+#
+# Results are written as JSON to FILE, or to stdout if no file is given.
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+FLAG = "--//zirgen/circuit/rv32im/v2/dsl:reuse_var_slots="
+RUN_TARGET = "//zirgen/circuit/rv32im/v2/run"
+BENCH_TARGET = "//zirgen/circuit/rv32im/v2/bench"
+COMPILED_SOURCE = "zirgen/circuit/rv32im/v2/run/wrap_dsl.cpp"
+
+
+def bazel(args, **kwargs):
+    return subprocess.run(["bazel"] + args, check=True, **kwargs)
+
+
+def find_compile_action(bazel_args):
+    aquery = bazel(
+        ["aquery", "--output=jsonproto"] + bazel_args +
+        [f'mnemonic("CppCompile", {RUN_TARGET})'],
+        stdout=subprocess.PIPE,
+    )
+    for action in json.loads(aquery.stdout).get("actions", []):
+        if COMPILED_SOURCE in action["arguments"]:
+            return action
+    sys.exit(f"No compile action found for {COMPILED_SOURCE}")
+
+
+def time_compile(bazel_args):
+    # Build everything first so the generated code and headers are in place,
+    # then time compiling just the file including the generated code.
+    bazel(["build"] + bazel_args + [RUN_TARGET])
+    execroot = bazel(["info", "execution_root"] + bazel_args,
+                     stdout=subprocess.PIPE, text=True).stdout.strip()
+    action = find_compile_action(bazel_args)
+    args = action["arguments"]
+    env = dict(os.environ)
+    env.update({var["key"]: var["value"] for var in action.get("environmentVariables", [])})
+
+    start = time.monotonic()
+    subprocess.run(args, cwd=execroot, env=env, check=True)
+    seconds = time.monotonic() - start
+    obj = args[args.index("-o") + 1]
+    return seconds, os.path.getsize(os.path.join(execroot, obj))
+
+
+def run_bench(bazel_args, workload_filter):
+    with tempfile.NamedTemporaryFile(suffix=".json") as out:
+        bench_args = ["--out=" + out.name]
+        if workload_filter:
+            bench_args.append("--filter=" + workload_filter)
+        bazel(["run"] + bazel_args + [BENCH_TARGET, "--"] + bench_args)
+        results = json.load(out)
+
+    rows = 0
+    seconds = 0
+    for workload in results["workloads"]:
+        for phase in workload["phases"]:
+            if phase["name"] == "run_segment":
+                rows += phase["count"]
+                seconds += phase["seconds"]
+    return seconds / rows if rows else None
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--filter", help="Only run workloads whose name contains this")
+    parser.add_argument("--out", help="Write results to this file")
+    parser.add_argument("bazel_args", nargs="*", help="Extra arguments to pass to bazel")
+    args = parser.parse_args()
+
+    results = []
+    for reuse in ["false", "true"]:
+        bazel_args = ["-c", "opt", FLAG + reuse] + args.bazel_args
+        compile_seconds, object_bytes = time_compile(bazel_args)
+        seconds_per_row = run_bench(bazel_args, args.filter)
+        results.append({
+            "reuse_var_slots": reuse == "true",
+            "compile_seconds": compile_seconds,
+            "object_bytes": object_bytes,
+            "ns_per_row": seconds_per_row * 1e9 if seconds_per_row else None,
+        })
+
+    text = json.dumps({"variants": results}, indent=2) + "\n"
+    if args.out:
+        with open(args.out, "w") as f:
+            f.write(text)
+    else:
+        sys.stdout.write(text)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,100 @@
+// Copyright 2024 RISC Zero, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdint.h>
+#include <unistd.h>
+
+// Benchmark workloads, selected by the first word of input; the second word
+// scales the amount of work.
+enum Workload : uint32_t {
+  MEMORY_STREAM = 0,
+  BRANCHY = 1,
+  HOST_IO = 2,
+  PAGING = 3,
+};
+
+static uint32_t streamBuf[64 * 1024];
+
+// Repeatedly copies and sums a 256KB buffer
+uint32_t memoryStream(uint32_t passes) {
+  constexpr uint32_t half = sizeof(streamBuf) / sizeof(uint32_t) / 2;
+  uint32_t tot = 0;
+  for (uint32_t pass = 0; pass < passes; pass++) {
+    for (uint32_t i = 0; i < half; i++) {
+      streamBuf[half + i] = streamBuf[i] + pass;
+      tot += streamBuf[half + i];
+    }
+  }
+  return tot;
+}
+
+// Data dependent control flow: Collatz sequence lengths
+uint32_t branchy(uint32_t count) {
+  uint32_t tot = 0;
+  for (uint32_t i = 1; i <= count; i++) {
+    uint32_t x = i;
+    while (x != 1) {
+      x = (x & 1) ? 3 * x + 1 : x / 2;
+      tot++;
+    }
+  }
+  return tot;
+}
+
+// Many small host reads and writes
+uint32_t hostIo(uint32_t count) {
+  uint32_t tot = 0;
+  uint8_t buf[64];
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t len = read(0, buf, 13);
+    for (uint32_t j = 0; j < len; j++) {
+      tot += buf[j];
+    }
+    write(1, buf, len);
+  }
+  return tot;
+}
+
+// Touches one word in each of many pages, so paging dominates
+uint32_t paging(uint32_t pages) {
+  volatile uint32_t* region = reinterpret_cast<volatile uint32_t*>(0x20000000);
+  uint32_t tot = 0;
+  for (uint32_t i = 0; i < pages; i++) {
+    region[i * 256] = i;
+    tot += region[i * 256 + 1];
+  }
+  return tot;
+}
+
+int main() {
+  uint32_t args[2] = {0, 0};
+  read(0, args, sizeof(args));
+  uint32_t tot = 0;
+  switch (args[0]) {
+  case MEMORY_STREAM:
+    tot = memoryStream(args[1]);
+    break;
+  case BRANCHY:
+    tot = branchy(args[1]);
+    break;
+  case HOST_IO:
+    tot = hostIo(args[1]);
+    break;
+  case PAGING:
+    tot = paging(args[1]);
+    break;
+  }
+  write(1, &tot, sizeof(tot));
+  return 0;
+}
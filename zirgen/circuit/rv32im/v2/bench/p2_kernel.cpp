@@ -0,0 +1,75 @@
+// Copyright 2024 RISC Zero, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdint.h>
+
+#include "zirgen/circuit/rv32im/v2/platform/constants.h"
+
+using namespace zirgen::rv32im_v2;
+
+// A machine mode benchmark which does nothing but Poseidon2 hashing.  The
+// number of hashes to perform is read from the host.
+
+inline void terminate(uint32_t val) {
+  register uintptr_t a0 asm("a0") = val;
+  register uintptr_t a7 asm("a7") = 0;
+  asm volatile("ecall\n"
+               :                  // no outputs
+               : "r"(a0), "r"(a7) // inputs
+               :                  // no clobbers
+  );
+}
+
+inline uint32_t host_read(uint32_t fd, uint32_t buf, uint32_t len) {
+  register uintptr_t a0 asm("a0") = fd;
+  register uintptr_t a1 asm("a1") = buf;
+  register uintptr_t a2 asm("a2") = len;
+  register uintptr_t a7 asm("a7") = 1;
+  asm volatile("ecall\n"
+               : "+r"(a0)                           // outputs
+               : "r"(a0), "r"(a1), "r"(a2), "r"(a7) // inputs
+               :                                    // no clobbers
+  );
+  return a0;
+}
+
+inline void do_poseidon2(uint32_t state, uint32_t bufIn, uint32_t bufOut, uint32_t countAndBits) {
+  register uintptr_t a0 asm("a0") = state;
+  register uintptr_t a1 asm("a1") = bufIn;
+  register uintptr_t a2 asm("a2") = bufOut;
+  register uintptr_t a3 asm("a3") = countAndBits;
+  register uintptr_t a7 asm("a7") = 3;
+  asm volatile("ecall\n"
+               :                                             // no outputs
+               : "r"(a0), "r"(a1), "r"(a2), "r"(a3), "r"(a7) // inputs
+               :                                             // no clobbers
+  );
+}
+
+constexpr uint32_t PFLAG_IS_ELEM = 0x80000000;
+
+extern "C" void start() {
+  uint32_t count = 0;
+  host_read(0, (uint32_t)&count, sizeof(count));
+  static uint32_t bufIn[64];
+  uint32_t bufState[8] = {0};
+  uint32_t bufOut[8];
+  for (uint32_t i = 0; i < 64; i++) {
+    bufIn[i] = i;
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    do_poseidon2((uint32_t)bufState, (uint32_t)bufIn, (uint32_t)bufOut, PFLAG_IS_ELEM | 4);
+  }
+  terminate(0);
+}
@@ -16,20 +16,36 @@
 
 #include "zirgen/circuit/rv32im/v2/emu/exec.h"
 
-#include <cstring>
+#include <algorithm>
 #include <iostream>
 
 #include "zirgen/circuit/rv32im/v2/emu/paging.h"
+#include "zirgen/circuit/rv32im/v2/emu/preflight.h"
+#include "zirgen/circuit/rv32im/v2/emu/profile.h"
 #include "zirgen/circuit/rv32im/v2/emu/r0vm.h"
 
 namespace zirgen::rv32im_v2 {
 
 namespace {
 
+// The page holding the registers, along with MEPC and the suspend state
+constexpr uint32_t REGS_PAGE = MACHINE_REGS_WORD / PAGE_SIZE_WORDS;
+static_assert(USER_REGS_WORD / PAGE_SIZE_WORDS == REGS_PAGE);
+static_assert((USER_REGS_WORD + 64) / PAGE_SIZE_WORDS == REGS_PAGE);
+
 struct ExecContext {
   HostIoHandler& upstream;
   PagedMemory& pager;
   Segment* segment;
+  // Receives the trace when recording for preflight
+  PreflightRecorder* recorder = nullptr;
+  // The register page in the pager's cache, once it has been loaded (and
+  // written) in this segment.  Registers are then accessed directly, rather
+  // than through the pager's hash tables.  Since this is the pager's own copy,
+  // nothing needs flushing at suspend or when the pager reads the page.  Not
+  // used when recording, as the recorder must see every access.
+  const uint32_t* regsLoaded = nullptr;
+  uint32_t* regsDirty = nullptr;
   size_t pc = 0;
   size_t machineMode = 0;
   size_t userCycles = 0;
@@ -38,29 +54,79 @@ struct ExecContext {
 
   ExecContext(HostIoHandler& upstream, PagedMemory& pager) : upstream(upstream), pager(pager) {}
 
-  void resume() {}
-  void suspend() {}
+  void resume() {
+    if (recorder) {
+      recorder->resume(*this);
+    }
+  }
+  void suspend() {
+    if (recorder) {
+      recorder->suspend(*this);
+    }
+  }
   void instruction(InstType type, const DecodedInst& decoded) {
     if (debug) {
       std::cout << "pc = " << pc << ", instType = " << instName(type) << "\n";
     }
+    if (recorder) {
+      recorder->instruction(type, pc, machineMode);
+    }
     userCycles++;
     physCycles++;
   }
   void ecallCycle(uint32_t cur, uint32_t next, uint32_t s0, uint32_t s1, uint32_t s2) {
+    if (recorder) {
+      recorder->ecallCycle(cur, next, pc, machineMode, s0, s1, s2);
+    }
     physCycles++;
   }
   void p2Cycle(uint32_t cur, const P2State& state) {
     if (debug) {
       std::cout << "poseidon: " << state.nextState << "\n";
     }
+    if (recorder) {
+      recorder->p2Cycle(cur, state, pc, machineMode);
+    }
     physCycles++;
   }
-  void trapRewind() {}
+  void trapRewind() {
+    if (recorder) {
+      recorder->trapRewind();
+    }
+  }
   void trap(TrapCause cause) {}
 
-  uint32_t load(uint32_t word) { return pager.load(word); }
-  void store(uint32_t word, uint32_t val) { pager.store(word, val); }
+  uint32_t load(uint32_t word) {
+    if (regsLoaded && word / PAGE_SIZE_WORDS == REGS_PAGE) {
+      return regsLoaded[word % PAGE_SIZE_WORDS];
+    }
+    uint32_t val = pager.load(word);
+    if (recorder) {
+      recorder->load(word, val);
+    } else if (word / PAGE_SIZE_WORDS == REGS_PAGE) {
+      regsLoaded = pager.getLoadedPage(REGS_PAGE).data();
+    }
+    return val;
+  }
+  void store(uint32_t word, uint32_t val) {
+    if (regsDirty && word / PAGE_SIZE_WORDS == REGS_PAGE) {
+      regsDirty[word % PAGE_SIZE_WORDS] = val;
+      return;
+    }
+    if (recorder) {
+      recorder->store(word, pager.load(word), val);
+    }
+    pager.store(word, val);
+    if (!recorder && word / PAGE_SIZE_WORDS == REGS_PAGE) {
+      regsDirty = pager.getDirtyPage(REGS_PAGE).data();
+      regsLoaded = regsDirty;
+    }
+  }
+  // Forget the register page, which the pager is about to drop
+  void clearRegs() {
+    regsLoaded = nullptr;
+    regsDirty = nullptr;
+  }
   uint32_t hostPeek(uint32_t word) { return pager.peek(word); }
 
   // For writes, just pass through, record rlen only
@@ -69,51 +135,142 @@ struct ExecContext {
     segment->writeRecord.emplace_back(rlen);
     return rlen;
   }
-  // Record what was read during execution so we can replay
-  uint32_t read(uint32_t fd, uint8_t* data, uint32_t len) {
-    size_t rlen = upstream.read(fd, data, len);
-    auto& vec = segment->readRecord.emplace_back();
-    vec.resize(rlen);
-    memcpy(vec.data(), data, rlen);
-    return rlen;
+  // Read straight into the arena, which also serves as the record of what
+  // was read so we can replay
+  IoSlice read(uint32_t fd, uint32_t len) {
+    uint8_t* data = segment->readArena->reserve(len);
+    uint32_t rlen = upstream.read(fd, data, len);
+    if (rlen > len) {
+      throw std::runtime_error("Host read returned too much data");
+    }
+    segment->readArena->commit(rlen);
+    return segment->readRecord.emplace_back(IoSlice{data, rlen});
   }
 };
 
 } // namespace
 
-std::vector<Segment> execute(
-    MemoryImage& in, HostIoHandler& io, size_t segmentThreshold, size_t maxCycles, Digest input) {
+double getPagingOverhead(const Segment& segment) {
+  size_t total = segment.suspendCycle + segment.pagingCycles;
+  return total ? double(segment.pagingCycles) / total : 0;
+}
+
+PagingAwarePolicy::PagingAwarePolicy(size_t threshold,
+                                     size_t minFillPercent,
+                                     size_t spikeCycles,
+                                     size_t window)
+    : threshold(threshold)
+    , minFillPercent(minFillPercent)
+    , spikeCycles(spikeCycles)
+    , history(std::max<size_t>(window, 1)) {}
+
+void PagingAwarePolicy::startSegment() {
+  steps = 0;
+}
+
+bool PagingAwarePolicy::shouldSplit(const SegmentCost& cost) {
+  if (cost.total() >= threshold) {
+    return true;
+  }
+  if (steps == 0) {
+    basePaging = cost.pagingCycles;
+  }
+  size_t& oldest = history[steps % history.size()];
+  size_t recent = cost.pagingCycles - oldest;
+  oldest = cost.pagingCycles;
+  steps++;
+  if (steps <= history.size()) {
+    return false;
+  }
+  // Only count the cycles this segment has spent on its own work towards the
+  // fill, since the paging present at its start is paid by any segment
+  size_t budget = threshold - std::min(threshold - 1, basePaging);
+  size_t used = cost.total() - basePaging;
+  if (used * 100 < budget * minFillPercent) {
+    return false;
+  }
+  // A burst well above the segment's average paging rate is a change of
+  // working set; a steady rate (e.g. streaming through memory) is not, and
+  // splitting would not avoid it
+  size_t total = cost.pagingCycles - basePaging;
+  return recent >= spikeCycles && recent * steps >= 4 * total * history.size();
+}
+
+std::vector<Segment> execute(MemoryImage& in,
+                             HostIoHandler& io,
+                             size_t segmentThreshold,
+                             size_t maxCycles,
+                             Digest input,
+                             bool recordPreflight,
+                             Profiler* profiler) {
+  ThresholdPolicy policy(segmentThreshold);
+  return execute(in, io, policy, maxCycles, input, recordPreflight, profiler);
+}
+
+std::vector<Segment> execute(MemoryImage& in,
+                             HostIoHandler& io,
+                             SegmentPolicy& policy,
+                             size_t maxCycles,
+                             Digest input,
+                             bool recordPreflight,
+                             Profiler* profiler) {
   std::vector<Segment> ret;
   PagedMemory pager(in);
   ExecContext execContext(io, pager);
   R0Context<ExecContext> r0Context(execContext);
   RV32Emulator<R0Context<ExecContext>> emu(r0Context);
-  ret.emplace_back();
-  ret.back().input = input;
-  execContext.segment = &ret.back();
+  size_t threshold = policy.getThreshold();
+  auto readArena = std::make_shared<IoArena>();
+  auto newSegment = [&]() {
+    ret.emplace_back();
+    ret.back().input = input;
+    ret.back().readArena = readArena;
+    if (recordPreflight) {
+      ret.back().recording = std::make_shared<PreflightRecorder>();
+      ret.back().recording->reserve(threshold, 0);
+    }
+    execContext.segment = &ret.back();
+    execContext.recorder = ret.back().recording.get();
+    execContext.physCycles = 0;
+    execContext.clearRegs();
+    policy.startSegment();
+  };
+  auto endSegment = [&](bool isTerminate) {
+    ret.back().suspendCycle = execContext.physCycles;
+    ret.back().pagingCycles = pager.getPagingCycles();
+    // A segment split early only promises to reach the size it actually has
+    ret.back().segmentThreshold =
+        isTerminate ? threshold
+                    : std::min(threshold, execContext.physCycles + pager.getPagingCycles());
+    r0Context.suspend();
+    ret.back().image = pager.commit();
+    ret.back().isTerminate = isTerminate;
+  };
+  newSegment();
   r0Context.resume();
   while (!r0Context.isDone() && execContext.userCycles < maxCycles) {
-    if (execContext.physCycles + pager.getPagingCycles() >= segmentThreshold) {
-      ret.back().suspendCycle = execContext.physCycles;
-      ret.back().pagingCycles = pager.getPagingCycles();
-      ret.back().segmentThreshold = segmentThreshold;
-      r0Context.suspend();
-      ret.back().image = pager.commit();
-      ret.back().isTerminate = false;
+    if (policy.shouldSplit({execContext.physCycles, pager.getPagingCycles()})) {
+      endSegment(false);
       pager.clear();
-      ret.emplace_back();
-      ret.back().input = input;
-      execContext.segment = &ret.back();
+      newSegment();
       r0Context.resume();
     }
-    emu.step();
+    if (profiler) {
+      uint32_t pc = execContext.pc;
+      size_t userCycles = execContext.userCycles;
+      size_t physCycles = execContext.physCycles;
+      size_t pagingCycles = pager.getPagingCycles();
+      emu.step();
+      userCycles = execContext.userCycles - userCycles;
+      profiler->step(pc,
+                     userCycles,
+                     execContext.physCycles - physCycles - userCycles,
+                     pager.getPagingCycles() - pagingCycles);
+    } else {
+      emu.step();
+    }
   }
-  ret.back().suspendCycle = execContext.physCycles;
-  ret.back().pagingCycles = pager.getPagingCycles();
-  ret.back().segmentThreshold = segmentThreshold;
-  r0Context.suspend();
-  ret.back().image = pager.commit();
-  ret.back().isTerminate = true;
+  endSegment(true);
   return ret;
 }
 
@@ -136,19 +293,51 @@ uint32_t TestIoHandler::pop_u32(uint32_t fd) {
 }
 
 uint32_t TestIoHandler::write(uint32_t fd, const uint8_t* data, uint32_t len) {
-  for (size_t i = 0; i < len; i++) {
-    output[fd].push_back(data[i]);
-  }
+  auto& out = output[fd];
+  out.insert(out.end(), data, data + len);
   return len;
 }
 
 uint32_t TestIoHandler::read(uint32_t fd, uint8_t* data, uint32_t len) {
-  size_t rlen = std::min(len, uint32_t(input[fd].size()));
-  for (size_t i = 0; i < rlen; i++) {
-    data[i] = input[fd].front();
-    input[fd].pop_front();
-  }
+  auto& in = input[fd];
+  size_t rlen = std::min(len, uint32_t(in.size()));
+  std::copy_n(in.begin(), rlen, data);
+  in.erase(in.begin(), in.begin() + rlen);
   return rlen;
 }
 
+uint32_t StreamIoHandler::write(uint32_t fd, const uint8_t* data, uint32_t len) {
+  auto it = outputs.find(fd);
+  if (it != outputs.end()) {
+    it->second->write(reinterpret_cast<const char*>(data), len);
+    if (!*it->second) {
+      throw std::runtime_error("Error writing guest output");
+    }
+  }
+  return len;
+}
+
+uint32_t StreamIoHandler::read(uint32_t fd, uint8_t* data, uint32_t len) {
+  auto it = inputs.find(fd);
+  if (it == inputs.end()) {
+    return 0;
+  }
+  it->second->read(reinterpret_cast<char*>(data), len);
+  if (it->second->bad()) {
+    throw std::runtime_error("Error reading guest input");
+  }
+  return it->second->gcount();
+}
+
+uint8_t* IoArena::reserve(size_t len) {
+  if (len > kChunkSize) {
+    throw std::runtime_error("Host read too large for IoArena");
+  }
+  if (kChunkSize - chunkUsed < len) {
+    chunks.emplace_back(new uint8_t[kChunkSize]);
+    chunkUsed = 0;
+  }
+  return chunks.back().get() + chunkUsed;
+}
+
 } // namespace zirgen::rv32im_v2
@@ -15,6 +15,8 @@
 #pragma once
 
 #include <deque>
+#include <istream>
+#include <ostream>
 
 #include "zirgen/circuit/rv32im/v2/emu/image.h"
 
@@ -37,11 +39,53 @@ struct TestIoHandler : public HostIoHandler {
   uint32_t pop_u32(uint32_t fd);
 };
 
+// Connects guest file descriptors to streams, e.g. stdin or a file, so that
+// large inputs are read as the guest consumes them rather than up front.
+// Reads from unmapped descriptors return no data, and writes to them are
+// discarded.
+struct StreamIoHandler : public HostIoHandler {
+  std::map<uint32_t, std::istream*> inputs;
+  std::map<uint32_t, std::ostream*> outputs;
+  uint32_t write(uint32_t fd, const uint8_t* data, uint32_t len) override;
+  uint32_t read(uint32_t fd, uint8_t* data, uint32_t len) override;
+};
+
+// Append-only storage for the bytes read from the host during execution.
+// Storage is allocated in chunks which never move, so pointers into it stay
+// valid as it grows.
+class IoArena {
+public:
+  // Returns space for up to `len` bytes, of which the first `used` are kept
+  // by a following commit(used)
+  uint8_t* reserve(size_t len);
+  void commit(size_t used) { chunkUsed += used; }
+
+private:
+  static constexpr size_t kChunkSize = 1 << 20;
+  std::vector<std::unique_ptr<uint8_t[]>> chunks;
+  size_t chunkUsed = kChunkSize;
+};
+
+// The bytes returned by one host read, as stored in an IoArena
+struct IoSlice {
+  const uint8_t* ptr = nullptr;
+  uint32_t len = 0;
+
+  const uint8_t* data() const { return ptr; }
+  uint32_t size() const { return len; }
+};
+
+class PreflightRecorder;
+class Profiler;
+
 struct Segment {
   // Initial sparse memory state for the segment
   MemoryImage image;
   // Recorded host->guest IO, one entry per read
-  std::vector<std::vector<uint8_t>> readRecord;
+  std::vector<IoSlice> readRecord;
+  // Holds the bytes referenced by readRecord, shared by all the segments of
+  // an execution
+  std::shared_ptr<IoArena> readArena;
   // Recorded rlen of guest->host IO, one entry per write
   std::vector<uint32_t> writeRecord;
   // The 'input' digest
@@ -54,14 +98,89 @@ struct Segment {
   size_t pagingCycles;
   // Segement threshold
   size_t segmentThreshold;
+  // The trace of the execution part of the segment, if recorded by the executor
+  std::shared_ptr<PreflightRecorder> recording;
+};
+
+// Fraction of a segment's estimated cycles spent on paging rather than
+// executing the guest
+double getPagingOverhead(const Segment& segment);
+
+// The size of the current segment so far, as seen by a SegmentPolicy
+struct SegmentCost {
+  // Cycles spent executing the guest
+  size_t physCycles;
+  // Estimated cycles for paging plus the fixed per-segment overhead
+  size_t pagingCycles;
+
+  size_t total() const { return physCycles + pagingCycles; }
+};
+
+// Decides where execute() ends segments
+struct SegmentPolicy {
+  virtual ~SegmentPolicy() = default;
+  // The most cycles a segment may use
+  virtual size_t getThreshold() = 0;
+  // Called as each segment begins
+  virtual void startSegment() {}
+  // Called before each step of the guest, returns true to end the segment
+  virtual bool shouldSplit(const SegmentCost& cost) = 0;
+};
+
+// Ends each segment once it reaches the threshold
+struct ThresholdPolicy : public SegmentPolicy {
+  ThresholdPolicy(size_t threshold) : threshold(threshold) {}
+  size_t getThreshold() override { return threshold; }
+  bool shouldSplit(const SegmentCost& cost) override { return cost.total() >= threshold; }
+
+  size_t threshold;
+};
+
+// Like ThresholdPolicy, but once a segment has used at least minFillPercent
+// of its budget, ends it early at the start of a burst of paging: at least
+// spikeCycles over the last `window` steps, and well above the segment's
+// average paging rate.  A working set change near the end of a segment is
+// then paged in once, by the next segment, rather than by both.
+struct PagingAwarePolicy : public SegmentPolicy {
+  PagingAwarePolicy(size_t threshold,
+                    size_t minFillPercent = 75,
+                    size_t spikeCycles = 1024,
+                    size_t window = 64);
+  size_t getThreshold() override { return threshold; }
+  void startSegment() override;
+  bool shouldSplit(const SegmentCost& cost) override;
+
+  size_t threshold;
+  size_t minFillPercent;
+  size_t spikeCycles;
+  // Paging cycles as of each of the last `window` steps, as a ring buffer
+  std::vector<size_t> history;
+  size_t steps = 0;
+  // Paging cycles as of the first step of the segment
+  size_t basePaging = 0;
 };
 
 // Run the executor and returns a set of segments. The memory image passed in
-// is updated in place.
+// is updated in place.  If recordPreflight is set, each segment also records
+// its execution trace, so that preflight does not need to emulate it again.
+// If a profiler is given, the cycles of each step are added to it.
 std::vector<Segment> execute(MemoryImage& in,
                              HostIoHandler& io,
                              size_t segmentThreshold,
                              size_t maxCycles,
-                             Digest input = Digest::zero());
+                             Digest input = Digest::zero(),
+                             bool recordPreflight = false,
+                             Profiler* profiler = nullptr);
+
+// Run the executor, letting `policy` choose where segments end.  Segments
+// which end before the policy's threshold report their actual size as their
+// segment threshold.
+std::vector<Segment> execute(MemoryImage& in,
+                             HostIoHandler& io,
+                             SegmentPolicy& policy,
+                             size_t maxCycles,
+                             Digest input = Digest::zero(),
+                             bool recordPreflight = false,
+                             Profiler* profiler = nullptr);
 
 } // namespace zirgen::rv32im_v2
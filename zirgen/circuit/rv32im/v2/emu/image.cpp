@@ -14,9 +14,11 @@
 
 #include "zirgen/circuit/rv32im/v2/emu/image.h"
 
+#include "risc0/core/parallel.h"
 #include "zirgen/circuit/rv32im/v2/emu/r0vm.h"
 #include "zirgen/compiler/zkp/poseidon2.h"
 
+#include <algorithm>
 #include <iostream>
 
 namespace zirgen::rv32im_v2 {
@@ -54,13 +56,44 @@ Digest hashPair(const Digest& lhs, const Digest& rhs) {
   return out;
 }
 
+PageStore& PageStore::global() {
+  static PageStore store;
+  return store;
+}
+
+PagePtr PageStore::intern(const Digest& digest, PagePtr page) {
+  std::lock_guard<std::mutex> guard(mutex);
+  auto& entry = pages[digest];
+  if (PagePtr existing = entry.lock()) {
+    if (existing == page || *existing == *page) {
+      return existing;
+    }
+    // A digest collision would be a broken hash; keep the pages distinct
+    return page;
+  }
+  entry = page;
+  if (pages.size() >= sweepSize) {
+    for (auto it = pages.begin(); it != pages.end();) {
+      it = it->second.expired() ? pages.erase(it) : std::next(it);
+    }
+    sweepSize = std::max<size_t>(1024, 2 * pages.size());
+  }
+  return page;
+}
+
+size_t PageStore::size() {
+  std::lock_guard<std::mutex> guard(mutex);
+  return std::count_if(
+      pages.begin(), pages.end(), [](const auto& kvp) { return !kvp.second.expired(); });
+}
+
 MemoryImage::MemoryImage() {
   initZeros();
 }
 
 MemoryImage MemoryImage::zeros() {
   MemoryImage ret;
-  ret.digests[1] = ret.zeroDigests[0];
+  ret.digests[1] = (*ret.zeroDigests)[0];
   return ret;
 }
 
@@ -119,10 +152,11 @@ void MemoryImage::setPage(size_t page, PagePtr data) {
   // printf("setPage(0x%08zx)\n", page);
   // If page is zero, reify it so I have proper uncles
   expandIfZero(MEMORY_SIZE_PAGES + page);
-  // Set page
-  pages[page] = data;
   // Set the diest value
-  digests[MEMORY_SIZE_PAGES + page] = hashPage(data->data());
+  Digest digest = hashPage(data->data());
+  digests[MEMORY_SIZE_PAGES + page] = digest;
+  // Set page, sharing the data with any identical page
+  pages[page] = PageStore::global().intern(digest, data);
   // Fixup digest values
   fixupDigests(MEMORY_SIZE_PAGES + page);
 }
@@ -148,6 +182,80 @@ void MemoryImage::setDigest(size_t idx, const Digest& digest) {
   fixupDigests(idx);
 }
 
+void MemoryImage::update(const std::vector<std::pair<uint32_t, PagePtr>>& newPages,
+                         const std::unordered_map<uint32_t, Digest>& newDigests) {
+  // Reify zero regions first, so that everything set below has proper uncles
+  for (const auto& kvp : newPages) {
+    expandIfZero(MEMORY_SIZE_PAGES + kvp.first);
+  }
+  for (const auto& kvp : newDigests) {
+    expandIfZero(kvp.first);
+  }
+
+  // Hash the pages whose digests we were not given
+  std::vector<Digest> pageDigests(newPages.size());
+  risc0::parallelFor(
+      0,
+      newPages.size(),
+      [&](size_t i) {
+        auto it = newDigests.find(MEMORY_SIZE_PAGES + newPages[i].first);
+        pageDigests[i] =
+            it != newDigests.end() ? it->second : hashPage(newPages[i].second->data());
+      },
+      16);
+  std::vector<uint32_t> parents;
+  PageStore& store = PageStore::global();
+  for (size_t i = 0; i < newPages.size(); i++) {
+    uint32_t idx = MEMORY_SIZE_PAGES + newPages[i].first;
+    pages[newPages[i].first] = store.intern(pageDigests[i], newPages[i].second);
+    digests[idx] = pageDigests[i];
+    parents.push_back(idx / 2);
+  }
+  for (const auto& kvp : newDigests) {
+    digests[kvp.first] = kvp.second;
+    if (kvp.first != 1) {
+      parents.push_back(kvp.first / 2);
+    }
+  }
+
+  // Recompute every node above something that changed, deepest level first.  As in
+  // fixupDigests, nodes are only recomputed when both children are known.
+  std::vector<uint32_t> level;
+  std::vector<std::pair<bool, Digest>> results;
+  while (!parents.empty()) {
+    std::sort(parents.begin(), parents.end());
+    parents.erase(std::unique(parents.begin(), parents.end()), parents.end());
+    // Take the deepest level, which holds the largest indexes
+    size_t levelStart = parents.size() - 1;
+    size_t depth = log2Floor(parents.back());
+    while (levelStart > 0 && log2Floor(parents[levelStart - 1]) == depth) {
+      levelStart--;
+    }
+    level.assign(parents.begin() + levelStart, parents.end());
+    parents.resize(levelStart);
+    results.assign(level.size(), {false, Digest()});
+    risc0::parallelFor(
+        0,
+        level.size(),
+        [&](size_t i) {
+          auto left = digests.find(2 * level[i]);
+          auto right = digests.find(2 * level[i] + 1);
+          if (left != digests.end() && right != digests.end()) {
+            results[i] = {true, hashPair(left->second, right->second)};
+          }
+        },
+        64);
+    for (size_t i = 0; i < level.size(); i++) {
+      if (results[i].first) {
+        digests[level[i]] = results[i].second;
+        if (level[i] != 1) {
+          parents.push_back(level[i] / 2);
+        }
+      }
+    }
+  }
+}
+
 std::map<uint32_t, PagePtr> MemoryImage::getKnownPages() const {
   return std::map<uint32_t, PagePtr>(pages.begin(), pages.end());
 }
@@ -157,15 +265,27 @@ std::map<uint32_t, Digest> MemoryImage::getKnownDigests() const {
 }
 
 void MemoryImage::initZeros() {
-  auto writableZeroPage = std::make_shared<Page>();
-  writableZeroPage->fill(0);
-  zeroPage = writableZeroPage;
-  Digest curDigest = hashPage(zeroPage->data());
-  zeroDigests.resize(MERKLE_TREE_DEPTH + 1);
-  for (size_t depth = MERKLE_TREE_DEPTH + 1; depth-- > 0;) {
-    zeroDigests[depth] = curDigest;
-    curDigest = hashPair(curDigest, curDigest);
-  }
+  struct ZeroTree {
+    PagePtr page;
+    std::vector<Digest> digests;
+  };
+  // Every image (including the one for each segment) used to hash its own
+  // zero tree; the result never changes, so compute it once
+  static const ZeroTree tree = [] {
+    ZeroTree tree;
+    auto writableZeroPage = std::make_shared<Page>();
+    writableZeroPage->fill(0);
+    Digest curDigest = hashPage(writableZeroPage->data());
+    tree.page = PageStore::global().intern(curDigest, writableZeroPage);
+    tree.digests.resize(MERKLE_TREE_DEPTH + 1);
+    for (size_t depth = MERKLE_TREE_DEPTH + 1; depth-- > 0;) {
+      tree.digests[depth] = curDigest;
+      curDigest = hashPair(curDigest, curDigest);
+    }
+    return tree;
+  }();
+  zeroPage = tree.page;
+  zeroDigests = &tree.digests;
 }
 
 void MemoryImage::fixupDigests(size_t idx) {
@@ -192,7 +312,7 @@ bool MemoryImage::isZero(size_t idx) {
   if (idx == 0) {
     return false;
   } // Failed to find a root at all
-  return digests.at(idx) == zeroDigests[depth];
+  return digests.at(idx) == (*zeroDigests)[depth];
 }
 
 void MemoryImage::expandZero(size_t idx) {
@@ -201,8 +321,8 @@ void MemoryImage::expandZero(size_t idx) {
   // Go up until we hit the valid zero node
   while (digests.count(idx) == 0) {
     size_t newIdx = idx / 2;
-    digests[2 * newIdx] = zeroDigests[depth];
-    digests[2 * newIdx + 1] = zeroDigests[depth];
+    digests[2 * newIdx] = (*zeroDigests)[depth];
+    digests[2 * newIdx + 1] = (*zeroDigests)[depth];
     idx = newIdx;
     depth--;
   }
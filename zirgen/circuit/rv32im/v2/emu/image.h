@@ -19,6 +19,7 @@
 #include <array>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <unordered_map>
 #include <vector>
 
@@ -45,6 +46,35 @@ constexpr size_t MERKLE_TREE_DEPTH = log2Floor(MEMORY_SIZE_PAGES);
 using Page = std::array<uint32_t, PAGE_SIZE_WORDS>;
 using PagePtr = std::shared_ptr<const Page>;
 
+// Interns page contents by digest, so that identical pages held by any number
+// of memory images (such as the images of consecutive segments) share a single
+// allocation.  Only weak references are kept, so a page is freed once the last
+// image using it goes away.
+class PageStore {
+public:
+  // Returns the store shared by every image in the process
+  static PageStore& global();
+
+  // Returns the canonical copy of a page whose digest is `digest`, which is
+  // `page` itself if no identical page is live
+  PagePtr intern(const Digest& digest, PagePtr page);
+  // Returns the number of distinct pages currently live
+  size_t size();
+
+private:
+  struct DigestHash {
+    size_t operator()(const Digest& digest) const {
+      // Digests are already uniformly distributed
+      return size_t(digest.words[0]) << 32 | digest.words[1];
+    }
+  };
+
+  std::mutex mutex;
+  std::unordered_map<Digest, std::weak_ptr<const Page>, DigestHash> pages;
+  // Expired entries are swept when the table reaches this size
+  size_t sweepSize = 1024;
+};
+
 // A class to hold 'memory images'.  A memory image may not know all page data
 // (for example partial transfer of image for proving).  Internally, the memory image
 // is an actual tree of pages, with null pointer to 'unknown' pages.
@@ -69,20 +99,27 @@ public:
   const Digest& getDigest(size_t idx) const;
   // Set a digest
   void setDigest(size_t idx, const Digest& digest);
+  // Sets many pages and digests at once.  Pages without an entry for their
+  // leaf in `newDigests` are hashed, and then the nodes above everything set
+  // are recomputed a level of the tree at a time, with the hashing for each
+  // level done in parallel.
+  void update(const std::vector<std::pair<uint32_t, PagePtr>>& newPages,
+              const std::unordered_map<uint32_t, Digest>& newDigests = {});
   // Return a map of all 'known' pages
   std::map<uint32_t, PagePtr> getKnownPages() const;
   // Return a map of all 'known' digests
   std::map<uint32_t, Digest> getKnownDigests() const;
 
 private:
+  // Shared by all images, see initZeros
   PagePtr zeroPage;
-  std::vector<Digest> zeroDigests;
+  const std::vector<Digest>* zeroDigests;
 
   // An nonexistant Page/Digest means the data is unavailable
   std::unordered_map<uint32_t, Digest> digests;
   std::unordered_map<uint32_t, PagePtr> pages;
 
-  // Initialized the zeroPage + zeroDigests
+  // Initialized the zeroPage + zeroDigests, which are computed once per process
   void initZeros();
   // Fixup digests after a change
   void fixupDigests(size_t idx);
@@ -37,9 +37,7 @@ struct P2State {
   void write(std::vector<uint32_t>& out) {
     zcheck.fill(0);
     const uint32_t* data = reinterpret_cast<const uint32_t*>(this);
-    for (size_t i = 0; i < sizeof(P2State) / 4; i++) {
-      out.push_back(data[i]);
-    }
+    out.insert(out.end(), data, data + sizeof(P2State) / 4);
   }
 
   void read(const uint32_t* in, size_t count) {
@@ -145,6 +143,58 @@ template <typename Context> void p2ECall(Context& context) {
   p2Rest(context, p2, STATE_DECODE);
 }
 
+// A context for p2Rest which captures its cycles and memory operations
+// instead of tracing them, so that the hashing can be done ahead of time (and
+// on any thread) and then replayed into the real context.  `peek` supplies
+// the contents of memory, which must not change before the replay.
+template <typename Peek> class P2Capture {
+public:
+  P2Capture(Peek peek) : peek(peek) {}
+
+  uint32_t load(uint32_t word) {
+    uint32_t val = peek(word);
+    ops.push_back({Op::LOAD, word, val});
+    return val;
+  }
+  void store(uint32_t word, uint32_t val) { ops.push_back({Op::STORE, word, val}); }
+  void p2Cycle(uint32_t curState, const P2State& state) {
+    ops.push_back({Op::CYCLE, curState, uint32_t(states.size())});
+    states.push_back(state);
+  }
+
+  // Makes the captured calls on `context`, in order
+  template <typename Context> void replay(Context& context) const {
+    for (const Op& op : ops) {
+      switch (op.kind) {
+      case Op::LOAD:
+        if (context.load(op.addrOrState) != op.val) {
+          throw std::runtime_error("Memory changed during Poseidon2 capture");
+        }
+        break;
+      case Op::STORE:
+        context.store(op.addrOrState, op.val);
+        break;
+      case Op::CYCLE:
+        context.p2Cycle(op.addrOrState, states[op.val]);
+        break;
+      }
+    }
+  }
+
+private:
+  struct Op {
+    enum Kind : uint32_t { LOAD, STORE, CYCLE } kind;
+    // The word for loads and stores, or the current state for cycles
+    uint32_t addrOrState;
+    // The value for loads and stores, or the index into states for cycles
+    uint32_t val;
+  };
+
+  Peek peek;
+  std::vector<Op> ops;
+  std::vector<P2State> states;
+};
+
 inline uint32_t nodeIdxToAddr(uint32_t idx) {
   return 0x44000000 - idx * 8;
 }
@@ -94,19 +94,36 @@ void PagedMemory::store(uint32_t word, uint32_t val) {
     pagingCycles += CYCLE_COST_PAGE;
     fixupCosts(idx, PageState::DIRTY);
     state = PageState::DIRTY;
+    writeInfo.reset();
   }
   pageCache[page][word % PAGE_SIZE_WORDS] = val;
 }
 
+const Page& PagedMemory::getLoadedPage(uint32_t page) const {
+  return pageCache.at(page);
+}
+
+Page& PagedMemory::getDirtyPage(uint32_t page) {
+  auto it = stateTable.find(MEMORY_SIZE_PAGES + page);
+  if (it == stateTable.end() || it->second != PageState::DIRTY) {
+    throw std::runtime_error("Attempting to modify a page which has not been written");
+  }
+  return pageCache.at(page);
+}
+
 size_t PagedMemory::getPagingCycles() {
   return pagingCycles;
 }
 
 MemoryImage PagedMemory::commit() {
   MemoryImage ret;
-  // Gather the original pages
+  // Gather the original pages, whose digests the image already knows
+  std::vector<std::pair<uint32_t, PagePtr>> origPages;
+  std::unordered_map<uint32_t, Digest> origDigests;
   for (auto& kvp : pageCache) {
-    ret.setPage(kvp.first, image.getPage(kvp.first));
+    origPages.emplace_back(kvp.first, image.getPage(kvp.first));
+    uint32_t idx = MEMORY_SIZE_PAGES + kvp.first;
+    origDigests[idx] = image.getDigest(idx);
   }
   std::vector<size_t> orderedIdx;
   for (auto& kvp : stateTable) {
@@ -121,20 +138,25 @@ MemoryImage PagedMemory::commit() {
     }
     // Otherwise, add whichever child digest (if any) is not loaded
     if (!stateTable.count(idx * 2)) {
-      ret.setDigest(idx * 2, image.getDigest(idx * 2));
+      origDigests[idx * 2] = image.getDigest(idx * 2);
     }
     if (!stateTable.count(idx * 2 + 1)) {
-      ret.setDigest(idx * 2 + 1, image.getDigest(idx * 2 + 1));
+      origDigests[idx * 2 + 1] = image.getDigest(idx * 2 + 1);
     }
   }
+  ret.update(origPages, origDigests);
   // Update data in image
-  for (auto& kvp : pageCache) {
-    size_t page = kvp.first;
-    uint32_t idx = MEMORY_SIZE_PAGES + page;
-    if (stateTable[idx] == PageState::DIRTY) {
-      image.setPage(page, std::make_shared<Page>(kvp.second));
+  std::vector<std::pair<uint32_t, PagePtr>> dirtyPages;
+  for (uint32_t page : writePaging().pages) {
+    // Pages written back with their original contents keep sharing the
+    // original data, and need no rehashing
+    const Page& data = pageCache.at(page);
+    if (data == *image.getPage(page)) {
+      continue;
     }
+    dirtyPages.emplace_back(page, std::make_shared<Page>(data));
   }
+  image.update(dirtyPages);
   return ret;
 }
 
@@ -142,26 +164,33 @@ void PagedMemory::clear() {
   pageCache.clear();
   stateTable.clear();
   pagingCycles = CYCLE_COST_EXTRA;
+  readInfo.reset();
+  writeInfo.reset();
 }
 
-PagingInfo PagedMemory::readPaging() {
-  PagingInfo ret;
-  ret.pages = image.getKnownPages();
-  computePaging(ret);
-  return ret;
+const PagingInfo& PagedMemory::readPaging() {
+  if (!readInfo) {
+    readInfo.emplace();
+    for (const auto& kvp : image.getKnownPages()) {
+      readInfo->pages.push_back(kvp.first);
+    }
+    computePaging(*readInfo);
+  }
+  return *readInfo;
 }
 
-PagingInfo PagedMemory::writePaging() {
-  PagingInfo ret;
-  for (const auto& kvp : pageCache) {
-    size_t page = kvp.first;
-    uint32_t idx = MEMORY_SIZE_PAGES + page;
-    if (stateTable[idx] == PageState::DIRTY) {
-      ret.pages[page] = image.getPage(page);
+const PagingInfo& PagedMemory::writePaging() {
+  if (!writeInfo) {
+    writeInfo.emplace();
+    for (const auto& kvp : pageCache) {
+      if (stateTable[MEMORY_SIZE_PAGES + kvp.first] == PageState::DIRTY) {
+        writeInfo->pages.push_back(kvp.first);
+      }
     }
+    std::sort(writeInfo->pages.begin(), writeInfo->pages.end());
+    computePaging(*writeInfo);
   }
-  computePaging(ret);
-  return ret;
+  return *writeInfo;
 }
 
 void PagedMemory::loadPage(uint32_t page) {
@@ -190,17 +219,27 @@ void PagedMemory::fixupCosts(uint32_t idx, PageState goalState) {
 }
 
 void PagedMemory::computePaging(PagingInfo& info) {
-  for (const auto& kvp : info.pages) {
-    size_t idx = MEMORY_SIZE_PAGES + kvp.first;
-    info.nodes[idx / 2];
-  }
-  for (auto it = info.nodes.rbegin(); it != info.nodes.rend(); ++it) {
-    it->second.left = image.getDigest(2 * it->first);
-    it->second.right = image.getDigest(2 * it->first + 1);
-    if (it->first != 1) {
-      info.nodes[it->first / 2];
+  // Walk up the tree a level at a time from the (sorted) pages, so each level
+  // comes out sorted too
+  std::vector<uint32_t> level;
+  for (uint32_t page : info.pages) {
+    level.push_back((MEMORY_SIZE_PAGES + page) / 2);
+  }
+  std::vector<std::vector<uint32_t>> levels;
+  while (!level.empty()) {
+    level.erase(std::unique(level.begin(), level.end()), level.end());
+    levels.push_back(level);
+    if (level[0] == 1) {
+      break;
+    }
+    for (uint32_t& idx : level) {
+      idx /= 2;
     }
   }
+  info.nodes.clear();
+  for (auto it = levels.rbegin(); it != levels.rend(); ++it) {
+    info.nodes.insert(info.nodes.end(), it->begin(), it->end());
+  }
 }
 
 } // namespace zirgen::rv32im_v2
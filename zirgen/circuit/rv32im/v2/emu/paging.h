@@ -17,6 +17,7 @@
 #include <array>
 #include <map>
 #include <memory>
+#include <optional>
 #include <unordered_map>
 #include <vector>
 
@@ -24,19 +25,14 @@
 
 namespace zirgen::rv32im_v2 {
 
-struct MerkleNode {
-  MerkleNode() = default;
-  MerkleNode(const Digest& left, const Digest& right) : left(left), right(right) {}
-  Digest left;
-  Digest right;
-};
-
 // Info required to emit paging cycles
 struct PagingInfo {
-  // List of pages (by page #) read/written
-  std::map<uint32_t, PagePtr> pages;
-  // The list (by index) of all Merkle nodes above pages
-  std::map<uint32_t, MerkleNode> nodes;
+  // List of pages (by page #) read/written, in ascending order
+  std::vector<uint32_t> pages;
+  // The list (by index) of all Merkle nodes above pages, in ascending order.
+  // Each level of the tree has larger indexes than the levels above it, so
+  // this is also level order from the root down.
+  std::vector<uint32_t> nodes;
 };
 
 class PagedMemory {
@@ -48,19 +44,28 @@ public:
   uint32_t load(uint32_t word);
   // Peek from memory, no load required
   uint32_t peek(uint32_t word);
+  // Get the current data of a page which has been loaded.  Unlike the methods
+  // above, this may be called from multiple threads at once.
+  const Page& getLoadedPage(uint32_t page) const;
   // Write to memory, and also sets dirty flag on page.
   void store(uint32_t word, uint32_t val);
+  // Get the data of a page which has been written, which may then be modified
+  // in place (without further paging costs) until the next clear().
+  Page& getDirtyPage(uint32_t page);
 
   // Get the total cost of page loads / stores in cycles
   size_t getPagingCycles();
-  // Commit to image and return 'initial' memory substate
+  // Commit to image and return 'initial' memory substate.  The pages written
+  // and the Merkle nodes above them are hashed in parallel.
   MemoryImage commit();
   // Clear paging state
   void clear();
-  // Get the info to do page reads, done before execution
-  PagingInfo readPaging();
-  // Get the info to do page writes, done after execution + commit
-  PagingInfo writePaging();
+  // Get the info to do page reads, done before execution.  Computed once
+  // until the next clear().
+  const PagingInfo& readPaging();
+  // Get the info to do page writes, done after execution.  Computed once
+  // until another page is written or the next clear().
+  const PagingInfo& writePaging();
 
 private:
   // Page state
@@ -81,6 +86,9 @@ private:
   std::unordered_map<uint32_t, PageState> stateTable;
   // Current 'costs' for all page operations
   size_t pagingCycles;
+  // Cached results of readPaging and writePaging
+  std::optional<PagingInfo> readInfo;
+  std::optional<PagingInfo> writeInfo;
 };
 
 } // namespace zirgen::rv32im_v2
@@ -18,6 +18,7 @@
 #include <iostream>
 #include <random>
 
+#include "risc0/core/parallel.h"
 #include "zirgen/circuit/rv32im/v2/emu/paging.h"
 #include "zirgen/circuit/rv32im/v2/emu/r0vm.h"
 
@@ -25,172 +26,257 @@ namespace zirgen::rv32im_v2 {
 
 namespace {
 
-struct PreflightContext {
-  PreflightTrace& trace;
-  const Segment& segment;
-  PagedMemory& pager;
-  uint32_t pc = 0;
-  uint32_t machineMode = 0;
-  size_t curWrite = 0;
-  size_t curRead = 0;
-  uint32_t memCycle = 0;
-  uint32_t userCycle = 0;
-  uint32_t extraPtr = 0;
-  uint32_t ecallPC = 0;
-  uint32_t physCycles = 0;
-  std::map<uint32_t, uint32_t> origValue;
-  std::map<uint32_t, uint32_t> prevCycle;
-  std::map<uint32_t, uint32_t> pageMemory;
-  bool debug = false;
-
-  PreflightContext(PreflightTrace& trace, const Segment& segment, PagedMemory& pager)
-      : trace(trace), segment(segment), pager(pager) {
-    for (const auto& kvp : segment.image.getKnownDigests()) {
+constexpr uint32_t kNoCycle = 0xffffffff;
+constexpr uint32_t kMerkleBase = 0x40000000;
+constexpr uint32_t kMerkleEnd = 0x44000000;
+
+// Memory argument state of a single word
+struct WordInfo {
+  // Cycle of the most recent transaction, or kNoCycle if untouched
+  uint32_t prevCycle = kNoCycle;
+  // Value before the first transaction
+  uint32_t origValue = 0;
+};
+
+// State of a word of Merkle node memory, whose contents live only here
+struct NodeWordInfo : public WordInfo {
+  uint32_t value = 0;
+  bool known = false;
+};
+
+// A dense table of per-word state for the words in [base, base + size), allocated a page at a
+// time.  Lookups go through a two level page directory, so they are O(1) and never hash.
+template <typename Entry> class WordTable {
+public:
+  WordTable(uint32_t base, uint32_t size)
+      : base(base), size(size), dir((size / PAGE_SIZE_WORDS + kDirPages - 1) / kDirPages) {}
+
+  // Returns the entry for `word`, or nullptr if its page has not been allocated
+  Entry* find(uint32_t word) {
+    uint32_t offset = word - base;
+    if (offset >= size) {
+      return nullptr;
+    }
+    uint32_t page = offset / PAGE_SIZE_WORDS;
+    const auto& chunk = dir[page / kDirPages];
+    if (!chunk) {
+      return nullptr;
+    }
+    Block* block = (*chunk)[page % kDirPages];
+    return block ? &(*block)[offset % PAGE_SIZE_WORDS] : nullptr;
+  }
+
+  // Returns the entry for `word`, allocating its page if needed
+  Entry& get(uint32_t word) {
+    if (Entry* entry = find(word)) {
+      return *entry;
+    }
+    uint32_t offset = word - base;
+    if (offset >= size) {
+      throw std::runtime_error("Word outside of memory table");
+    }
+    uint32_t page = offset / PAGE_SIZE_WORDS;
+    auto& chunk = dir[page / kDirPages];
+    if (!chunk) {
+      chunk = std::make_unique<Chunk>();
+      chunk->fill(nullptr);
+    }
+    blocks.push_back(std::make_unique<Block>());
+    (*chunk)[page % kDirPages] = blocks.back().get();
+    return (*blocks.back())[offset % PAGE_SIZE_WORDS];
+  }
+
+private:
+  static constexpr size_t kDirPages = 1024;
+  using Block = std::array<Entry, PAGE_SIZE_WORDS>;
+  using Chunk = std::array<Block*, kDirPages>;
+
+  uint32_t base;
+  uint32_t size;
+  std::vector<std::unique_ptr<Chunk>> dir;
+  std::vector<std::unique_ptr<Block>> blocks;
+};
+
+// Tracks the memory argument for all words touched by a segment.  Ordinary memory is read through
+// the pager, while the Merkle node region above kMerkleBase only holds the digests known to the
+// segment's image and is stored here directly.
+class MemoryTracker {
+public:
+  MemoryTracker(const MemoryImage& image)
+      : ram(0, kMerkleBase), nodes(kMerkleBase, kMerkleEnd - kMerkleBase) {
+    for (const auto& kvp : image.getKnownPages()) {
+      ram.get(kvp.first * PAGE_SIZE_WORDS);
+    }
+    for (const auto& kvp : image.getKnownDigests()) {
       for (size_t i = 0; i < 8; i++) {
-        pageMemory[nodeIdxToAddr(kvp.first) + i] = kvp.second.words[i];
+        NodeWordInfo& info = nodes.get(nodeIdxToAddr(kvp.first) + i);
+        info.value = kvp.second.words[i];
+        info.known = true;
       }
     }
   }
 
-  void cycleComplete(uint32_t state, uint32_t pc, uint8_t major, uint8_t minor) {
-    trace.cycles.emplace_back();
-    auto& back = trace.cycles.back();
-    back.state = state;
-    back.pc = pc;
-    back.machineMode = machineMode;
-    back.major = major;
-    back.minor = minor;
-    back.padding = 0;
-    back.memCycle = memCycle;
-    back.userCycle = userCycle;
-    back.extraPtr = extraPtr;
-    back.diffCount[0] = 0;
-    back.diffCount[1] = 0;
-
-    memCycle = trace.txns.size();
-    extraPtr = trace.extra.size();
-  }
-
-  void cycleCompleteInst(uint32_t state, uint32_t pc, InstType type) {
-    if (type == InstType::EANY) {
-      // Technically we need to switch on the machine mode *entering* the EANY
-      if (trace.cycles.back().machineMode) {
-        cycleComplete(state, pc, MajorType::ECALL0, ECallMinorType::MACHINE_ECALL);
-      } else {
-        cycleComplete(state, pc, MajorType::CONTROL0, ControlMinorType::USER_ECALL);
+  // Returns the known Merkle node word at `word`, or nullptr if unavailable
+  NodeWordInfo* findNode(uint32_t word) {
+    NodeWordInfo* info = nodes.find(word);
+    return info && info->known ? info : nullptr;
+  }
+
+  // Returns the state of `word`, which must be a valid word to transact on
+  WordInfo& get(uint32_t word) {
+    if (word >= kMerkleBase) {
+      NodeWordInfo* info = findNode(word);
+      if (!info) {
+        throw std::runtime_error("Invalid access to page memory");
       }
-    } else if (type == InstType::MRET) {
-      cycleComplete(state, pc, MajorType::CONTROL0, ControlMinorType::MRET);
-    } else {
-      cycleComplete(state, pc, getMajor(type), getMinor(type));
+      return *info;
     }
+    return ram.get(word);
   }
 
-  void cycleCompleteSpecial(uint32_t curState, uint32_t nextState, uint32_t pc) {
-    cycleComplete(nextState, pc, 7 + curState / 8, curState % 8);
+private:
+  WordTable<WordInfo> ram;
+  WordTable<NodeWordInfo> nodes;
+};
+
+// Layout of the start of a serialized preflight trace, followed by the cycles,
+// the extra data and the encoded transactions
+struct SerializedHeader {
+  uint32_t magic;
+  uint32_t cycleCount;
+  uint32_t txnCount;
+  uint32_t extraCount;
+  uint32_t txnBytes;
+  uint32_t tableSplitCycle;
+  uint32_t rng[4];
+};
+
+constexpr uint32_t kSerializedMagic = 0x31544650; // "PFT1"
+
+void putVarint(std::vector<uint8_t>& out, uint32_t val) {
+  while (val >= 0x80) {
+    out.push_back(val | 0x80);
+    val >>= 7;
   }
+  out.push_back(val);
+}
 
-  void resume() {
-    cycleCompleteSpecial(STATE_RESUME, STATE_RESUME, pc);
-    if (debug) {
-      std::cout << trace.cycles.size() << " Resume\n";
+uint32_t getVarint(const uint8_t*& ptr, const uint8_t* end) {
+  uint32_t val = 0;
+  for (size_t shift = 0; shift < 35; shift += 7) {
+    if (ptr == end) {
+      throw std::runtime_error("Truncated preflight transaction stream");
     }
-    for (size_t i = 0; i < 8; i++) {
-      store(INPUT_WORD + i, 0);
+    uint8_t byte = *ptr++;
+    val |= uint32_t(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      return val;
     }
-    cycleCompleteSpecial(STATE_RESUME, STATE_DECODE, pc);
   }
-  void suspend() {
-    pc = 0;
-    cycleCompleteSpecial(STATE_SUSPEND, STATE_SUSPEND, 0);
-    for (size_t i = 0; i < 8; i++) {
-      load(OUTPUT_WORD + i);
-    }
-    machineMode = 3;
-    cycleCompleteSpecial(STATE_SUSPEND, STATE_POSEIDON_ENTRY, 0);
+  throw std::runtime_error("Invalid preflight transaction stream");
+}
+
+uint32_t zigzag(uint32_t delta) {
+  return (delta << 1) ^ uint32_t(int32_t(delta) >> 31);
+}
+
+uint32_t unzigzag(uint32_t val) {
+  return (val >> 1) ^ -(val & 1);
+}
+
+struct PreflightContext {
+  PreflightRecorder recorder;
+  const Segment& segment;
+  PagedMemory& pager;
+  MemoryTracker memory;
+  uint32_t pc = 0;
+  uint32_t machineMode = 0;
+  size_t curWrite = 0;
+  size_t curRead = 0;
+  uint32_t physCycles = 0;
+
+  PreflightContext(const Segment& segment, PagedMemory& pager)
+      : segment(segment), pager(pager), memory(segment.image) {}
+
+  PreflightTrace& trace() { return recorder.getTrace(); }
+
+  void cycleCompleteSpecial(uint32_t curState, uint32_t nextState, uint32_t pc) {
+    recorder.cycleCompleteSpecial(curState, nextState, pc, machineMode);
   }
+
+  void resume() { recorder.resume(*this); }
+  void suspend() { recorder.suspend(*this); }
   void instruction(InstType type, const DecodedInst& decoded) {
-    if (debug) {
-      std::cout << trace.cycles.size() << " Type: " << instName(type) << "\n";
-    }
-    cycleCompleteInst(STATE_DECODE, pc, type);
-    userCycle++;
+    recorder.instruction(type, pc, machineMode);
     physCycles++;
   }
   void ecallCycle(uint32_t curState, uint32_t nextState, uint32_t s0, uint32_t s1, uint32_t s2) {
-    if (debug) {
-      std::cout << trace.cycles.size() << " ecallCycle\n";
-    }
-    trace.extra.push_back(s0);
-    trace.extra.push_back(s1);
-    trace.extra.push_back(s2);
-    cycleCompleteSpecial(curState, nextState, pc);
+    recorder.ecallCycle(curState, nextState, pc, machineMode, s0, s1, s2);
     physCycles++;
   }
   void p2Cycle(uint32_t curState, P2State p2) {
-    if (debug) {
-      std::cout << trace.cycles.size() << " p2Cycle\n";
-    }
-    p2.write(trace.extra);
-    cycleCompleteSpecial(curState, p2.nextState, pc);
+    recorder.p2Cycle(curState, p2, pc, machineMode);
     physCycles++;
   }
 
-  void trapRewind() {
-    trace.txns.resize(memCycle);
-    trace.extra.resize(extraPtr);
-  }
+  void trapRewind() { recorder.trapRewind(); }
   void trap(TrapCause cause) {
     // TODO:
     // cycleComplete(CycleType::CONTROL, ControlSubtype::TRAP, static_cast<uint32_t>(cause));
   }
 
+  // Returns the known Merkle node word at `word`
+  NodeWordInfo& node(uint32_t word) {
+    NodeWordInfo* info = memory.findNode(word);
+    if (!info) {
+      throw std::runtime_error("Invalid access to page memory");
+    }
+    return *info;
+  }
+
   // Pass memory ops to pager + record
   uint32_t load(uint32_t word) {
-    uint32_t val;
-    if (word >= 0x40000000) {
-      if (pageMemory.count(word)) {
-        val = pageMemory.at(word);
-      } else {
-        throw std::runtime_error("Invalid load from page memory");
-      }
-    } else {
-      val = pager.load(word);
-    }
-    MemoryTransaction txn;
-    if (!origValue.count(word)) {
-      origValue[word] = val;
-    }
-    txn.word = word;
-    txn.cycle = 2 * trace.cycles.size();
-    txn.val = val;
-    txn.prevCycle = (prevCycle.count(word) ? prevCycle[word] : -1);
-    txn.prevVal = val;
-    prevCycle[word] = txn.cycle;
-    trace.txns.push_back(txn);
+    uint32_t val = (word >= kMerkleBase ? node(word).value : pager.load(word));
+    recorder.load(word, val);
     return val;
   }
 
   void store(uint32_t word, uint32_t val) {
     uint32_t prevVal;
-    if (word >= 0x40000000) {
-      if (!pageMemory.count(word)) {
-        throw std::runtime_error("Invalid write to page memory");
-      }
-      prevVal = pageMemory[word];
-      pageMemory[word] = val;
+    if (word >= kMerkleBase) {
+      NodeWordInfo& info = node(word);
+      prevVal = info.value;
+      info.value = val;
     } else {
       prevVal = pager.load(word);
       pager.store(word, val);
     }
-    MemoryTransaction txn;
-    txn.word = word;
-    txn.cycle = 2 * trace.cycles.size() + 1;
-    txn.val = val;
-    txn.prevCycle = (prevCycle.count(word) ? prevCycle[word] : -1);
-    txn.prevVal = prevVal;
-    prevCycle[word] = txn.cycle;
-    trace.txns.push_back(txn);
+    recorder.store(word, prevVal, val);
+  }
+
+  // Appends the execution part of the segment as recorded by the executor, applying its memory
+  // operations so the pager ends up as if the segment had been emulated here.
+  void replay(const PreflightRecorder& recording) {
+    for (const auto& txn : recording.getTrace().txns) {
+      bool isStore = txn.cycle % 2;
+      uint32_t prevVal;
+      if (txn.word >= kMerkleBase) {
+        NodeWordInfo& info = node(txn.word);
+        prevVal = info.value;
+        info.value = txn.val;
+      } else {
+        prevVal = pager.load(txn.word);
+        if (isStore) {
+          pager.store(txn.word, txn.val);
+        }
+      }
+      if (prevVal != txn.prevVal) {
+        throw std::runtime_error("Recorded execution does not match segment");
+      }
+    }
+    recorder.append(recording);
+    pc = 0;
+    machineMode = 3;
   }
 
   // Since hostWrites are ignored, we can return trash
@@ -203,17 +289,16 @@ struct PreflightContext {
     }
     return segment.writeRecord[curWrite++];
   }
-  // Replay data
-  uint32_t read(uint32_t fd, uint8_t* data, uint32_t len) {
+  // Replay data, directly from the record
+  IoSlice read(uint32_t fd, uint32_t len) {
     if (curRead >= segment.readRecord.size()) {
       throw std::runtime_error("Invalid segment");
     }
-    if (segment.readRecord[curRead].size() > len) {
+    const IoSlice& slice = segment.readRecord[curRead++];
+    if (slice.size() > len) {
       throw std::runtime_error("Invalid segment");
     }
-    size_t rlen = segment.readRecord[curRead].size();
-    memcpy(data, segment.readRecord[curRead].data(), rlen);
-    return rlen;
+    return slice;
   }
 
   uint32_t getDigestAddr(uint32_t idx) { return (1 << 30) + 8 * (2 * MEMORY_SIZE_PAGES - idx); }
@@ -225,13 +310,36 @@ struct PreflightContext {
     }
     cycleCompleteSpecial(STATE_LOAD_ROOT, STATE_POSEIDON_ENTRY, 0);
   }
-  void readNode(size_t idx) { p2DoNode(*this, idx, true); }
-  void readPage(size_t page) { p2DoPage(*this, page, true); }
   void readDone() { p2ReadDone(*this); }
-
-  void writeNode(size_t idx) { p2DoNode(*this, idx, false); }
-  void writePage(size_t page) { p2DoPage(*this, page, false); }
   void writeDone() { p2WriteDone(*this); }
+
+  // Does the Poseidon2 paging operation `op(context, item)` for each item, in order.  The
+  // hashing for a batch of items runs in parallel against the current memory, and is then
+  // replayed into this context, so an operation must not depend on the stores of another in
+  // the same call.  Any pages read must already be loaded.
+  template <typename Op> void pagingBatch(const std::vector<uint32_t>& items, Op op) {
+    auto peek = [this](uint32_t word) {
+      if (word >= kMerkleBase) {
+        NodeWordInfo* info = memory.findNode(word);
+        if (!info) {
+          throw std::runtime_error("Invalid access to page memory");
+        }
+        return info->value;
+      }
+      return pager.getLoadedPage(word / PAGE_SIZE_WORDS)[word % PAGE_SIZE_WORDS];
+    };
+    using Capture = P2Capture<decltype(peek)>;
+    // Bound the memory used by captures, each of which holds every state of its hashing
+    size_t batchSize = risc0::getParallelism() * 4;
+    for (size_t start = 0; start < items.size(); start += batchSize) {
+      size_t count = std::min(batchSize, items.size() - start);
+      std::vector<Capture> captures(count, Capture(peek));
+      risc0::parallelFor(0, count, [&](size_t i) { op(captures[i], items[start + i]); });
+      for (const auto& capture : captures) {
+        capture.replay(*this);
+      }
+    }
+  }
   void writeRoot() {
     size_t rootAddr = getDigestAddr(1);
     for (size_t i = 0; i < 8; i++) {
@@ -251,15 +359,15 @@ struct PreflightContext {
     machineMode = 0;
     cycleCompleteSpecial(STATE_CONTROL_TABLE, STATE_CONTROL_DONE, 0);
     if (!segment.isTerminate) {
-      if (trace.cycles.size() < segment.segmentThreshold) {
+      if (trace().cycles.size() < segment.segmentThreshold) {
         throw std::runtime_error("Stopping segment too early");
       }
-      size_t diff = trace.cycles.size() - segment.segmentThreshold;
-      trace.cycles[diff / 2].diffCount[diff % 2]++;
+      size_t diff = trace().cycles.size() - segment.segmentThreshold;
+      trace().cycles[diff / 2].diffCount[diff % 2]++;
     }
     machineMode = 1;
     cycleCompleteSpecial(STATE_CONTROL_DONE, STATE_CONTROL_DONE, 0);
-    while (trace.cycles.size() < segmentSize) {
+    while (trace().cycles.size() < segmentSize) {
       cycleCompleteSpecial(STATE_CONTROL_DONE, STATE_CONTROL_DONE, 0);
     }
   }
@@ -267,46 +375,290 @@ struct PreflightContext {
 
 } // namespace
 
+void PreflightRecorder::reserve(size_t cycles, size_t txns) {
+  trace.cycles.reserve(cycles);
+  trace.txns.reserve(txns);
+}
+
+void PreflightRecorder::cycleComplete(
+    uint32_t state, uint32_t pc, uint32_t machineMode, uint8_t major, uint8_t minor) {
+  trace.cycles.emplace_back();
+  auto& back = trace.cycles.back();
+  back.state = state;
+  back.pc = pc;
+  back.machineMode = machineMode;
+  back.major = major;
+  back.minor = minor;
+  back.padding = 0;
+  back.memCycle = memCycle;
+  back.userCycle = userCycle;
+  back.extraPtr = extraPtr;
+  back.diffCount[0] = 0;
+  back.diffCount[1] = 0;
+
+  memCycle = trace.txns.size();
+  extraPtr = trace.extra.size();
+}
+
+void PreflightRecorder::cycleCompleteSpecial(uint32_t curState,
+                                             uint32_t nextState,
+                                             uint32_t pc,
+                                             uint32_t machineMode) {
+  cycleComplete(nextState, pc, machineMode, 7 + curState / 8, curState % 8);
+}
+
+void PreflightRecorder::instruction(InstType type, uint32_t pc, uint32_t machineMode) {
+  if (type == InstType::EANY) {
+    // Technically we need to switch on the machine mode *entering* the EANY
+    if (trace.cycles.back().machineMode) {
+      cycleComplete(
+          STATE_DECODE, pc, machineMode, MajorType::ECALL0, ECallMinorType::MACHINE_ECALL);
+    } else {
+      cycleComplete(
+          STATE_DECODE, pc, machineMode, MajorType::CONTROL0, ControlMinorType::USER_ECALL);
+    }
+  } else if (type == InstType::MRET) {
+    cycleComplete(STATE_DECODE, pc, machineMode, MajorType::CONTROL0, ControlMinorType::MRET);
+  } else {
+    cycleComplete(STATE_DECODE, pc, machineMode, getMajor(type), getMinor(type));
+  }
+  userCycle++;
+}
+
+void PreflightRecorder::ecallCycle(uint32_t curState,
+                                   uint32_t nextState,
+                                   uint32_t pc,
+                                   uint32_t machineMode,
+                                   uint32_t s0,
+                                   uint32_t s1,
+                                   uint32_t s2) {
+  trace.extra.push_back(s0);
+  trace.extra.push_back(s1);
+  trace.extra.push_back(s2);
+  cycleCompleteSpecial(curState, nextState, pc, machineMode);
+}
+
+void PreflightRecorder::p2Cycle(uint32_t curState,
+                                const P2State& p2,
+                                uint32_t pc,
+                                uint32_t machineMode) {
+  P2State copy = p2;
+  copy.write(trace.extra);
+  cycleCompleteSpecial(curState, p2.nextState, pc, machineMode);
+}
+
+void PreflightRecorder::trapRewind() {
+  trace.txns.resize(memCycle);
+  trace.extra.resize(extraPtr);
+}
+
+void PreflightRecorder::load(uint32_t word, uint32_t val) {
+  MemoryTransaction txn;
+  txn.word = word;
+  txn.cycle = 2 * trace.cycles.size();
+  txn.val = val;
+  txn.prevCycle = kNoCycle;
+  txn.prevVal = val;
+  trace.txns.push_back(txn);
+}
+
+void PreflightRecorder::store(uint32_t word, uint32_t prevVal, uint32_t val) {
+  MemoryTransaction txn;
+  txn.word = word;
+  txn.cycle = 2 * trace.cycles.size() + 1;
+  txn.val = val;
+  txn.prevCycle = kNoCycle;
+  txn.prevVal = prevVal;
+  trace.txns.push_back(txn);
+}
+
+void PreflightRecorder::append(const PreflightRecorder& other) {
+  uint32_t cycleBase = trace.cycles.size();
+  uint32_t txnBase = trace.txns.size();
+  uint32_t extraBase = trace.extra.size();
+  trace.cycles.reserve(cycleBase + other.trace.cycles.size());
+  trace.txns.reserve(txnBase + other.trace.txns.size());
+  for (PreflightCycle cycle : other.trace.cycles) {
+    cycle.memCycle += txnBase;
+    cycle.userCycle += userCycle;
+    cycle.extraPtr += extraBase;
+    trace.cycles.push_back(cycle);
+  }
+  for (MemoryTransaction txn : other.trace.txns) {
+    txn.cycle += 2 * cycleBase;
+    trace.txns.push_back(txn);
+  }
+  trace.extra.insert(trace.extra.end(), other.trace.extra.begin(), other.trace.extra.end());
+  memCycle = trace.txns.size();
+  userCycle += other.userCycle;
+  extraPtr = trace.extra.size();
+}
+
+std::vector<uint8_t> serializePreflight(const PreflightTrace& trace) {
+  // Each transaction is encoded as the change in cycle (with a flag for a
+  // separate previous value), the change in word, the distance back to the
+  // previous cycle, the value and then the previous value if flagged.
+  std::vector<uint8_t> txnStream;
+  txnStream.reserve(trace.txns.size() * 8);
+  uint32_t lastCycle = 0;
+  uint32_t lastWord = 0;
+  for (const auto& txn : trace.txns) {
+    bool hasPrevVal = txn.prevVal != txn.val;
+    putVarint(txnStream, (zigzag(txn.cycle - lastCycle) << 1) | hasPrevVal);
+    putVarint(txnStream, zigzag(txn.word - lastWord));
+    putVarint(txnStream, zigzag(txn.cycle - txn.prevCycle));
+    putVarint(txnStream, txn.val);
+    if (hasPrevVal) {
+      putVarint(txnStream, txn.prevVal);
+    }
+    lastCycle = txn.cycle;
+    lastWord = txn.word;
+  }
+  // Keep the following sections word aligned
+  txnStream.resize((txnStream.size() + 3) & ~size_t(3));
+
+  SerializedHeader header;
+  header.magic = kSerializedMagic;
+  header.cycleCount = trace.cycles.size();
+  header.txnCount = trace.txns.size();
+  header.extraCount = trace.extra.size();
+  header.txnBytes = txnStream.size();
+  header.tableSplitCycle = trace.tableSplitCycle;
+  for (size_t i = 0; i < 4; i++) {
+    header.rng[i] = trace.rng.elems[i].asUInt32();
+  }
+
+  size_t cycleBytes = trace.cycles.size() * sizeof(PreflightCycle);
+  size_t extraBytes = trace.extra.size() * sizeof(uint32_t);
+  std::vector<uint8_t> out(sizeof(header) + cycleBytes + extraBytes + txnStream.size());
+  uint8_t* ptr = out.data();
+  memcpy(ptr, &header, sizeof(header));
+  ptr += sizeof(header);
+  memcpy(ptr, trace.cycles.data(), cycleBytes);
+  ptr += cycleBytes;
+  memcpy(ptr, trace.extra.data(), extraBytes);
+  ptr += extraBytes;
+  memcpy(ptr, txnStream.data(), txnStream.size());
+  return out;
+}
+
+PreflightTraceView::PreflightTraceView(const uint8_t* data, size_t size) {
+  if (reinterpret_cast<uintptr_t>(data) % alignof(PreflightCycle) != 0) {
+    throw std::runtime_error("Misaligned preflight trace");
+  }
+  SerializedHeader header;
+  if (size < sizeof(header)) {
+    throw std::runtime_error("Truncated preflight trace");
+  }
+  memcpy(&header, data, sizeof(header));
+  if (header.magic != kSerializedMagic) {
+    throw std::runtime_error("Invalid preflight trace");
+  }
+  size_t cycleBytes = size_t(header.cycleCount) * sizeof(PreflightCycle);
+  size_t extraBytes = size_t(header.extraCount) * sizeof(uint32_t);
+  if (size != sizeof(header) + cycleBytes + extraBytes + header.txnBytes) {
+    throw std::runtime_error("Truncated preflight trace");
+  }
+  const uint8_t* ptr = data + sizeof(header);
+  cycles = llvm::ArrayRef(reinterpret_cast<const PreflightCycle*>(ptr), header.cycleCount);
+  ptr += cycleBytes;
+  extra = llvm::ArrayRef(reinterpret_cast<const uint32_t*>(ptr), header.extraCount);
+  ptr += extraBytes;
+  txnStream = llvm::ArrayRef(ptr, header.txnBytes);
+  txnCount = header.txnCount;
+  tableSplitCycle = header.tableSplitCycle;
+  rng = risc0::FpExt(header.rng[0], header.rng[1], header.rng[2], header.rng[3]);
+}
+
+std::vector<MemoryTransaction> PreflightTraceView::decodeTxns() const {
+  std::vector<MemoryTransaction> txns(txnCount);
+  const uint8_t* ptr = txnStream.begin();
+  const uint8_t* end = txnStream.end();
+  uint32_t lastCycle = 0;
+  uint32_t lastWord = 0;
+  for (auto& txn : txns) {
+    uint32_t cycleCode = getVarint(ptr, end);
+    txn.cycle = lastCycle + unzigzag(cycleCode >> 1);
+    txn.word = lastWord + unzigzag(getVarint(ptr, end));
+    txn.prevCycle = txn.cycle - unzigzag(getVarint(ptr, end));
+    txn.val = getVarint(ptr, end);
+    txn.prevVal = (cycleCode & 1) ? getVarint(ptr, end) : txn.val;
+    lastCycle = txn.cycle;
+    lastWord = txn.word;
+  }
+  return txns;
+}
+
+PreflightTrace PreflightTraceView::toTrace() const {
+  PreflightTrace trace;
+  trace.cycles.assign(cycles.begin(), cycles.end());
+  trace.txns = decodeTxns();
+  trace.extra.assign(extra.begin(), extra.end());
+  trace.tableSplitCycle = tableSplitCycle;
+  trace.rng = rng;
+  return trace;
+}
+
 PreflightTrace preflightSegment(const Segment& in, size_t segmentSize) {
-  PreflightTrace ret;
   MemoryImage image(in.image);
   PagedMemory pager(image);
-  PreflightContext preflightContext(ret, in, pager);
-  R0Context<PreflightContext> r0Context(preflightContext);
-  RV32Emulator<R0Context<PreflightContext>> emu(r0Context);
+  PreflightContext preflightContext(in, pager);
+  PreflightTrace& ret = preflightContext.trace();
+  preflightContext.recorder.reserve(segmentSize, 0);
 
   // Do page in
   preflightContext.readRoot();
-  auto pages = pager.readPaging();
-  p2PagingEntry(preflightContext, 0);
-  for (const auto& kvp : pages.nodes) {
-    preflightContext.readNode(kvp.first);
+  const PagingInfo& pageIn = pager.readPaging();
+  for (uint32_t page : pageIn.pages) {
+    pager.load(page * PAGE_SIZE_WORDS);
   }
+  p2PagingEntry(preflightContext, 0);
+  preflightContext.pagingBatch(pageIn.nodes,
+                               [](auto& context, uint32_t idx) { p2DoNode(context, idx, true); });
   preflightContext.machineMode = 1;
-  for (const auto& kvp : pages.pages) {
-    preflightContext.readPage(kvp.first);
-  }
+  preflightContext.pagingBatch(pageIn.pages,
+                               [](auto& context, uint32_t page) { p2DoPage(context, page, true); });
   preflightContext.machineMode = 2;
   preflightContext.readDone();
   preflightContext.physCycles = 0;
 
-  // Run main execution
-  r0Context.resume();
-  while (preflightContext.physCycles < in.suspendCycle) {
-    emu.step();
+  // Run main execution, unless the executor already recorded it
+  if (in.recording) {
+    preflightContext.replay(*in.recording);
+  } else {
+    R0Context<PreflightContext> r0Context(preflightContext);
+    RV32Emulator<R0Context<PreflightContext>> emu(r0Context);
+    r0Context.resume();
+    while (preflightContext.physCycles < in.suspendCycle) {
+      emu.step();
+    }
+    r0Context.suspend();
   }
-  r0Context.suspend();
 
-  // Do page out
-  pages = pager.writePaging();
-  pager.commit();
+  // Do page out.  The image itself is not needed past this point, so unlike the executor there
+  // is no commit.
+  const PagingInfo& pageOut = pager.writePaging();
+  // Each page costs a load and a store per word plus the digest, and each node
+  // two child digests and its own.
+  preflightContext.recorder.reserve(segmentSize,
+                                    ret.txns.size() +
+                                        pageOut.pages.size() * (2 * PAGE_SIZE_WORDS + 16) +
+                                        pageOut.nodes.size() * 32 + 64);
   p2PagingEntry(preflightContext, 3);
-  for (auto it = pages.pages.rbegin(); it != pages.pages.rend(); ++it) {
-    preflightContext.writePage(it->first);
-  }
+  std::vector<uint32_t> items(pageOut.pages.rbegin(), pageOut.pages.rend());
+  preflightContext.pagingBatch(
+      items, [](auto& context, uint32_t page) { p2DoPage(context, page, false); });
   preflightContext.machineMode = 4;
-  for (auto it = pages.nodes.rbegin(); it != pages.nodes.rend(); ++it) {
-    preflightContext.writeNode(it->first);
+  // Nodes go bottom up, one level at a time, since each reads the digests stored by the level
+  // below it
+  for (auto it = pageOut.nodes.rbegin(); it != pageOut.nodes.rend();) {
+    size_t depth = log2Floor(*it);
+    items.clear();
+    for (; it != pageOut.nodes.rend() && log2Floor(*it) == depth; ++it) {
+      items.push_back(*it);
+    }
+    preflightContext.pagingBatch(
+        items, [](auto& context, uint32_t idx) { p2DoNode(context, idx, false); });
   }
   preflightContext.machineMode = 5;
   preflightContext.writeDone();
@@ -317,11 +669,23 @@ PreflightTrace preflightSegment(const Segment& in, size_t segmentSize) {
   ret.tableSplitCycle = ret.cycles.size();
   preflightContext.doTables(segmentSize);
 
+  // Link each memory transaction to the previous one on the same word
+  for (auto& txn : ret.txns) {
+    WordInfo& info = preflightContext.memory.get(txn.word);
+    bool isLoad = txn.cycle % 2 == 0;
+    if (isLoad && info.prevCycle == kNoCycle) {
+      info.origValue = txn.val;
+    }
+    txn.prevCycle = info.prevCycle;
+    info.prevCycle = txn.cycle;
+  }
+
   // Now, go back and update memory transactions to wrap around
   for (auto& txn : ret.txns) {
-    if (txn.prevCycle == -1) {
+    const WordInfo& info = preflightContext.memory.get(txn.word);
+    if (txn.prevCycle == kNoCycle) {
       // If first cycle for word, set to 'prevCycle' to final cycle
-      txn.prevCycle = preflightContext.prevCycle[txn.word];
+      txn.prevCycle = info.prevCycle;
     } else {
       // Otherwise, compute cycle diff and another diff
       uint32_t diff = txn.cycle - txn.prevCycle;
@@ -329,8 +693,8 @@ PreflightTrace preflightSegment(const Segment& in, size_t segmentSize) {
     }
 
     // If last cycle, set final value to original value
-    if (txn.cycle == preflightContext.prevCycle[txn.word]) {
-      txn.val = preflightContext.origValue[txn.word];
+    if (txn.cycle == info.prevCycle) {
+      txn.val = info.origValue;
     }
   }
 
@@ -395,7 +759,7 @@ PreflightTrace preflightSegment(const Segment& in, size_t segmentSize) {
 
   std::cout << "Memory ops = " << ret.txns.size() << "\n";
   std::cout << "Trace size = " << ret.cycles.size() << "\n";
-  return ret;
+  return std::move(ret);
 }
 
 } // namespace zirgen::rv32im_v2
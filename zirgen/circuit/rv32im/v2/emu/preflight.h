@@ -14,10 +14,13 @@
 
 #pragma once
 
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/Support/Casting.h"
 
 #include "risc0/fp/fpext.h"
+#include "zirgen/circuit/rv32im/shared/rv32im.h"
 #include "zirgen/circuit/rv32im/v2/emu/exec.h"
+#include "zirgen/circuit/rv32im/v2/platform/constants.h"
 
 namespace zirgen::rv32im_v2 {
 
@@ -57,6 +60,107 @@ struct PreflightTrace {
   risc0::FpExt rng;
 };
 
+struct P2State;
+
+// Records the cycles, memory transactions and extra data of a segment's trace as they are
+// produced.  Transactions are not linked to the previous access of their word until the whole
+// trace is known, which lets the executor record the execution part of a segment (from resume
+// through suspend) as it runs, and preflight later place it after the page-in cycles.
+class PreflightRecorder {
+public:
+  // Preallocates space for the given number of cycles and memory transactions
+  void reserve(size_t cycles, size_t txns);
+
+  void cycleComplete(
+      uint32_t state, uint32_t pc, uint32_t machineMode, uint8_t major, uint8_t minor);
+  void
+  cycleCompleteSpecial(uint32_t curState, uint32_t nextState, uint32_t pc, uint32_t machineMode);
+
+  void instruction(InstType type, uint32_t pc, uint32_t machineMode);
+  void ecallCycle(uint32_t curState,
+                  uint32_t nextState,
+                  uint32_t pc,
+                  uint32_t machineMode,
+                  uint32_t s0,
+                  uint32_t s1,
+                  uint32_t s2);
+  void p2Cycle(uint32_t curState, const P2State& p2, uint32_t pc, uint32_t machineMode);
+  void trapRewind();
+
+  void load(uint32_t word, uint32_t val);
+  void store(uint32_t word, uint32_t prevVal, uint32_t val);
+
+  // Emits the resume cycles, clearing the input digest through `context`
+  template <typename Context> void resume(Context& context) {
+    cycleCompleteSpecial(STATE_RESUME, STATE_RESUME, context.pc, context.machineMode);
+    for (size_t i = 0; i < 8; i++) {
+      context.store(INPUT_WORD + i, 0);
+    }
+    cycleCompleteSpecial(STATE_RESUME, STATE_DECODE, context.pc, context.machineMode);
+  }
+
+  // Emits the suspend cycles, reading the output digest through `context`
+  template <typename Context> void suspend(Context& context) {
+    context.pc = 0;
+    cycleCompleteSpecial(STATE_SUSPEND, STATE_SUSPEND, 0, context.machineMode);
+    for (size_t i = 0; i < 8; i++) {
+      context.load(OUTPUT_WORD + i);
+    }
+    context.machineMode = 3;
+    cycleCompleteSpecial(STATE_SUSPEND, STATE_POSEIDON_ENTRY, 0, context.machineMode);
+  }
+
+  // Appends another recording, renumbering its cycles and transactions to follow this one
+  void append(const PreflightRecorder& other);
+
+  PreflightTrace& getTrace() { return trace; }
+  const PreflightTrace& getTrace() const { return trace; }
+
+private:
+  PreflightTrace trace;
+  // Index of the first transaction of the current cycle
+  uint32_t memCycle = 0;
+  // Number of user instructions executed so far
+  uint32_t userCycle = 0;
+  // Index of the first extra word of the current cycle
+  uint32_t extraPtr = 0;
+};
+
+// Serializes a preflight trace into a single buffer.  Cycles and extra data are
+// stored as is so that PreflightTraceView can use them in place, while memory
+// transactions are delta encoded, taking a third or less of their in-memory
+// size.  Multi-byte values use the host byte order.
+std::vector<uint8_t> serializePreflight(const PreflightTrace& trace);
+
+// A read only view of a serialized preflight trace.  The cycles and extra data
+// refer directly into the buffer, which must be 4 byte aligned and outlive the
+// view; memory transactions are decoded on request.
+class PreflightTraceView {
+public:
+  PreflightTraceView(const uint8_t* data, size_t size);
+
+  llvm::ArrayRef<PreflightCycle> getCycles() const { return cycles; }
+  llvm::ArrayRef<uint32_t> getExtra() const { return extra; }
+  uint32_t getTableSplitCycle() const { return tableSplitCycle; }
+  const risc0::FpExt& getRng() const { return rng; }
+  size_t getTxnCount() const { return txnCount; }
+
+  // Decodes the memory transaction stream
+  std::vector<MemoryTransaction> decodeTxns() const;
+  // Copies the whole trace out of the buffer
+  PreflightTrace toTrace() const;
+
+private:
+  llvm::ArrayRef<PreflightCycle> cycles;
+  llvm::ArrayRef<uint32_t> extra;
+  llvm::ArrayRef<uint8_t> txnStream;
+  size_t txnCount;
+  uint32_t tableSplitCycle;
+  risc0::FpExt rng;
+};
+
+// Runs preflight on a segment.  If the segment carries a recording from execute(), the
+// execution part of the trace is taken from it rather than emulating the segment again.
 PreflightTrace preflightSegment(const Segment& in, size_t segmentSize);
 
 } // namespace zirgen::rv32im_v2
@@ -0,0 +1,207 @@
+// Copyright 2024 RISC Zero, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "zirgen/circuit/rv32im/v2/emu/profile.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+#include "risc0/core/util.h"
+
+namespace zirgen::rv32im_v2 {
+
+namespace {
+
+// Just enough of the protobuf wire format to write a profile.proto message
+class ProtoWriter {
+public:
+  void varint(uint32_t field, uint64_t val) {
+    tag(field, 0);
+    raw(val);
+  }
+  void bytes(uint32_t field, const std::string& str) {
+    tag(field, 2);
+    raw(str.size());
+    buf.append(str);
+  }
+  void message(uint32_t field, const ProtoWriter& msg) { bytes(field, msg.buf); }
+  void packed(uint32_t field, const std::vector<uint64_t>& vals) {
+    ProtoWriter inner;
+    for (uint64_t val : vals) {
+      inner.raw(val);
+    }
+    bytes(field, inner.buf);
+  }
+
+  const std::string& str() const { return buf; }
+
+private:
+  void tag(uint32_t field, uint32_t wireType) { raw(field << 3 | wireType); }
+  void raw(uint64_t val) {
+    while (val >= 0x80) {
+      buf.push_back(char(val | 0x80));
+      val >>= 7;
+    }
+    buf.push_back(char(val));
+  }
+
+  std::string buf;
+};
+
+// Field numbers from pprof's profile.proto
+namespace pb {
+constexpr uint32_t kProfileSampleType = 1;
+constexpr uint32_t kProfileSample = 2;
+constexpr uint32_t kProfileMapping = 3;
+constexpr uint32_t kProfileLocation = 4;
+constexpr uint32_t kProfileFunction = 5;
+constexpr uint32_t kProfileStringTable = 6;
+constexpr uint32_t kProfileDefaultSampleType = 14;
+constexpr uint32_t kValueTypeType = 1;
+constexpr uint32_t kValueTypeUnit = 2;
+constexpr uint32_t kSampleLocationId = 1;
+constexpr uint32_t kSampleValue = 2;
+constexpr uint32_t kMappingId = 1;
+constexpr uint32_t kMappingMemoryStart = 2;
+constexpr uint32_t kMappingMemoryLimit = 3;
+constexpr uint32_t kMappingHasFunctions = 7;
+constexpr uint32_t kLocationId = 1;
+constexpr uint32_t kLocationMappingId = 2;
+constexpr uint32_t kLocationAddress = 3;
+constexpr uint32_t kLocationLine = 4;
+constexpr uint32_t kLineFunctionId = 1;
+constexpr uint32_t kFunctionId = 1;
+constexpr uint32_t kFunctionName = 2;
+constexpr uint32_t kFunctionSystemName = 3;
+} // namespace pb
+
+class StringTable {
+public:
+  StringTable() { get(""); }
+
+  uint64_t get(const std::string& str) {
+    auto [it, inserted] = ids.emplace(str, strings.size());
+    if (inserted) {
+      strings.push_back(str);
+    }
+    return it->second;
+  }
+
+  void write(ProtoWriter& out) const {
+    for (const auto& str : strings) {
+      out.bytes(pb::kProfileStringTable, str);
+    }
+  }
+
+private:
+  std::unordered_map<std::string, uint64_t> ids;
+  std::vector<std::string> strings;
+};
+
+} // namespace
+
+void Profiler::addSymbols(const std::vector<uint8_t>& elfBytes) {
+  auto newSymbols = risc0::loadElfSymbols(elfBytes);
+  size_t oldSize = symbols.size();
+  symbols.insert(symbols.end(), newSymbols.begin(), newSymbols.end());
+  std::inplace_merge(symbols.begin(),
+                     symbols.begin() + oldSize,
+                     symbols.end(),
+                     [](const risc0::ElfSymbol& lhs, const risc0::ElfSymbol& rhs) {
+                       return lhs.addr < rhs.addr;
+                     });
+}
+
+void Profiler::addSymbols(const std::string& elfPath) {
+  addSymbols(risc0::loadFile(elfPath));
+}
+
+const risc0::ElfSymbol* Profiler::findSymbol(uint32_t pc) const {
+  return risc0::findElfSymbol(symbols, pc);
+}
+
+std::vector<std::pair<uint32_t, Profiler::Counts>> Profiler::getCounts() const {
+  std::vector<std::pair<uint32_t, Counts>> out;
+  for (const auto& [blockIdx, block] : blocks) {
+    for (size_t i = 0; i < kBlockWords; i++) {
+      const Counts& counts = (*block)[i];
+      if (counts.userCycles || counts.ecallCycles || counts.pagingCycles) {
+        out.emplace_back((blockIdx * kBlockWords + i) * 4, counts);
+      }
+    }
+  }
+  return out;
+}
+
+void Profiler::writePprof(std::ostream& os) const {
+  ProtoWriter profile;
+  StringTable strings;
+
+  for (const char* type : {"user_cycles", "ecall_cycles", "paging_cycles"}) {
+    ProtoWriter valueType;
+    valueType.varint(pb::kValueTypeType, strings.get(type));
+    valueType.varint(pb::kValueTypeUnit, strings.get("cycles"));
+    profile.message(pb::kProfileSampleType, valueType);
+  }
+
+  // A single mapping covering the whole guest address space
+  ProtoWriter mapping;
+  mapping.varint(pb::kMappingId, 1);
+  mapping.varint(pb::kMappingMemoryStart, 0);
+  mapping.varint(pb::kMappingMemoryLimit, uint64_t(1) << 32);
+  mapping.varint(pb::kMappingHasFunctions, 1);
+  profile.message(pb::kProfileMapping, mapping);
+
+  // Function IDs are indexes into symbols plus one, assigned as they are used
+  std::vector<bool> functionUsed(symbols.size());
+  uint64_t locationId = 0;
+  for (const auto& [pc, counts] : getCounts()) {
+    locationId++;
+    ProtoWriter location;
+    location.varint(pb::kLocationId, locationId);
+    location.varint(pb::kLocationMappingId, 1);
+    location.varint(pb::kLocationAddress, pc);
+    if (const risc0::ElfSymbol* sym = findSymbol(pc)) {
+      size_t symIdx = sym - symbols.data();
+      functionUsed[symIdx] = true;
+      ProtoWriter line;
+      line.varint(pb::kLineFunctionId, symIdx + 1);
+      location.message(pb::kLocationLine, line);
+    }
+    profile.message(pb::kProfileLocation, location);
+
+    ProtoWriter sample;
+    sample.packed(pb::kSampleLocationId, {locationId});
+    sample.packed(pb::kSampleValue, {counts.userCycles, counts.ecallCycles, counts.pagingCycles});
+    profile.message(pb::kProfileSample, sample);
+  }
+
+  for (size_t i = 0; i < symbols.size(); i++) {
+    if (!functionUsed[i]) {
+      continue;
+    }
+    ProtoWriter function;
+    function.varint(pb::kFunctionId, i + 1);
+    uint64_t name = strings.get(symbols[i].name);
+    function.varint(pb::kFunctionName, name);
+    function.varint(pb::kFunctionSystemName, name);
+    profile.message(pb::kProfileFunction, function);
+  }
+
+  profile.varint(pb::kProfileDefaultSampleType, strings.get("user_cycles"));
+  strings.write(profile);
+  os.write(profile.str().data(), profile.str().size());
+}
+
+} // namespace zirgen::rv32im_v2
@@ -0,0 +1,92 @@
+// Copyright 2024 RISC Zero, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "risc0/core/elf.h"
+
+namespace zirgen::rv32im_v2 {
+
+// Attributes the cycles of an execution to the guest PCs which caused them,
+// and writes them out as a pprof profile.  Counting is a table lookup per
+// step, so it is cheap enough to leave enabled.
+class Profiler {
+public:
+  // The cycles attributed to a single PC
+  struct Counts {
+    // Cycles executing the instruction itself
+    uint64_t userCycles = 0;
+    // Cycles of ecall and Poseidon2 processing started by the instruction
+    uint64_t ecallCycles = 0;
+    // Estimated cycles to page in (and back out) memory first touched by the
+    // instruction
+    uint64_t pagingCycles = 0;
+  };
+
+  // Adds the cycles of one step of the emulator, which started at `pc`
+  void step(uint32_t pc, size_t userCycles, size_t ecallCycles, size_t pagingCycles) {
+    Counts& counts = get(pc);
+    counts.userCycles += userCycles;
+    counts.ecallCycles += ecallCycles;
+    counts.pagingCycles += pagingCycles;
+  }
+
+  // Adds the function symbols of an ELF file, used to name PCs in the profile
+  void addSymbols(const std::vector<uint8_t>& elfBytes);
+  void addSymbols(const std::string& elfPath);
+
+  // Returns the symbol containing `pc`, or nullptr if it is unknown
+  const risc0::ElfSymbol* findSymbol(uint32_t pc) const;
+
+  // Returns the non-zero counts, sorted by PC
+  std::vector<std::pair<uint32_t, Counts>> getCounts() const;
+
+  // Writes the profile as an uncompressed pprof protobuf, with one sample per
+  // PC and a sample type for each kind of cycle
+  void writePprof(std::ostream& os) const;
+
+private:
+  static constexpr size_t kBlockWords = 1024;
+  using Block = std::array<Counts, kBlockWords>;
+
+  Counts& get(uint32_t pc) {
+    uint32_t blockIdx = pc / 4 / kBlockWords;
+    if (blockIdx != lastBlockIdx) {
+      auto& block = blocks[blockIdx];
+      if (!block) {
+        block = std::make_unique<Block>();
+      }
+      lastBlock = block.get();
+      lastBlockIdx = blockIdx;
+    }
+    return (*lastBlock)[pc / 4 % kBlockWords];
+  }
+
+  // Counts for each block of kBlockWords instructions which has executed
+  std::map<uint32_t, std::unique_ptr<Block>> blocks;
+  // Guest code is mostly local, so remember the last block used
+  uint32_t lastBlockIdx = 0xffffffff;
+  Block* lastBlock = nullptr;
+  // Sorted by address
+  std::vector<risc0::ElfSymbol> symbols;
+};
+
+} // namespace zirgen::rv32im_v2
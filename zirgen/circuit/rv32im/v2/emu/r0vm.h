@@ -14,6 +14,8 @@
 
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <stdexcept>
 
 // Add r0 specific privledged ops to a context
@@ -39,6 +41,8 @@ template <typename Context> struct R0Context {
   bool done;
   // Exit code upon termination
   uint32_t exitCode;
+  // Staging for host writes, which are at most 1024 bytes
+  std::array<uint8_t, 1024> ioBuffer;
 
   R0Context(Context& context) : context(context), done(false), exitCode(0) {}
 
@@ -118,11 +122,18 @@ template <typename Context> struct R0Context {
     return true;
   }
 
-  uint8_t hostPeekByte(uint32_t addr) {
-    uint32_t word = addr / 4;
-    uint32_t val = context.hostPeek(word);
-    uint32_t shift = (addr & 0x3) * 8;
-    return val >> shift;
+  // Copies `len` bytes of guest memory starting at `addr`, peeking each word once
+  void hostPeekBytes(uint32_t addr, uint32_t len, uint8_t* out) {
+    if (len > UINT32_MAX - addr) {
+      throw std::runtime_error("Invalid wrapping host peek");
+    }
+    uint32_t end = addr + len;
+    while (addr < end) {
+      uint32_t val = context.hostPeek(addr / 4);
+      for (uint32_t byte = addr % 4; byte < 4 && addr < end; byte++, addr++) {
+        *out++ = val >> (byte * 8);
+      }
+    }
   }
 
   void writeByte(uint32_t addr, uint8_t byte) {
@@ -168,9 +179,11 @@ template <typename Context> struct R0Context {
     if (len > 1024) {
       throw std::runtime_error("Invalid large host read");
     }
-    uint32_t rlen = 0;
-    std::vector<uint8_t> bytes(len);
-    rlen = context.read(fd, bytes.data(), len);
+    // The context returns the bytes read in storage it owns, so they are not
+    // copied again here
+    auto bytes = context.read(fd, len);
+    uint32_t rlen = bytes.size();
+    const uint8_t* data = bytes.data();
     storeReg(REG_A0, rlen);
     if (rlen == 0) {
       context.pc += 4;
@@ -179,7 +192,7 @@ template <typename Context> struct R0Context {
     curState = nextState(ptr, rlen);
     uint32_t i = 0;
     while (rlen > 0 && ptr % 4 != 0) {
-      writeByte(ptr, bytes[i]);
+      writeByte(ptr, data[i]);
       // context.hostReadBytes(ptr);
       ptr++;
       i++;
@@ -191,7 +204,7 @@ template <typename Context> struct R0Context {
         if (j < words) {
           uint32_t word = 0;
           for (size_t k = 0; k < 4; k++) {
-            word |= bytes[i + k] << (8 * k);
+            word |= data[i + k] << (8 * k);
           }
           storeMem(ptr / 4, word);
         } else {
@@ -208,7 +221,7 @@ template <typename Context> struct R0Context {
       curState = nextState(ptr, rlen);
     }
     while (rlen > 0 && ptr % 4 != 0) {
-      writeByte(ptr, bytes[i]);
+      writeByte(ptr, data[i]);
       // context.hostReadBytes(ptr);
       ptr++;
       i++;
@@ -230,12 +243,8 @@ template <typename Context> struct R0Context {
       // But we probably need some bound, so now it's consistent
       throw std::runtime_error("Invalid large host write");
     }
-    uint32_t rlen = len;
-    std::vector<uint8_t> bytes(len);
-    for (size_t i = 0; i < len; i++) {
-      bytes[i] = hostPeekByte(ptr + i);
-    }
-    rlen = context.write(fd, bytes.data(), len);
+    hostPeekBytes(ptr, len, ioBuffer.data());
+    uint32_t rlen = context.write(fd, ioBuffer.data(), len);
     storeReg(REG_A0, rlen);
     context.pc += 4;
     context.ecallCycle(STATE_HOST_WRITE, STATE_DECODE, 0, 0, 0);
@@ -0,0 +1,208 @@
+// Copyright 2024 RISC Zero, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstring>
+#include <sstream>
+
+#include <gtest/gtest.h>
+
+#include "zirgen/circuit/rv32im/v2/emu/exec.h"
+#include "zirgen/circuit/rv32im/v2/emu/preflight.h"
+#include "zirgen/circuit/rv32im/v2/emu/r0vm.h"
+
+using namespace zirgen::rv32im_v2;
+
+namespace {
+
+const std::string kernelName = "zirgen/circuit/rv32im/v2/kernel/kernel";
+const std::string pagesName = "zirgen/circuit/rv32im/v2/emu/test/pages";
+
+constexpr size_t kSegmentSize = 1 << 15;
+// Leaves room for the paging of the step which crosses the threshold
+constexpr size_t kThreshold = kSegmentSize - 4096;
+
+std::vector<Segment> executePages(SegmentPolicy& policy, MemoryImage& image, uint32_t& result) {
+  image = MemoryImage::fromElfs(kernelName, pagesName);
+  TestIoHandler io;
+  io.push_u32(0, 8);
+  auto segments = execute(image, io, policy, 100000000);
+  result = io.pop_u32(1);
+  return segments;
+}
+
+// Just enough of a context for R0Context::hostPeekBytes: word `i` holds bytes
+// 4i, 4i+1, 4i+2, 4i+3 (mod 256)
+struct PeekContext {
+  size_t peeks = 0;
+  uint32_t hostPeek(uint32_t word) {
+    peeks++;
+    uint32_t val = 0;
+    for (uint32_t i = 0; i < 4; i++) {
+      val |= ((word * 4 + i) & 0xff) << (i * 8);
+    }
+    return val;
+  }
+};
+
+} // namespace
+
+TEST(StreamIoHandler, ReadsInChunks) {
+  std::istringstream in("hello world");
+  StreamIoHandler io;
+  io.inputs[3] = &in;
+  uint8_t buf[8];
+  EXPECT_EQ(io.read(3, buf, 5), 5u);
+  EXPECT_EQ(std::string(buf, buf + 5), "hello");
+  // A read past the end returns what's left, then nothing
+  EXPECT_EQ(io.read(3, buf, 8), 6u);
+  EXPECT_EQ(std::string(buf, buf + 6), " world");
+  EXPECT_EQ(io.read(3, buf, 8), 0u);
+}
+
+TEST(StreamIoHandler, UnmappedDescriptors) {
+  StreamIoHandler io;
+  uint8_t buf[4] = {1, 2, 3, 4};
+  EXPECT_EQ(io.read(0, buf, 4), 0u);
+  EXPECT_EQ(io.write(1, buf, 4), 4u);
+}
+
+TEST(StreamIoHandler, Writes) {
+  std::ostringstream out;
+  StreamIoHandler io;
+  io.outputs[1] = &out;
+  const uint8_t data[] = {'a', 'b', 'c'};
+  EXPECT_EQ(io.write(1, data, 3), 3u);
+  EXPECT_EQ(io.write(1, data, 0), 0u);
+  EXPECT_EQ(io.write(1, data + 1, 2), 2u);
+  EXPECT_EQ(out.str(), "abcbc");
+}
+
+TEST(StreamIoHandler, StreamErrors) {
+  std::istringstream in("data");
+  in.setstate(std::ios::badbit);
+  std::ostringstream out;
+  out.setstate(std::ios::badbit);
+  StreamIoHandler io;
+  io.inputs[0] = &in;
+  io.outputs[1] = &out;
+  uint8_t buf[4] = {};
+  EXPECT_THROW(io.read(0, buf, 4), std::runtime_error);
+  EXPECT_THROW(io.write(1, buf, 4), std::runtime_error);
+}
+
+TEST(IoArena, PointersStayValid) {
+  IoArena arena;
+  std::vector<std::pair<const uint8_t*, uint32_t>> slices;
+  // Enough 1000 byte reads to fill several chunks
+  for (uint32_t i = 0; i < 4000; i++) {
+    uint8_t* ptr = arena.reserve(1024);
+    uint32_t used = 1000 + i % 24;
+    memset(ptr, i & 0xff, used);
+    arena.commit(used);
+    slices.emplace_back(ptr, used);
+  }
+  for (uint32_t i = 0; i < slices.size(); i++) {
+    auto [ptr, len] = slices[i];
+    for (uint32_t j = 0; j < len; j++) {
+      ASSERT_EQ(ptr[j], i & 0xff) << "slice " << i << " byte " << j;
+    }
+  }
+}
+
+TEST(IoArena, PacksCommittedBytes) {
+  IoArena arena;
+  uint8_t* first = arena.reserve(1024);
+  arena.commit(10);
+  // Only what was committed is kept, so the next read starts right after it
+  EXPECT_EQ(arena.reserve(1024), first + 10);
+  arena.commit(0);
+  EXPECT_EQ(arena.reserve(16), first + 10);
+}
+
+TEST(IoArena, Limits) {
+  IoArena arena;
+  uint8_t* whole = arena.reserve(1 << 20);
+  arena.commit(1 << 20);
+  // A full chunk leaves no room, so even an empty read gets a new one
+  uint8_t* next = arena.reserve(1);
+  EXPECT_NE(next, whole);
+  EXPECT_THROW(arena.reserve((1 << 20) + 1), std::runtime_error);
+}
+
+TEST(R0Context, HostPeekBytes) {
+  PeekContext context;
+  R0Context<PeekContext> r0(context);
+  for (uint32_t addr = 0x1000; addr < 0x1008; addr++) {
+    for (uint32_t len = 0; len < 12; len++) {
+      std::vector<uint8_t> out(len);
+      context.peeks = 0;
+      r0.hostPeekBytes(addr, len, out.data());
+      for (uint32_t i = 0; i < len; i++) {
+        ASSERT_EQ(out[i], (addr + i) & 0xff) << "addr " << addr << " len " << len;
+      }
+      // Each word is peeked once
+      uint32_t words = len ? (addr + len - 1) / 4 - addr / 4 + 1 : 0;
+      EXPECT_EQ(context.peeks, words);
+    }
+  }
+}
+
+TEST(R0Context, HostPeekBytesWrapping) {
+  PeekContext context;
+  R0Context<PeekContext> r0(context);
+  uint8_t out[16];
+  // Reading up to the last byte of memory is fine
+  r0.hostPeekBytes(0xfffffff0, 15, out);
+  EXPECT_EQ(out[14], 0xfe);
+  // Anything that would run off the end of memory faults instead of wrapping
+  EXPECT_THROW(r0.hostPeekBytes(0xfffffff0, 16, out), std::runtime_error);
+  EXPECT_THROW(r0.hostPeekBytes(0xfffffffc, 0xffffffff, out), std::runtime_error);
+  EXPECT_THROW(r0.hostPeekBytes(1, 0xffffffff, out), std::runtime_error);
+}
+
+// Splitting at paging bursts must not change what the guest computes or how
+// many cycles it takes, and must still keep every segment within its size.
+TEST(PagingAwarePolicy, ManyPages) {
+  ThresholdPolicy thresholdPolicy(kThreshold);
+  MemoryImage expectedImage;
+  uint32_t expected;
+  auto expectedSegments = executePages(thresholdPolicy, expectedImage, expected);
+  ASSERT_GT(expectedSegments.size(), 2u);
+
+  PagingAwarePolicy pagingPolicy(kThreshold);
+  MemoryImage image;
+  uint32_t result;
+  auto segments = executePages(pagingPolicy, image, result);
+  EXPECT_EQ(result, expected);
+  EXPECT_EQ(image.getDigest(1), expectedImage.getDigest(1));
+
+  size_t expectedCycles = 0;
+  for (const Segment& segment : expectedSegments) {
+    expectedCycles += segment.suspendCycle;
+  }
+  size_t cycles = 0;
+  for (size_t i = 0; i < segments.size(); i++) {
+    SCOPED_TRACE("segment " + std::to_string(i));
+    const Segment& segment = segments[i];
+    cycles += segment.suspendCycle;
+    EXPECT_EQ(segment.isTerminate, i + 1 == segments.size());
+    EXPECT_LE(segment.suspendCycle + segment.pagingCycles, kSegmentSize);
+    EXPECT_LE(segment.segmentThreshold, kThreshold);
+    // Preflight pads to the segment size, so any overflow shows as a longer
+    // trace
+    PreflightTrace trace = preflightSegment(segment, kSegmentSize);
+    EXPECT_EQ(trace.cycles.size(), kSegmentSize);
+  }
+  EXPECT_EQ(cycles, expectedCycles);
+}
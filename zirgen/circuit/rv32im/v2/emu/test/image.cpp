@@ -0,0 +1,100 @@
+// Copyright 2024 RISC Zero, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include "zirgen/circuit/rv32im/v2/emu/image.h"
+#include "zirgen/circuit/rv32im/v2/emu/paging.h"
+
+using namespace zirgen::rv32im_v2;
+
+namespace {
+
+std::map<uint32_t, uint32_t> testWords() {
+  std::map<uint32_t, uint32_t> words;
+  for (uint32_t i = 0; i < 3 * PAGE_SIZE_WORDS; i++) {
+    words[0x10000 + i] = i * 7 + 1;
+  }
+  return words;
+}
+
+} // namespace
+
+TEST(PageStore, InternReturnsFirstLivePage) {
+  PageStore store;
+  auto page = std::make_shared<Page>();
+  (*page)[0] = 1;
+  auto copy = std::make_shared<Page>(*page);
+  zirgen::Digest digest = zirgen::Digest::zero();
+  digest.words[0] = 1;
+
+  EXPECT_EQ(store.intern(digest, page), page);
+  EXPECT_EQ(store.intern(digest, copy), page);
+  EXPECT_EQ(store.size(), 1u);
+
+  // Once the original goes away, the next page interned takes its place
+  page.reset();
+  EXPECT_EQ(store.intern(digest, copy), copy);
+}
+
+// Images built separately from the same words must share each page's data
+TEST(PageStore, IdenticalImagesSharePages) {
+  auto lhs = MemoryImage::fromWords(testWords());
+  auto rhs = MemoryImage::fromWords(testWords());
+  EXPECT_EQ(lhs.getDigest(1), rhs.getDigest(1));
+  for (uint32_t page = 0x10000 / PAGE_SIZE_WORDS; page < 0x10000 / PAGE_SIZE_WORDS + 3; page++) {
+    EXPECT_EQ(lhs.getPage(page).get(), rhs.getPage(page).get()) << "page " << page;
+  }
+}
+
+// Writing a page back with its original contents must leave the image as it
+// was, still holding the original page data
+TEST(PagedMemory, CommitUnchangedPage) {
+  auto image = MemoryImage::fromWords(testWords());
+  uint32_t word = 0x10000 + PAGE_SIZE_WORDS + 5;
+  uint32_t page = word / PAGE_SIZE_WORDS;
+  zirgen::Digest digest = image.getDigest(1);
+  PagePtr orig = image.getPage(page);
+
+  PagedMemory pager(image);
+  uint32_t val = pager.load(word);
+  pager.store(word, val + 1);
+  pager.store(word, val);
+  MemoryImage segment = pager.commit();
+
+  EXPECT_EQ(image.getDigest(1), digest);
+  EXPECT_EQ(image.getPage(page).get(), orig.get());
+  EXPECT_EQ(segment.getDigest(1), digest);
+  EXPECT_EQ(segment.getPage(page).get(), orig.get());
+}
+
+// Whereas a real change must update the image
+TEST(PagedMemory, CommitChangedPage) {
+  auto image = MemoryImage::fromWords(testWords());
+  uint32_t word = 0x10000 + PAGE_SIZE_WORDS + 5;
+  uint32_t page = word / PAGE_SIZE_WORDS;
+  zirgen::Digest digest = image.getDigest(1);
+  PagePtr orig = image.getPage(page);
+
+  PagedMemory pager(image);
+  uint32_t val = pager.load(word);
+  pager.store(word, val + 1);
+  MemoryImage segment = pager.commit();
+
+  EXPECT_NE(image.getDigest(1), digest);
+  EXPECT_NE(image.getPage(page).get(), orig.get());
+  EXPECT_EQ((*image.getPage(page))[word % PAGE_SIZE_WORDS], val + 1);
+  EXPECT_EQ(segment.getDigest(1), digest);
+  EXPECT_EQ(segment.getPage(page).get(), orig.get());
+}
@@ -0,0 +1,40 @@
+// Copyright 2024 RISC Zero, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdint.h>
+#include <unistd.h>
+
+// Walks a series of 32 page working sets, several times each, so that
+// execution alternates between bursts of paging and steady work
+constexpr uint32_t kPhases = 8;
+constexpr uint32_t kPhaseWords = 32 * 256;
+
+uint32_t buf[kPhases * kPhaseWords];
+
+int main() {
+  uint32_t rounds = 0;
+  uint32_t tot = 0;
+  read(0, &rounds, sizeof(uint32_t));
+  for (uint32_t phase = 0; phase < kPhases; phase++) {
+    uint32_t* region = buf + phase * kPhaseWords;
+    for (uint32_t round = 0; round < rounds; round++) {
+      for (uint32_t i = 0; i < kPhaseWords; i += 64) {
+        region[i] += i + round;
+        tot += region[i];
+      }
+    }
+  }
+  write(1, &tot, sizeof(uint32_t));
+  return 0;
+}
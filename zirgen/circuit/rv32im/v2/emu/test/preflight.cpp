@@ -0,0 +1,142 @@
+// Copyright 2024 RISC Zero, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include "zirgen/circuit/rv32im/v2/emu/exec.h"
+#include "zirgen/circuit/rv32im/v2/emu/image.h"
+#include "zirgen/circuit/rv32im/v2/emu/preflight.h"
+
+using namespace zirgen::rv32im_v2;
+
+namespace {
+
+const std::string kernelName = "zirgen/circuit/rv32im/v2/kernel/kernel";
+const std::string progName = "zirgen/circuit/rv32im/v2/emu/test/guest";
+
+constexpr size_t kThreshold = 16000;
+constexpr size_t kSegmentSize = 16384;
+
+std::vector<Segment> executeGuest(bool recordPreflight) {
+  auto image = MemoryImage::fromElfs(kernelName, progName);
+  TestIoHandler io;
+  io.push_u32(0, 100);
+  return execute(image, io, kThreshold, 10000000, zirgen::Digest::zero(), recordPreflight);
+}
+
+void expectCyclesEq(llvm::ArrayRef<PreflightCycle> lhs, llvm::ArrayRef<PreflightCycle> rhs) {
+  ASSERT_EQ(lhs.size(), rhs.size());
+  for (size_t i = 0; i < lhs.size(); i++) {
+    SCOPED_TRACE("cycle " + std::to_string(i));
+    EXPECT_EQ(lhs[i].state, rhs[i].state);
+    EXPECT_EQ(lhs[i].pc, rhs[i].pc);
+    EXPECT_EQ(lhs[i].major, rhs[i].major);
+    EXPECT_EQ(lhs[i].minor, rhs[i].minor);
+    EXPECT_EQ(lhs[i].machineMode, rhs[i].machineMode);
+    EXPECT_EQ(lhs[i].memCycle, rhs[i].memCycle);
+    EXPECT_EQ(lhs[i].userCycle, rhs[i].userCycle);
+    EXPECT_EQ(lhs[i].extraPtr, rhs[i].extraPtr);
+    EXPECT_EQ(lhs[i].diffCount[0], rhs[i].diffCount[0]);
+    EXPECT_EQ(lhs[i].diffCount[1], rhs[i].diffCount[1]);
+  }
+}
+
+void expectTxnsEq(const std::vector<MemoryTransaction>& lhs,
+                  const std::vector<MemoryTransaction>& rhs) {
+  ASSERT_EQ(lhs.size(), rhs.size());
+  for (size_t i = 0; i < lhs.size(); i++) {
+    SCOPED_TRACE("txn " + std::to_string(i));
+    EXPECT_EQ(lhs[i].word, rhs[i].word);
+    EXPECT_EQ(lhs[i].cycle, rhs[i].cycle);
+    EXPECT_EQ(lhs[i].val, rhs[i].val);
+    EXPECT_EQ(lhs[i].prevCycle, rhs[i].prevCycle);
+    EXPECT_EQ(lhs[i].prevVal, rhs[i].prevVal);
+  }
+}
+
+// Marks the extra words which preflight fills in from its random paging
+// challenge, and so differ between two preflights of the same segment.
+std::vector<bool> rngDependentExtra(const PreflightTrace& trace) {
+  std::vector<bool> mask(trace.extra.size());
+  for (size_t i = 0; i + 1 < trace.cycles.size(); i++) {
+    uint32_t major = trace.cycles[i].major;
+    if (major != MajorType::POSEIDON0 && major != MajorType::POSEIDON1) {
+      continue;
+    }
+    uint32_t state = (major - 7) * 8 + trace.cycles[i].minor;
+    if (state == STATE_POSEIDON_LOAD_IN || state == STATE_POSEIDON_EXT_ROUND ||
+        state == STATE_POSEIDON_INT_ROUND) {
+      for (size_t j = 0; j < 4; j++) {
+        mask[trace.cycles[i + 1].extraPtr - 4 + j] = true;
+      }
+    }
+  }
+  return mask;
+}
+
+} // namespace
+
+// Preflight must produce the same trace from the executor's recording as from
+// emulating the segment again.
+TEST(Preflight, RecordingMatchesEmulation) {
+  auto segments = executeGuest(true);
+  ASSERT_GT(segments.size(), 2u);
+  for (size_t i = 0; i < segments.size(); i++) {
+    SCOPED_TRACE("segment " + std::to_string(i));
+    ASSERT_TRUE(segments[i].recording);
+    PreflightTrace recorded = preflightSegment(segments[i], kSegmentSize);
+    Segment emulatedSegment = segments[i];
+    emulatedSegment.recording.reset();
+    PreflightTrace emulated = preflightSegment(emulatedSegment, kSegmentSize);
+
+    expectCyclesEq(recorded.cycles, emulated.cycles);
+    expectTxnsEq(recorded.txns, emulated.txns);
+    EXPECT_EQ(recorded.tableSplitCycle, emulated.tableSplitCycle);
+    ASSERT_EQ(recorded.extra.size(), emulated.extra.size());
+    auto mask = rngDependentExtra(recorded);
+    for (size_t j = 0; j < recorded.extra.size(); j++) {
+      if (!mask[j]) {
+        EXPECT_EQ(recorded.extra[j], emulated.extra[j]) << "extra " << j;
+      }
+    }
+  }
+}
+
+// A serialized trace must read back exactly, both through the view and when
+// copied out of it.
+TEST(Preflight, SerializeRoundTrip) {
+  auto segments = executeGuest(false);
+  ASSERT_GT(segments.size(), 2u);
+  for (size_t i = 0; i < segments.size(); i++) {
+    SCOPED_TRACE("segment " + std::to_string(i));
+    PreflightTrace trace = preflightSegment(segments[i], kSegmentSize);
+    std::vector<uint8_t> buf = serializePreflight(trace);
+    PreflightTraceView view(buf.data(), buf.size());
+
+    expectCyclesEq(view.getCycles(), trace.cycles);
+    EXPECT_EQ(std::vector<uint32_t>(view.getExtra().begin(), view.getExtra().end()),
+              trace.extra);
+    EXPECT_EQ(view.getTableSplitCycle(), trace.tableSplitCycle);
+    EXPECT_EQ(view.getRng(), trace.rng);
+    EXPECT_EQ(view.getTxnCount(), trace.txns.size());
+    expectTxnsEq(view.decodeTxns(), trace.txns);
+
+    PreflightTrace copy = view.toTrace();
+    expectCyclesEq(copy.cycles, trace.cycles);
+    expectTxnsEq(copy.txns, trace.txns);
+    EXPECT_EQ(copy.extra, trace.extra);
+    EXPECT_EQ(copy.tableSplitCycle, trace.tableSplitCycle);
+    EXPECT_EQ(copy.rng, trace.rng);
+  }
+}
@@ -32,5 +32,25 @@ int main() {
     std::cout << "Result = " << result << "\n";
   }
   auto ptrace = preflightSegment(segments[0], 1000000 + 2000);
+
+  // Recording sends every register access through the pager, whereas plain
+  // execution caches the register page; both must produce the same segments
+  auto refImage = MemoryImage::fromElfs(path + "kernel/kernel", path + "emu/test/guest");
+  TestIoHandler refIo;
+  refIo.push_u32(0, 1000);
+  auto refSegments =
+      execute(refImage, refIo, 1000000, 64 * 1024 * 1024, zirgen::Digest::zero(), true);
+  if (refImage.getDigest(1) != image.getDigest(1) || refSegments.size() != segments.size()) {
+    std::cerr << "Register cache changed the final image\n";
+    return 1;
+  }
+  for (size_t i = 0; i < segments.size(); i++) {
+    if (refSegments[i].suspendCycle != segments[i].suspendCycle ||
+        refSegments[i].pagingCycles != segments[i].pagingCycles ||
+        refSegments[i].image.getDigest(1) != segments[i].image.getDigest(1)) {
+      std::cerr << "Register cache changed segment " << i << "\n";
+      return 1;
+    }
+  }
   return 0;
 }
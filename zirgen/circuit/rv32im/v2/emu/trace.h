@@ -30,11 +30,15 @@ public:
   size_t getRows() { return rows; }
   size_t getCols() { return cols; }
 
+  // Raw row major access to the trace, for bulk initialization
+  Fp* getBuffer() { return vec.data(); }
+
   void set(size_t row, size_t col, Fp val);
   Fp get(size_t row, size_t col);
   void setUnset();
 
   void setUnsafe(bool val = true);
+  bool isUnsafe() const { return unsafeReads; }
 
 private:
   size_t rows;
@@ -48,10 +52,14 @@ public:
   GlobalTraceGroup(size_t cols);
   size_t getCols() { return cols; }
 
+  // Raw access to the columns
+  Fp* getBuffer() { return vec.data(); }
+
   void set(size_t col, Fp val);
   Fp get(size_t col);
 
   void setUnsafe(bool val = true);
+  bool isUnsafe() const { return unsafeReads; }
 
 private:
   size_t cols;
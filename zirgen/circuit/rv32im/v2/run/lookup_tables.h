@@ -0,0 +1,145 @@
+// Copyright 2024 RISC Zero, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <vector>
+
+#include "risc0/fp/fp.h"
+
+namespace zirgen::rv32im_v2 {
+
+struct MemTxnKey {
+  uint32_t addr;
+  uint32_t cycle;
+  uint32_t data;
+  bool operator<(const MemTxnKey& rhs) const {
+    if (addr != rhs.addr) {
+      return addr < rhs.addr;
+    }
+    if (cycle != rhs.cycle) {
+      return cycle < rhs.cycle;
+    }
+    return data < rhs.data;
+  }
+};
+
+// The running totals of the lookup arguments made by witness generation, each
+// of which must be zero once every cycle has run.  Lookups into a table that's
+// known when the step code is generated go straight to that table's
+// accumulator, which is small enough to inline.
+struct LookupTables {
+  // Table ids as used by the circuit
+  static constexpr uint32_t kCycle = 0;
+  static constexpr uint32_t kU8 = 8;
+  static constexpr uint32_t kU16 = 16;
+
+  LookupTables() : tableU8(1U << kU8), tableU16(1U << kU16) {}
+
+  template <uint32_t table> void lookupDelta(risc0::Fp index, risc0::Fp count) {
+    if constexpr (table == kCycle) {
+      tableCycle[index] += count;
+    } else {
+      rangeTable<table>(index) += count;
+    }
+  }
+
+  template <uint32_t table> risc0::Fp lookupCurrent(risc0::Fp index) {
+    return rangeTable<table>(index);
+  }
+
+  // As above, for a table that's only known at runtime.
+  void lookupDelta(risc0::Fp table, risc0::Fp index, risc0::Fp count) {
+    switch (table.asUInt32()) {
+    case kCycle:
+      return lookupDelta<kCycle>(index, count);
+    case kU8:
+      return lookupDelta<kU8>(index, count);
+    case kU16:
+      return lookupDelta<kU16>(index, count);
+    default:
+      throw std::runtime_error("Invalid lookup table");
+    }
+  }
+
+  risc0::Fp lookupCurrent(risc0::Fp table, risc0::Fp index) {
+    switch (table.asUInt32()) {
+    case kU8:
+      return lookupCurrent<kU8>(index);
+    case kU16:
+      return lookupCurrent<kU16>(index);
+    default:
+      throw std::runtime_error("Invalid lookup table");
+    }
+  }
+
+  void memoryDelta(uint32_t addr, uint32_t cycle, uint32_t data, risc0::Fp count) {
+    tableMem[{addr, cycle, data}] += count;
+  }
+
+  void check() {
+    for (size_t i = 0; i < tableU8.size(); i++) {
+      if (tableU8[i] != 0) {
+        std::cerr << "U8 entry " << i << ": " << tableU8[i].asUInt32() << "\n";
+        throw std::runtime_error("Table not zero");
+      }
+    }
+    for (size_t i = 0; i < tableU16.size(); i++) {
+      if (tableU16[i] != 0) {
+        std::cerr << "U16 entry " << i << ": " << tableU16[i].asUInt32() << "\n";
+        throw std::runtime_error("Table not zero");
+      }
+    }
+    for (const auto& kvp : tableMem) {
+      if (kvp.second != 0) {
+        std::cerr << "Nonzero memory entry: (" << kvp.first.addr << ", " << kvp.first.cycle << ", "
+                  << kvp.first.data << ") = " << kvp.second.asUInt32() << "\n";
+        throw std::runtime_error("Table not zero");
+      }
+    }
+    for (const auto& kvp : tableCycle) {
+      if (kvp.second != 0) {
+        std::cerr << "Cycle entry " << kvp.first.asUInt32() << ": " << kvp.second.asUInt32()
+                  << "\n";
+        throw std::runtime_error("Table not zero");
+      }
+    }
+  }
+
+  // The U8 and U16 tables are dense, indexed by the value being looked up
+  std::vector<risc0::Fp> tableU8;
+  std::vector<risc0::Fp> tableU16;
+  std::map<MemTxnKey, risc0::Fp> tableMem;
+  std::map<risc0::Fp, risc0::Fp> tableCycle;
+
+private:
+  template <uint32_t table> risc0::Fp& rangeTable(risc0::Fp index) {
+    static_assert(table == kU8 || table == kU16, "Invalid lookup table");
+    uint32_t idx = index.asUInt32();
+    if (idx >= (1U << table)) {
+      badIndex(table, idx);
+    }
+    return table == kU8 ? tableU8[idx] : tableU16[idx];
+  }
+
+  [[noreturn]] void badIndex(uint32_t table, uint32_t idx) {
+    std::cerr << "LOOKUP ERROR: table = " << table << ", index = " << idx << "\n";
+    throw std::runtime_error("u8/16 table error");
+  }
+};
+
+} // namespace zirgen::rv32im_v2
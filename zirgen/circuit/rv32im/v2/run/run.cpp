@@ -17,101 +17,15 @@
 
 #include "risc0/core/elf.h"
 #include "risc0/core/util.h"
+#include "zirgen/circuit/common/scatter.h"
 #include "zirgen/circuit/rv32im/v2/emu/exec.h"
 #include "zirgen/circuit/rv32im/v2/emu/preflight.h"
 #include "zirgen/circuit/rv32im/v2/emu/r0vm.h"
+#include "zirgen/circuit/rv32im/v2/run/run.h"
 #include "zirgen/circuit/rv32im/v2/run/wrap_dsl.h"
 
 namespace zirgen::rv32im_v2 {
 
-struct MemTxnKey {
-  uint32_t addr;
-  uint32_t cycle;
-  uint32_t data;
-  bool operator<(const MemTxnKey& rhs) const {
-    if (addr != rhs.addr) {
-      return addr < rhs.addr;
-    }
-    if (cycle != rhs.cycle) {
-      return cycle < rhs.cycle;
-    }
-    return data < rhs.data;
-  }
-};
-
-struct LookupTables {
-  std::map<uint32_t, risc0::Fp> tableU8;
-  std::map<uint32_t, risc0::Fp> tableU16;
-  std::map<MemTxnKey, risc0::Fp> tableMem;
-  std::map<risc0::Fp, risc0::Fp> tableCycle;
-
-  void lookupDelta(risc0::Fp table, risc0::Fp index, risc0::Fp count) {
-    uint32_t tableU32 = table.asUInt32();
-    if (tableU32 == 0) {
-      tableCycle[index] += count;
-      return;
-    }
-    if (tableU32 != 8 && tableU32 != 16) {
-      throw std::runtime_error("Invalid lookup table");
-    }
-    if (index.asUInt32() >= (1U << tableU32)) {
-      std::cerr << "LOOKUP ERROR: table = " << table.asUInt32() << ", index = " << index.asUInt32()
-                << "\n";
-      throw std::runtime_error("u8/16 table error");
-    }
-    if (tableU32 == 8) {
-      tableU8[index.asUInt32()] += count;
-    } else {
-      tableU16[index.asUInt32()] += count;
-    }
-  }
-
-  risc0::Fp lookupCurrent(risc0::Fp table, risc0::Fp index) {
-    uint32_t tableU32 = table.asUInt32();
-    if (tableU32 != 8 && tableU32 != 16) {
-      throw std::runtime_error("Invalid lookup table");
-    }
-    if (tableU32 == 8) {
-      return tableU8[index.asUInt32()];
-    } else {
-      return tableU16[index.asUInt32()];
-    }
-  }
-
-  void memoryDelta(uint32_t addr, uint32_t cycle, uint32_t data, risc0::Fp count) {
-    tableMem[{addr, cycle, data}] += count;
-  }
-
-  void check() {
-    for (const auto& kvp : tableU8) {
-      if (kvp.second != 0) {
-        std::cerr << "U8 entry " << kvp.first << ": " << kvp.second.asUInt32() << "\n";
-        throw std::runtime_error("Table not zero");
-      }
-    }
-    for (const auto& kvp : tableU16) {
-      if (kvp.second != 0) {
-        std::cerr << "U16 entry " << kvp.first << ": " << kvp.second.asUInt32() << "\n";
-        throw std::runtime_error("Table not zero");
-      }
-    }
-    for (const auto& kvp : tableMem) {
-      if (kvp.second != 0) {
-        std::cerr << "Nonzero memory entry: (" << kvp.first.addr << ", " << kvp.first.cycle << ", "
-                  << kvp.first.data << ") = " << kvp.second.asUInt32() << "\n";
-        throw std::runtime_error("Table not zero");
-      }
-    }
-    for (const auto& kvp : tableCycle) {
-      if (kvp.second != 0) {
-        std::cerr << "Cycle entry " << kvp.first.asUInt32() << ": " << kvp.second.asUInt32()
-                  << "\n";
-        throw std::runtime_error("Table not zero");
-      }
-    }
-  }
-};
-
 struct ReplayHandler : public StepHandler {
   ReplayHandler(const PreflightTrace& preflight, LookupTables& tables, size_t cycle)
       : preflight(preflight), tables(tables), cycle(cycle), which(0) {}
@@ -163,17 +77,7 @@ struct ReplayHandler : public StepHandler {
     return {idx, preflight.cycles[cycle].machineMode};
   }
 
-  void lookupDelta(risc0::Fp table, risc0::Fp index, risc0::Fp count) override {
-    tables.lookupDelta(table, index, count);
-  }
-
-  risc0::Fp lookupCurrent(risc0::Fp table, risc0::Fp index) override {
-    return tables.lookupCurrent(table, index);
-  }
-
-  void memoryDelta(uint32_t addr, uint32_t cycle, uint32_t data, risc0::Fp count) override {
-    tables.memoryDelta(addr, cycle, data, count);
-  }
+  LookupTables& getLookupTables() override { return tables; }
 
   uint32_t getDiffCount(uint32_t cycle) override {
     return preflight.cycles[cycle / 2].diffCount[cycle % 2];
@@ -185,9 +89,46 @@ struct ReplayHandler : public StepHandler {
   size_t which;
 };
 
+namespace {
+
+// Builds the list of stateful columns which come directly from the preflight
+ScatterList scatterPreflight(const PreflightTrace& preflight) {
+  size_t cycles = preflight.cycles.size();
+  ScatterList out;
+  // Start with a copy of the extra data, so it can be scattered in place
+  out.data = preflight.extra;
+  out.data.reserve(out.data.size() + cycles * 4);
+  out.infos.reserve(cycles * 4);
+  for (size_t i = 0; i < cycles; i++) {
+    const PreflightCycle& cycle = preflight.cycles[i];
+    uint32_t offset = out.addWord(i);
+    out.add(offset, i, getCycleCol(), 1, 32);
+    // PC is split into two 16 bit halves, followed by state and machine mode
+    out.addWord(cycle.pc);
+    out.add(offset + 1, i, getTopStateCol(), 2, 16);
+    out.addWord(cycle.state);
+    out.addWord(cycle.machineMode);
+    out.add(offset + 2, i, getTopStateCol() + 2, 2, 32);
+    size_t extraStart = cycle.extraPtr;
+    size_t extraEnd = (i == cycles - 1) ? preflight.extra.size() : preflight.cycles[i + 1].extraPtr;
+    size_t extraSize = extraEnd - extraStart;
+    if (extraSize == 3) {
+      out.add(extraStart, i, getEcall0StateCol(), extraSize, 32);
+    } else if (extraSize) {
+      out.add(extraStart, i, getPoseidonStateCol(), extraSize, 32);
+    }
+  }
+  return out;
+}
+
+} // namespace
+
 ExecutionTrace runSegment(const Segment& segment, size_t segmentSize) {
+  return runSegment(segment, preflightSegment(segment, segmentSize));
+}
+
+ExecutionTrace runSegment(const Segment& segment, const PreflightTrace& preflightTrace) {
   auto rootIn = segment.image.getDigest(1);
-  auto preflightTrace = preflightSegment(segment, segmentSize);
   size_t cycles = preflightTrace.cycles.size();
   std::cout << "**** TRACE cycle: " << cycles << "\n";
   std::cout << "Segment main cycle count: " << segment.suspendCycle << "\n";
@@ -211,29 +152,8 @@ ExecutionTrace runSegment(const Segment& segment, size_t segmentSize) {
   // Set isTerminate
   trace.global.set(16, segment.isTerminate);
   // Set stateful columns from 'top'
-  for (size_t i = 0; i < cycles; i++) {
-    std::cout << "Cycle: " << i << ", pc = " << preflightTrace.cycles[i].pc / 4
-              << ", state = " << preflightTrace.cycles[i].state << "\n";
-    trace.data.set(i, getCycleCol(), i);
-    trace.data.set(i, getTopStateCol() + 0, preflightTrace.cycles[i].pc & 0xffff);
-    trace.data.set(i, getTopStateCol() + 1, preflightTrace.cycles[i].pc >> 16);
-    trace.data.set(i, getTopStateCol() + 2, preflightTrace.cycles[i].state);
-    trace.data.set(i, getTopStateCol() + 3, preflightTrace.cycles[i].machineMode);
-    size_t extraStart = preflightTrace.cycles[i].extraPtr;
-    size_t extraEnd =
-        (i == cycles - 1) ? preflightTrace.extra.size() : preflightTrace.cycles[i + 1].extraPtr;
-    size_t extraSize = extraEnd - extraStart;
-    if (extraSize == 3) {
-      for (size_t j = 0; j < extraSize; j++) {
-        trace.data.set(i, getEcall0StateCol() + j, preflightTrace.extra[extraStart + j]);
-      }
-    } else {
-      for (size_t j = 0; j < extraSize; j++) {
-        // std::cout << "  extra: " << preflightTrace.extra[extraStart + j] << "\n";
-        trace.data.set(i, getPoseidonStateCol() + j, preflightTrace.extra[extraStart + j]);
-      }
-    }
-  }
+  auto scatter = scatterPreflight(preflightTrace);
+  applyScatter(trace.data.getBuffer(), cycles, trace.data.getCols(), scatter);
 
   LookupTables tables;
   // for (size_t i = 0; i < preflightTrace.tableSplitCycle; i++) {
@@ -15,10 +15,15 @@
 #include <string>
 
 #include "zirgen/circuit/rv32im/v2/emu/exec.h"
+#include "zirgen/circuit/rv32im/v2/emu/preflight.h"
 #include "zirgen/circuit/rv32im/v2/emu/trace.h"
 
 namespace zirgen::rv32im_v2 {
 
 ExecutionTrace runSegment(const Segment& segment, size_t segmentSize);
 
+// Generates the witness of a segment from an existing preflight trace, e.g.
+// one read back from serializePreflight, so that runs share its random values
+ExecutionTrace runSegment(const Segment& segment, const PreflightTrace& preflightTrace);
+
 } // namespace zirgen::rv32im_v2
@@ -48,9 +48,13 @@ ExtVal operator-(const ExtVal& lhs, const Val& rhs) {
 struct ExecContext {
 public:
   ExecContext(StepHandler& stepHandler, ExecutionTrace& trace, size_t cycle)
-      : stepHandler(stepHandler), trace(trace), cycle(cycle) {}
+      : stepHandler(stepHandler)
+      , tables(stepHandler.getLookupTables())
+      , trace(trace)
+      , cycle(cycle) {}
 
   StepHandler& stepHandler;
+  LookupTables& tables;
   ExecutionTrace& trace;
   size_t cycle;
 };
@@ -100,36 +104,98 @@ struct Reg {
   size_t col;
 };
 
+#ifdef RV32IM_CHECKED_TRACE_ACCESS
+
+// Reaches the trace through the checked TraceGroup accessors on every access,
+// as the step did before BufferObj below.  Only built for tests, which check
+// that both produce the same trace.
 struct BufferObj {
-  virtual Val load(size_t col, size_t back) = 0;
-  virtual void store(size_t col, Val val) = 0;
-};
+  BufferObj(ExecContext& ctx, TraceGroup& group) : cycle(ctx.cycle), group(&group) {}
+  BufferObj(ExecContext& ctx, GlobalTraceGroup& group) : cycle(ctx.cycle), global(&group) {}
 
-struct MutableBufObj : public BufferObj {
-  MutableBufObj(ExecContext& ctx, TraceGroup& group) : ctx(ctx), group(group) {}
-  Val load(size_t col, size_t back) override {
-    size_t backRow = (group.getRows() + ctx.cycle - back) % group.getRows();
-    return group.get(backRow, col);
+  Val load(size_t col, size_t back) {
+    if (global) {
+      assert(back == 0);
+      return global->get(col);
+    }
+    size_t backRow = (group->getRows() + cycle - back) % group->getRows();
+    return group->get(backRow, col);
   }
-  void store(size_t col, Val val) override { return group.set(ctx.cycle, col, val); }
-  ExecContext& ctx;
-  TraceGroup& group;
+  void store(size_t col, Val val) {
+    if (global) {
+      global->set(col, val);
+    } else {
+      group->set(cycle, col, val);
+    }
+  }
+
+  size_t cycle;
+  TraceGroup* group = nullptr;
+  GlobalTraceGroup* global = nullptr;
 };
 
-using MutableBuf = MutableBufObj*;
+#else
+
+// A trace group as seen from the current cycle.  Every buffer has this one
+// concrete type, so the generated step code calls load and store directly
+// (and the compiler can inline them) instead of through a virtual per buffer
+// kind.  The current row is located once per step, and earlier rows are found
+// from it without a modulo.  The checks are the same as TraceGroup::get/set.
+struct BufferObj {
+  BufferObj(ExecContext& ctx, TraceGroup& group)
+      : rows(group.getRows())
+      , cols(group.getCols())
+      , cycle(ctx.cycle)
+      , cur(group.getBuffer() + ctx.cycle * group.getCols())
+      , unsafeReads(group.isUnsafe()) {}
+  // Global buffers are a single row, which every cycle sees
+  BufferObj(ExecContext& ctx, GlobalTraceGroup& group)
+      : rows(1)
+      , cols(group.getCols())
+      , cycle(0)
+      , cur(group.getBuffer())
+      , unsafeReads(group.isUnsafe()) {}
+
+  Val load(size_t col, size_t back) {
+    assert(back < rows);
+    const Val* row = back <= cycle ? cur - back * cols : cur + (rows - back) * cols;
+    Val val = row[col];
+    if (val == Val::invalid() && !unsafeReads) {
+      badLoad(col, back);
+    }
+    return val;
+  }
+  void store(size_t col, Val val) {
+    Val& elem = cur[col];
+    if (elem != Val::invalid() && elem != val) {
+      badStore(col, elem, val);
+    }
+    elem = val;
+  }
 
-struct GlobalBufObj : public BufferObj {
-  GlobalBufObj(ExecContext& ctx, GlobalTraceGroup& group) : ctx(ctx), group(group) {}
-  Val load(size_t col, size_t back) override {
-    assert(back == 0);
-    return group.get(col);
+  [[noreturn]] void badLoad(size_t col, size_t back) {
+    std::cerr << "Invalid trace get: row = " << (rows + cycle - back) % rows << ", col = " << col
+              << "\n";
+    throw std::runtime_error("Read of unset value");
+  }
+  [[noreturn]] void badStore(size_t col, Val cur, Val val) {
+    std::cerr << "Invalid trace set: row = " << cycle << ", col = " << col << "\n";
+    std::cerr << "Current = " << cur.asUInt32() << ", new = " << val.asUInt32() << "\n";
+    throw std::runtime_error("Inconsistant set");
   }
-  void store(size_t col, Val val) override { return group.set(col, val); }
-  ExecContext& ctx;
-  GlobalTraceGroup& group;
+
+  size_t rows;
+  size_t cols;
+  size_t cycle;
+  // The start of the current row
+  Val* cur;
+  bool unsafeReads;
 };
 
-using GlobalBuf = GlobalBufObj*;
+#endif
+
+using MutableBuf = BufferObj*;
+using GlobalBuf = BufferObj*;
 
 template <typename T> struct BoundLayout {
   BoundLayout(const T& layout, BufferObj* buf) : layout(&layout), buf(buf) {}
@@ -225,17 +291,28 @@ std::array<Val, 5> extern_getMemoryTxn(ExecContext& ctx, Val addr) {
   return {txn.prevCycle, txn.prevVal & 0xffff, txn.prevVal >> 16, txn.val & 0xffff, txn.val >> 16};
 }
 
+// The generated code passes the table as a template argument when it's a
+// constant (see --codegen-specialize-extern), which it always is in this
+// circuit, so each lookup goes straight to its table.
+template <uint32_t table> void extern_lookupDelta(ExecContext& ctx, Val index, Val count) {
+  ctx.tables.lookupDelta<table>(index, count);
+}
+
+template <uint32_t table> Val extern_lookupCurrent(ExecContext& ctx, Val index) {
+  return ctx.tables.lookupCurrent<table>(index);
+}
+
 void extern_lookupDelta(ExecContext& ctx, Val table, Val index, Val count) {
-  ctx.stepHandler.lookupDelta(table, index, count);
+  ctx.tables.lookupDelta(table, index, count);
 }
 
 Val extern_lookupCurrent(ExecContext& ctx, Val table, Val index) {
-  return ctx.stepHandler.lookupCurrent(table, index);
+  return ctx.tables.lookupCurrent(table, index);
 }
 
 void extern_memoryDelta(
     ExecContext& ctx, Val addr, Val cycle, Val dataLow, Val dataHigh, Val count) {
-  ctx.stepHandler.memoryDelta(
+  ctx.tables.memoryDelta(
       addr.asUInt32(), cycle.asUInt32(), dataLow.asUInt32() | (dataHigh.asUInt32() << 16), count);
 }
 
@@ -343,18 +420,18 @@ size_t getPoseidonStateCol() {
 
 void DslStep(StepHandler& stepHandler, ExecutionTrace& trace, size_t cycle) {
   impl::ExecContext ctx(stepHandler, trace, cycle);
-  impl::MutableBufObj data(ctx, trace.data);
-  impl::GlobalBufObj global(ctx, trace.global);
+  impl::BufferObj data(ctx, trace.data);
+  impl::BufferObj global(ctx, trace.global);
   step_Top(ctx, &data, &global);
 }
 
 void DslStepAccum(StepHandler& stepHandler, ExecutionTrace& trace, size_t cycle) {
   impl::ExecContext ctx(stepHandler, trace, cycle);
-  impl::MutableBufObj data(ctx, trace.data);
-  impl::MutableBufObj accum(ctx, trace.accum);
+  impl::BufferObj data(ctx, trace.data);
+  impl::BufferObj accum(ctx, trace.accum);
   // Global is required when using user-accum
-  // impl::GlobalBufObj global(ctx, trace.global);
-  impl::GlobalBufObj mix(ctx, trace.mix);
+  // impl::BufferObj global(ctx, trace.global);
+  impl::BufferObj mix(ctx, trace.mix);
   step_TopAccum(ctx, &accum, &data, /*&global, */ &mix);
 }
 
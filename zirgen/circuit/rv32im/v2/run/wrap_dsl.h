@@ -17,6 +17,7 @@
 #include "risc0/core/util.h"
 #include "zirgen/circuit/rv32im/v2/emu/preflight.h"
 #include "zirgen/circuit/rv32im/v2/emu/trace.h"
+#include "zirgen/circuit/rv32im/v2/run/lookup_tables.h"
 
 namespace zirgen::rv32im_v2 {
 
@@ -27,9 +28,9 @@ struct StepHandler {
   virtual std::vector<uint8_t> readBytes(uint32_t count) = 0;
   virtual uint32_t write(uint32_t fd, uint32_t addr, uint32_t size) = 0;
   virtual std::vector<uint32_t> nextPagingIdx() = 0;
-  virtual void lookupDelta(risc0::Fp table, risc0::Fp index, risc0::Fp count) = 0;
-  virtual risc0::Fp lookupCurrent(risc0::Fp table, risc0::Fp index) = 0;
-  virtual void memoryDelta(uint32_t cycle, uint32_t addr, uint32_t data, risc0::Fp count) = 0;
+  // Lookup arguments are accumulated here directly rather than through a
+  // virtual call for each one.
+  virtual LookupTables& getLookupTables() = 0;
   virtual uint32_t getDiffCount(uint32_t cycle) = 0;
 };
 
@@ -0,0 +1,104 @@
+// Copyright 2024 RISC Zero, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Runs the test guest and writes a digest of each segment's trace, so that the
+// traces from two builds of the witness generator can be compared.  Preflight
+// picks random values for each segment, so the first run saves its preflight
+// traces and the second loads them.
+
+#include <fstream>
+#include <iostream>
+
+#include "zirgen/circuit/rv32im/v2/run/run.h"
+#include "zirgen/compiler/zkp/poseidon2.h"
+
+using namespace zirgen::rv32im_v2;
+
+namespace {
+
+const std::string kernelName = "zirgen/circuit/rv32im/v2/kernel/kernel";
+const std::string progName = "zirgen/circuit/rv32im/v2/emu/test/guest";
+
+constexpr size_t kThreshold = 16000;
+constexpr size_t kSegmentSize = 16384;
+
+zirgen::Digest hashCols(Fp* buf, size_t count) {
+  std::vector<uint32_t> words(count);
+  for (size_t i = 0; i < count; i++) {
+    words[i] = buf[i].asRaw();
+  }
+  return zirgen::poseidon2Hash(words.data(), words.size());
+}
+
+void savePreflight(const std::string& path, const PreflightTrace& trace) {
+  std::vector<uint8_t> buf = serializePreflight(trace);
+  std::ofstream file(path, std::ios::binary);
+  file.write(reinterpret_cast<const char*>(buf.data()), buf.size());
+  if (!file) {
+    throw std::runtime_error("Unable to write " + path);
+  }
+}
+
+PreflightTrace loadPreflight(const std::string& path) {
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file) {
+    throw std::runtime_error("Unable to read " + path);
+  }
+  size_t size = file.tellg();
+  file.seekg(0);
+  // PreflightTraceView needs a 4 byte aligned buffer
+  std::vector<uint32_t> buf((size + 3) / 4);
+  file.read(reinterpret_cast<char*>(buf.data()), size);
+  return PreflightTraceView(reinterpret_cast<const uint8_t*>(buf.data()), size).toTrace();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc != 4 || (std::string(argv[1]) != "save" && std::string(argv[1]) != "load")) {
+    std::cerr << "usage: " << argv[0] << " save|load <preflight dir> <output>\n";
+    return 1;
+  }
+  bool save = std::string(argv[1]) == "save";
+  std::string dir = argv[2];
+
+  TestIoHandler io;
+  io.push_u32(0, 100);
+  auto image = MemoryImage::fromElfs(kernelName, progName);
+  auto segments = execute(image, io, kThreshold, 10000000);
+
+  std::ofstream out(argv[3]);
+  for (size_t i = 0; i < segments.size(); i++) {
+    std::string path = dir + "/segment" + std::to_string(i) + ".bin";
+    PreflightTrace preflight;
+    if (save) {
+      preflight = preflightSegment(segments[i], kSegmentSize);
+      savePreflight(path, preflight);
+    } else {
+      preflight = loadPreflight(path);
+    }
+    ExecutionTrace trace = runSegment(segments[i], preflight);
+    size_t rows = trace.data.getRows();
+    out << "segment " << i << "\n";
+    out << "  data: " << hashCols(trace.data.getBuffer(), rows * trace.data.getCols()) << "\n";
+    out << "  global: " << hashCols(trace.global.getBuffer(), trace.global.getCols()) << "\n";
+    out << "  accum: " << hashCols(trace.accum.getBuffer(), rows * trace.accum.getCols())
+        << "\n";
+  }
+  if (!out) {
+    std::cerr << "Unable to write " << argv[3] << "\n";
+    return 1;
+  }
+  return 0;
+}
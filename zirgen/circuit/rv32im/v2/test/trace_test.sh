@@ -0,0 +1,16 @@
+#!/bin/sh
+
+# Usage: trace_test.sh <trace_dump> <trace_dump_checked>
+set -e
+
+mkdir -p "$TEST_TMPDIR/preflight"
+"$1" save "$TEST_TMPDIR/preflight" "$TEST_TMPDIR/trace.txt" >/dev/null
+"$2" load "$TEST_TMPDIR/preflight" "$TEST_TMPDIR/trace_checked.txt" >/dev/null
+
+if diff -u "$TEST_TMPDIR/trace_checked.txt" "$TEST_TMPDIR/trace.txt"
+then
+    exit 0
+fi
+
+echo "The witness step's direct trace access produced a different trace than the checked accessors."
+exit 1
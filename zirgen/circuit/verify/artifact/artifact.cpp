@@ -0,0 +1,238 @@
+// Copyright 2024 RISC Zero, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "zirgen/circuit/verify/artifact/artifact.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace zirgen::verify::artifact {
+
+using risc0::Fp;
+using risc0::FpExt;
+
+namespace {
+
+struct MixState {
+  FpExt tot;
+  FpExt mul;
+};
+
+void check(bool cond, const char* what) {
+  if (!cond) {
+    throw std::runtime_error(std::string("Invalid circuit artifact: ") + what);
+  }
+}
+
+} // namespace
+
+std::unique_ptr<CircuitArtifact> CircuitArtifact::open(const std::string& path) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Unable to open circuit artifact: " + path);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    ::close(fd);
+    throw std::runtime_error("Unable to read circuit artifact: " + path);
+  }
+  size_t size = st.st_size;
+  void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (mapping == MAP_FAILED) {
+    throw std::runtime_error("Unable to map circuit artifact: " + path);
+  }
+  std::unique_ptr<CircuitArtifact> artifact(
+      new CircuitArtifact(static_cast<const uint8_t*>(mapping), size, mapping));
+  artifact->validate();
+  return artifact;
+}
+
+std::unique_ptr<CircuitArtifact> CircuitArtifact::fromBuffer(const void* data, size_t size) {
+  std::unique_ptr<CircuitArtifact> artifact(
+      new CircuitArtifact(static_cast<const uint8_t*>(data), size, nullptr));
+  artifact->validate();
+  return artifact;
+}
+
+CircuitArtifact::CircuitArtifact(const uint8_t* data, size_t size, void* mapping)
+    : data(data), size(size), mapping(mapping), header(reinterpret_cast<const Header*>(data)) {}
+
+CircuitArtifact::~CircuitArtifact() {
+  if (mapping) {
+    munmap(mapping, size);
+  }
+}
+
+ProtocolInfo CircuitArtifact::getProtocolInfo() const {
+  ProtocolInfo info = {};
+  memcpy(info.data(), header->protocolInfo, PROTOCOL_INFO_LEN);
+  return info;
+}
+
+void CircuitArtifact::validate() {
+  check(reinterpret_cast<uintptr_t>(data) % alignof(Header) == 0, "misaligned");
+  check(size >= sizeof(Header), "truncated header");
+  check(header->magic == kMagic, "bad magic");
+  check(header->version == kVersion, "unsupported version");
+  check(header->size == size, "size mismatch");
+
+  auto checkSection = [&](const Section& sec, size_t entrySize, const char* what) {
+    check(sec.offset % 4 == 0 && sec.offset >= sizeof(Header) && sec.offset <= size &&
+              sec.count <= (size - sec.offset) / entrySize,
+          what);
+  };
+  checkSection(header->groups, sizeof(Group), "groups out of bounds");
+  checkSection(header->regs, sizeof(Reg), "regs out of bounds");
+  checkSection(header->combos, sizeof(Combo), "combos out of bounds");
+  checkSection(header->backs, sizeof(uint32_t), "backs out of bounds");
+  checkSection(header->consts, sizeof(Const), "consts out of bounds");
+  checkSection(header->insts, sizeof(Inst), "insts out of bounds");
+
+  auto checkBacks = [&](uint32_t first, uint32_t count) {
+    check(first <= header->backs.count && count <= header->backs.count - first,
+          "backs index out of bounds");
+  };
+  for (const Group& group : section<Group>(header->groups)) {
+    check(group.firstReg <= header->regs.count &&
+              group.regCount <= header->regs.count - group.firstReg,
+          "reg index out of bounds");
+    for (const Reg& reg : getRegs(group)) {
+      check(reg.combo < header->combos.count, "combo index out of bounds");
+      checkBacks(reg.firstBack, reg.backCount);
+      check(reg.tapPos <= header->tapCount && reg.backCount <= header->tapCount - reg.tapPos,
+            "tap index out of bounds");
+    }
+  }
+  for (const Combo& combo : getCombos()) {
+    checkBacks(combo.firstBack, combo.backCount);
+  }
+  for (const Const& value : section<Const>(header->consts)) {
+    for (uint32_t elem : value.elems) {
+      check(elem < Fp::P, "constant out of range");
+    }
+  }
+
+  // Values may only be used after they're defined.
+  uint32_t fps = 0, mixStates = 0;
+  for (const Inst& inst : getInsts()) {
+    switch (inst.op) {
+    case Opcode::Const:
+      check(inst.a < header->consts.count, "constant index out of bounds");
+      fps++;
+      break;
+    case Opcode::Get:
+      check(inst.a < header->tapCount, "tap index out of bounds");
+      fps++;
+      break;
+    case Opcode::GetGlobal:
+      check(inst.a == kGlobalOut || inst.a == kGlobalMix, "unknown global buffer");
+      check(inst.b < (inst.a == kGlobalOut ? header->outSize : header->mixSize),
+            "global offset out of bounds");
+      fps++;
+      break;
+    case Opcode::Add:
+    case Opcode::Sub:
+    case Opcode::Mul:
+      check(inst.a < fps && inst.b < fps, "use before definition");
+      fps++;
+      break;
+    case Opcode::Neg:
+    case Opcode::Pow:
+      check(inst.a < fps, "use before definition");
+      fps++;
+      break;
+    case Opcode::True:
+      mixStates++;
+      break;
+    case Opcode::AndEqz:
+      check(inst.a < mixStates && inst.b < fps, "use before definition");
+      mixStates++;
+      break;
+    case Opcode::AndCond:
+      check(inst.a < mixStates && inst.b < fps && inst.c < mixStates, "use before definition");
+      mixStates++;
+      break;
+    default:
+      check(false, "unknown opcode");
+    }
+  }
+  check(fps == header->fpCount && mixStates == header->mixStateCount, "value count mismatch");
+  check(header->ret < mixStates, "return value out of bounds");
+
+  for (const Const& value : section<Const>(header->consts)) {
+    consts.emplace_back(value.elems[0], value.elems[1], value.elems[2], value.elems[3]);
+  }
+}
+
+FpExt CircuitArtifact::computePoly(const FpExt* u,
+                                   const Fp* out,
+                                   const Fp* mix,
+                                   FpExt polyMix) const {
+  std::vector<FpExt> fp;
+  fp.reserve(header->fpCount);
+  std::vector<MixState> mixStates;
+  mixStates.reserve(header->mixStateCount);
+
+  for (const Inst& inst : getInsts()) {
+    switch (inst.op) {
+    case Opcode::Const:
+      fp.push_back(consts[inst.a]);
+      break;
+    case Opcode::Get:
+      fp.push_back(u[inst.a]);
+      break;
+    case Opcode::GetGlobal:
+      fp.push_back(FpExt((inst.a == kGlobalOut ? out : mix)[inst.b]));
+      break;
+    case Opcode::Add:
+      fp.push_back(fp[inst.a] + fp[inst.b]);
+      break;
+    case Opcode::Sub:
+      fp.push_back(fp[inst.a] - fp[inst.b]);
+      break;
+    case Opcode::Mul:
+      fp.push_back(fp[inst.a] * fp[inst.b]);
+      break;
+    case Opcode::Neg:
+      fp.push_back(-fp[inst.a]);
+      break;
+    case Opcode::Pow:
+      fp.push_back(pow(fp[inst.a], inst.b));
+      break;
+    case Opcode::True:
+      mixStates.push_back({FpExt(0), FpExt(1)});
+      break;
+    case Opcode::AndEqz: {
+      const MixState& in = mixStates[inst.a];
+      mixStates.push_back({in.tot + in.mul * fp[inst.b], in.mul * polyMix});
+      break;
+    }
+    case Opcode::AndCond: {
+      const MixState& in = mixStates[inst.a];
+      const MixState& inner = mixStates[inst.c];
+      mixStates.push_back({in.tot + fp[inst.b] * inner.tot * in.mul, in.mul * inner.mul});
+      break;
+    }
+    }
+  }
+  return mixStates[header->ret].tot;
+}
+
+} // namespace zirgen::verify::artifact
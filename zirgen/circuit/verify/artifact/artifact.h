@@ -0,0 +1,195 @@
+// Copyright 2024 RISC Zero, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+/// \file
+/// A compact binary form of everything a verifier needs to know about a
+/// zirgen circuit: its taps, the sizes of its global buffers, its protocol
+/// info, and its validity polynomial as a flat list of instructions.  Unlike
+/// validity.ir, loading one of these needs neither MLIR nor LLVM; the file is
+/// mapped into memory, checked once, and then evaluated in place.
+///
+/// The file is a Header followed by the sections it describes.  Everything is
+/// a little endian uint32_t, so the sections can be used directly from the
+/// mapping.  Instructions produce values into one of two register files,
+/// numbered in order of definition as in risc0_zkp's PolyExtStep: the
+/// arithmetic instructions produce field elements, and True, AndEqz and
+/// AndCond produce mix states.
+
+#include "risc0/fp/fpext.h"
+#include "zirgen/compiler/codegen/protocol_info_const.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace zirgen::verify::artifact {
+
+// "ZCA1" in a little endian file
+constexpr uint32_t kMagic = 0x3141435a;
+// Bumped on any change to the layout or the meaning of an instruction
+constexpr uint32_t kVersion = 1;
+
+enum class Opcode : uint32_t {
+  Const,     // fp = consts[a]
+  Get,       // fp = u[a], where a is the index of the tap
+  GetGlobal, // fp = (a == kGlobalOut ? out : mix)[b]
+  Add,       // fp = fp[a] + fp[b]
+  Sub,       // fp = fp[a] - fp[b]
+  Mul,       // fp = fp[a] * fp[b]
+  Neg,       // fp = -fp[a]
+  Pow,       // fp = fp[a] ^ b
+  True,      // mix = {0, 1}
+  AndEqz,    // mix = mix[a] && fp[b] == 0
+  AndCond,   // mix = mix[a] && (fp[b] == 0 || mix[c])
+};
+
+constexpr uint32_t kGlobalOut = 0;
+constexpr uint32_t kGlobalMix = 1;
+
+struct Section {
+  // Byte offset from the start of the file; a multiple of 4
+  uint32_t offset;
+  // Number of entries
+  uint32_t count;
+};
+
+struct Header {
+  uint32_t magic;
+  uint32_t version;
+  // Size of the whole file in bytes
+  uint32_t size;
+  char protocolInfo[PROTOCOL_INFO_LEN];
+  uint32_t outSize;
+  uint32_t mixSize;
+  uint32_t tapCount;
+  // Number of field elements and mix states produced by insts
+  uint32_t fpCount;
+  uint32_t mixStateCount;
+  // The mix state holding the value of the validity polynomial
+  uint32_t ret;
+  Section groups; // Group
+  Section regs;   // Reg
+  Section combos; // Combo
+  Section backs;  // uint32_t, referenced by regs and combos
+  Section consts; // Const
+  Section insts;  // Inst
+};
+
+struct Group {
+  uint32_t firstReg;
+  uint32_t regCount;
+};
+
+struct Reg {
+  uint32_t offset;
+  uint32_t combo;
+  uint32_t tapPos;
+  uint32_t firstBack;
+  uint32_t backCount;
+};
+
+struct Combo {
+  uint32_t combo;
+  uint32_t firstBack;
+  uint32_t backCount;
+};
+
+// An extension field constant, with each element in canonical form
+struct Const {
+  uint32_t elems[4];
+};
+
+struct Inst {
+  Opcode op;
+  uint32_t a;
+  uint32_t b;
+  uint32_t c;
+};
+
+template <typename T> class Span {
+public:
+  Span(const T* data, size_t count) : ptr(data), count(count) {}
+
+  const T* begin() const { return ptr; }
+  const T* end() const { return ptr + count; }
+  size_t size() const { return count; }
+  const T& operator[](size_t idx) const { return ptr[idx]; }
+
+private:
+  const T* ptr;
+  size_t count;
+};
+
+/// A loaded circuit artifact.  Construction checks that the whole file is
+/// well formed, including that every instruction only refers to values
+/// defined before it, so evaluation does no further checking.
+class CircuitArtifact {
+public:
+  // Maps the artifact at `path` into memory.
+  static std::unique_ptr<CircuitArtifact> open(const std::string& path);
+  // Uses an artifact which is already in memory, and must outlive the result.
+  static std::unique_ptr<CircuitArtifact> fromBuffer(const void* data, size_t size);
+
+  ~CircuitArtifact();
+  CircuitArtifact(const CircuitArtifact&) = delete;
+  CircuitArtifact& operator=(const CircuitArtifact&) = delete;
+
+  ProtocolInfo getProtocolInfo() const;
+  size_t getOutSize() const { return header->outSize; }
+  size_t getMixSize() const { return header->mixSize; }
+  size_t getTapCount() const { return header->tapCount; }
+
+  Span<Group> getGroups() const { return section<Group>(header->groups); }
+  Span<Reg> getRegs(const Group& group) const {
+    return Span<Reg>(section<Reg>(header->regs).begin() + group.firstReg, group.regCount);
+  }
+  Span<Combo> getCombos() const { return section<Combo>(header->combos); }
+  Span<uint32_t> getBacks(const Reg& reg) const { return backs(reg.firstBack, reg.backCount); }
+  Span<uint32_t> getBacks(const Combo& combo) const {
+    return backs(combo.firstBack, combo.backCount);
+  }
+  Span<Inst> getInsts() const { return section<Inst>(header->insts); }
+
+  // Evaluates the validity polynomial given the value of each tap, the
+  // global buffers, and the mix for combining constraints.
+  risc0::FpExt computePoly(const risc0::FpExt* u,
+                           const risc0::Fp* out,
+                           const risc0::Fp* mix,
+                           risc0::FpExt polyMix) const;
+
+private:
+  CircuitArtifact(const uint8_t* data, size_t size, void* mapping);
+
+  void validate();
+
+  template <typename T> Span<T> section(const Section& sec) const {
+    return Span<T>(reinterpret_cast<const T*>(data + sec.offset), sec.count);
+  }
+  Span<uint32_t> backs(uint32_t first, uint32_t count) const {
+    return Span<uint32_t>(section<uint32_t>(header->backs).begin() + first, count);
+  }
+
+  const uint8_t* data;
+  size_t size;
+  // Non-null if we own a mapping of the file
+  void* mapping;
+  const Header* header;
+  std::vector<risc0::FpExt> consts;
+};
+
+} // namespace zirgen::verify::artifact
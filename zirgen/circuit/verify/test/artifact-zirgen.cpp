@@ -0,0 +1,111 @@
+// Copyright 2024 RISC Zero, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <random>
+
+#include "zirgen/Dialect/ZHLT/IR/ZHLT.h"
+#include "zirgen/circuit/verify/artifact/artifact.h"
+#include "zirgen/circuit/verify/wrap_zirgen.h"
+#include "zirgen/compiler/zkp/baby_bear.h"
+
+using namespace zirgen;
+using namespace zirgen::verify;
+using namespace zirgen::Zll;
+
+// The artifact emitted alongside validity.ir must evaluate to the same
+// polynomial as the IR itself, which is what poly_ext is generated from.
+TEST(artifact_zirgen, calculator) {
+  auto artifact = artifact::CircuitArtifact::open("zirgen/dsl/examples/calculator/validity.zca");
+
+  Module module;
+  module.getCtx()->getOrLoadDialect<Zhlt::ZhltDialect>();
+  auto circuit =
+      getInterfaceZirgen(module.getCtx(), "zirgen/dsl/examples/calculator/validity.ir");
+
+  size_t tapCount = circuit->get_taps().tapCount;
+  size_t outSize = circuit->out_size();
+  size_t mixSize = circuit->mix_size();
+  ASSERT_EQ(artifact->getTapCount(), tapCount);
+  ASSERT_EQ(artifact->getOutSize(), outSize);
+  ASSERT_EQ(artifact->getMixSize(), mixSize);
+  EXPECT_EQ(std::string(artifact->getProtocolInfo().data()),
+            std::string(circuit->get_circuit_info().data()));
+
+  // Evaluate the IR with the taps followed by the poly mix in one buffer, and
+  // the globals followed by the mix in another.
+  module.addFunc<3>("poly",
+                    {cbuf(tapCount + 1, kBabyBearExtSize),
+                     cbuf(outSize + mixSize),
+                     mbuf(1, kBabyBearExtSize)},
+                    [&](Buffer ext, Buffer globals, Buffer result) {
+                      std::vector<Val> u, out, mix;
+                      for (size_t i = 0; i < tapCount; i++) {
+                        u.push_back(ext[i]);
+                      }
+                      for (size_t i = 0; i < outSize; i++) {
+                        out.push_back(globals[i]);
+                      }
+                      for (size_t i = 0; i < mixSize; i++) {
+                        mix.push_back(globals[outSize + i]);
+                      }
+                      result[0] = circuit->compute_poly(u, out, mix, ext[tapCount]);
+                    });
+  module.optimize();
+
+  std::mt19937 rng(2);
+  std::uniform_int_distribution<uint32_t> dist(0, risc0::Fp::P - 1);
+  auto randomExt = [&]() {
+    return risc0::FpExt(dist(rng), dist(rng), dist(rng), dist(rng));
+  };
+  auto toPoly = [](risc0::FpExt val) {
+    Interpreter::Polynomial poly;
+    for (size_t i = 0; i < kBabyBearExtSize; i++) {
+      poly.push_back(val.elems[i].asUInt32());
+    }
+    return poly;
+  };
+
+  for (size_t iter = 0; iter < 20; iter++) {
+    std::vector<risc0::FpExt> u(tapCount);
+    std::vector<risc0::Fp> globals(outSize + mixSize);
+    for (auto& val : u) {
+      val = randomExt();
+    }
+    for (auto& val : globals) {
+      val = dist(rng);
+    }
+    risc0::FpExt polyMix = randomExt();
+
+    Interpreter::Buffer extBuf;
+    for (const auto& val : u) {
+      extBuf.push_back(toPoly(val));
+    }
+    extBuf.push_back(toPoly(polyMix));
+    Interpreter::Buffer globalsBuf;
+    for (const auto& val : globals) {
+      globalsBuf.push_back({val.asUInt32()});
+    }
+    Interpreter::Buffer resultBuf(1, Interpreter::Polynomial(kBabyBearExtSize, kFieldInvalid));
+    module.runFunc("poly", {extBuf, globalsBuf, resultBuf});
+
+    risc0::FpExt expected;
+    for (size_t i = 0; i < kBabyBearExtSize; i++) {
+      expected.elems[i] = resultBuf[0][i];
+    }
+    EXPECT_EQ(artifact->computePoly(u.data(), globals.data(), globals.data() + outSize, polyMix),
+              expected);
+  }
+}
@@ -0,0 +1,113 @@
+// Copyright 2024 RISC Zero, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+
+#include "zirgen/circuit/verify/artifact/artifact.h"
+
+using namespace zirgen::verify::artifact;
+using risc0::Fp;
+using risc0::FpExt;
+
+namespace {
+
+// Lays out an artifact by hand, as emitCircuitArtifact would.
+std::vector<uint32_t> buildArtifact(const std::vector<Inst>& insts) {
+  Header header = {};
+  header.magic = kMagic;
+  header.version = kVersion;
+  memcpy(header.protocolInfo, "TEST:rev1v1_____", sizeof(header.protocolInfo));
+  header.outSize = 1;
+  header.mixSize = 0;
+  header.tapCount = 1;
+
+  Group group = {0, 1};
+  Reg reg = {/*offset=*/0, /*combo=*/0, /*tapPos=*/0, /*firstBack=*/0, /*backCount=*/1};
+  Combo combo = {0, 0, 1};
+  uint32_t back = 0;
+  Const three = {{3, 0, 0, 0}};
+
+  std::vector<uint8_t> body;
+  auto add = [&](Section& sec, const void* entries, size_t size, size_t count) {
+    sec.offset = sizeof(Header) + body.size();
+    sec.count = count;
+    auto* bytes = static_cast<const uint8_t*>(entries);
+    body.insert(body.end(), bytes, bytes + size * count);
+  };
+  add(header.groups, &group, sizeof(group), 1);
+  add(header.regs, &reg, sizeof(reg), 1);
+  add(header.combos, &combo, sizeof(combo), 1);
+  add(header.backs, &back, sizeof(back), 1);
+  add(header.consts, &three, sizeof(three), 1);
+  add(header.insts, insts.data(), sizeof(Inst), insts.size());
+  for (const Inst& inst : insts) {
+    bool isMix = inst.op == Opcode::True || inst.op == Opcode::AndEqz || inst.op == Opcode::AndCond;
+    (isMix ? header.mixStateCount : header.fpCount)++;
+  }
+  header.ret = header.mixStateCount - 1;
+  header.size = sizeof(Header) + body.size();
+
+  std::vector<uint32_t> words(header.size / 4);
+  memcpy(words.data(), &header, sizeof(header));
+  memcpy(reinterpret_cast<uint8_t*>(words.data()) + sizeof(header), body.data(), body.size());
+  return words;
+}
+
+// (u * 3 - out) == 0 && (out == 0 || u == 0)
+const std::vector<Inst> kInsts = {
+    {Opcode::Get, 0, 0, 0},       // fp0 = u[0]
+    {Opcode::GetGlobal, 0, 0, 0}, // fp1 = out[0]
+    {Opcode::Const, 0, 0, 0},     // fp2 = 3
+    {Opcode::Mul, 0, 2, 0},       // fp3
+    {Opcode::Sub, 3, 1, 0},       // fp4
+    {Opcode::True, 0, 0, 0},      // mix0
+    {Opcode::AndEqz, 0, 4, 0},    // mix1
+    {Opcode::True, 0, 0, 0},      // mix2
+    {Opcode::AndEqz, 2, 0, 0},    // mix3
+    {Opcode::AndCond, 1, 1, 3},   // mix4
+};
+
+} // namespace
+
+TEST(artifact, evaluate) {
+  auto words = buildArtifact(kInsts);
+  auto artifact = CircuitArtifact::fromBuffer(words.data(), words.size() * 4);
+
+  EXPECT_EQ(artifact->getOutSize(), 1);
+  EXPECT_EQ(artifact->getTapCount(), 1);
+  EXPECT_EQ(std::string(artifact->getProtocolInfo().data()), "TEST:rev1v1_____");
+  ASSERT_EQ(artifact->getGroups().size(), 1);
+  ASSERT_EQ(artifact->getRegs(artifact->getGroups()[0]).size(), 1);
+  EXPECT_EQ(artifact->getBacks(artifact->getCombos()[0]).size(), 1);
+
+  FpExt u(Fp(5), Fp(7), Fp(0), Fp(1));
+  Fp out(9);
+  FpExt polyMix(Fp(2), Fp(3), Fp(4), Fp(5));
+  FpExt eqz = u * Fp(3) - FpExt(out);
+  FpExt expected = eqz + FpExt(out) * (u * polyMix);
+  EXPECT_EQ(artifact->computePoly(&u, &out, nullptr, polyMix), expected);
+}
+
+TEST(artifact, rejectsUseBeforeDef) {
+  auto insts = kInsts;
+  insts[3].b = 3;
+  auto words = buildArtifact(insts);
+  EXPECT_THROW(CircuitArtifact::fromBuffer(words.data(), words.size() * 4), std::runtime_error);
+
+  words = buildArtifact(kInsts);
+  words[1]++;
+  EXPECT_THROW(CircuitArtifact::fromBuffer(words.data(), words.size() * 4), std::runtime_error);
+}
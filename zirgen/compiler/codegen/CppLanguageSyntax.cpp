@@ -56,14 +56,15 @@ void emitRawFuncDeclaration(CodegenEmitter& cg,
                             CodegenIdent<IdentKind::Func> funcName,
                             llvm::ArrayRef<std::string> contextArgDecls,
                             llvm::ArrayRef<CodegenIdent<IdentKind::Var>> argNames,
-                            mlir::FunctionType funcType) {
+                            mlir::FunctionType funcType,
+                            llvm::StringRef tupleNamespace) {
   auto returnTypes = funcType.getResults();
   if (returnTypes.size() == 0) {
     cg << "void";
   } else if (returnTypes.size() == 1) {
     cg << cg.getTypeName(returnTypes[0]);
   } else {
-    cg << "std::tuple<";
+    cg << EmitPart(tupleNamespace) << "::tuple<";
     cg.interleaveComma(returnTypes, [&](auto ty) { cg << cg.getTypeName(ty); });
     cg << ">";
   }
@@ -96,7 +97,8 @@ void CppLanguageSyntax::emitFuncDeclaration(CodegenEmitter& cg,
                                             llvm::ArrayRef<CodegenIdent<IdentKind::Var>> argNames,
                                             mlir::FunctionType funcType) {
   cg << "extern ";
-  emitRawFuncDeclaration(cg, funcName, contextArgDecls, argNames, funcType);
+  emitRawFuncDeclaration(
+      cg, funcName, contextArgDecls, argNames, funcType, getTupleNamespace());
   cg << ";\n";
 }
 
@@ -106,7 +108,8 @@ void CppLanguageSyntax::emitFuncDefinition(CodegenEmitter& cg,
                                            llvm::ArrayRef<CodegenIdent<IdentKind::Var>> argNames,
                                            mlir::FunctionType funcType,
                                            mlir::Region* body) {
-  emitRawFuncDeclaration(cg, funcName, contextArgDecls, argNames, funcType);
+  emitRawFuncDeclaration(
+      cg, funcName, contextArgDecls, argNames, funcType, getTupleNamespace());
   cg << " {\n";
   cg.emitRegion(*body);
   cg << "}\n";
@@ -116,7 +119,7 @@ void CppLanguageSyntax::emitReturn(CodegenEmitter& cg, llvm::ArrayRef<CodegenVal
 
   cg << "return ";
   if (values.size() > 1) {
-    cg << "std::make_tuple(";
+    cg << EmitPart(getTupleNamespace()) << "::make_tuple(";
   }
   cg.interleaveComma(values);
   if (values.size() > 1) {
@@ -145,6 +148,12 @@ void CppLanguageSyntax::emitSaveResults(CodegenEmitter& cg,
   }
 }
 
+void CppLanguageSyntax::emitAssignResult(CodegenEmitter& cg,
+                                         CodegenIdent<IdentKind::Var> name,
+                                         EmitPart emitExpression) {
+  cg << name << " = " << emitExpression << ";\n";
+}
+
 void CppLanguageSyntax::emitConstDecl(CodegenEmitter& cg,
                                       CodegenIdent<IdentKind::Const> name,
                                       Type ty) {
@@ -363,7 +372,8 @@ void CudaLanguageSyntax::emitFuncDeclaration(CodegenEmitter& cg,
                                              llvm::ArrayRef<CodegenIdent<IdentKind::Var>> argNames,
                                              mlir::FunctionType funcType) {
   cg << "extern __device__ ";
-  emitRawFuncDeclaration(cg, funcName, contextArgDecls, argNames, funcType);
+  emitRawFuncDeclaration(
+      cg, funcName, contextArgDecls, argNames, funcType, getTupleNamespace());
   cg << ";\n";
 }
 
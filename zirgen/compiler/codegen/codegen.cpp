@@ -27,6 +27,18 @@
 using namespace mlir;
 namespace cl = llvm::cl;
 
+static cl::opt<bool>
+    reuseVarSlots("codegen-reuse-var-slots",
+                  cl::desc("In generated C++, reuse the variables of values which are no longer "
+                           "live instead of declaring a new variable for every value"),
+                  cl::init(false));
+
+static cl::list<std::string>
+    specializeExterns("codegen-specialize-extern",
+                      cl::desc("In generated C++, pass a constant first argument of these "
+                               "externs as a template argument"),
+                      cl::CommaSeparated);
+
 namespace zirgen {
 namespace codegen {
 
@@ -84,6 +96,8 @@ CodegenOptions getCppCodegenOpts() {
   addCppSyntax(opts);
   ZStruct::addCppSyntax(opts);
   Zhlt::addCppSyntax(opts);
+  opts.reuseVarSlots = reuseVarSlots;
+  opts.specializedExterns.insert(specializeExterns.begin(), specializeExterns.end());
   return opts;
 }
 
@@ -94,6 +108,8 @@ CodegenOptions getCudaCodegenOpts() {
   addCppSyntax(opts);
   ZStruct::addCppSyntax(opts);
   Zhlt::addCppSyntax(opts);
+  opts.reuseVarSlots = reuseVarSlots;
+  opts.specializedExterns.insert(specializeExterns.begin(), specializeExterns.end());
   return opts;
 }
 
@@ -131,6 +147,8 @@ void optimizePoly(ModuleOp module, const EmitCodeOptions& opts) {
   opm.addPass(Zll::createMakePolynomialPass());
   opm.addPass(createCanonicalizerPass());
   opm.addPass(createCSEPass());
+  opm.addPass(Zll::createOptimizePolynomialPass());
+  opm.addPass(createCSEPass());
   opm.addPass(Zll::createComputeTapsPass());
   if (failed(pm.run(module))) {
     throw std::runtime_error("Failed to apply stage1 passes");
@@ -158,6 +176,11 @@ public:
     op->print(*ofs.get());
   }
 
+  void emitArtifact(const std::string& fn, func::FuncOp func) {
+    auto ofs = openOutputFile(fn + ".zca");
+    emitCircuitArtifact(*ofs, func);
+  }
+
   void emitRustStep(const std::string& stage, func::FuncOp func) {
     auto ofs = openOutputFile("rust_step_" + stage + ".cpp");
     createRustStreamEmitter(*ofs)->emitStepFunc(stage, func);
@@ -329,6 +352,7 @@ void emitCodeZirgenPoly(ModuleOp module, StringRef outputDir) {
   emitter.emitIR("validity", module);
 
   module.walk([&](func::FuncOp func) {
+    emitter.emitArtifact("validity", func);
     emitter.emitPolyExtFunc(func);
     emitter.emitTaps(func);
     emitter.emitInfo(func);
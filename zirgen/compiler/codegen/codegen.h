@@ -201,6 +201,9 @@ struct CppLanguageSyntax : public LanguageSyntax {
                        llvm::ArrayRef<CodegenIdent<IdentKind::Var>> names,
                        llvm::ArrayRef<mlir::Type> types,
                        EmitPart emitExpression) override;
+  void emitAssignResult(CodegenEmitter& cg,
+                        CodegenIdent<IdentKind::Var> name,
+                        EmitPart emitExpression) override;
 
   void emitSaveConst(CodegenEmitter& cg,
                      CodegenIdent<IdentKind::Const> name,
@@ -248,6 +251,10 @@ struct CppLanguageSyntax : public LanguageSyntax {
                      llvm::ArrayRef<CodegenIdent<IdentKind::Field>> fields,
                      llvm::ArrayRef<mlir::Type> types) override;
 
+protected:
+  // Namespace providing the tuple used to return multiple values.
+  virtual llvm::StringRef getTupleNamespace() { return "std"; }
+
 private:
   void emitStructDefImpl(CodegenEmitter& cg,
                          mlir::Type ty,
@@ -279,6 +286,11 @@ struct CudaLanguageSyntax : public CppLanguageSyntax {
                            llvm::ArrayRef<std::string> contextArgs,
                            llvm::ArrayRef<CodegenIdent<IdentKind::Var>> argNames,
                            mlir::FunctionType funcType) override;
+
+protected:
+  // Host std:: types aren't usable in device code; libcu++ also provides
+  // structured bindings for its tuple.
+  llvm::StringRef getTupleNamespace() override { return "::cuda::std"; }
 };
 
 // Returns codegen options for emitting specific language variants,
@@ -296,6 +308,9 @@ std::unique_ptr<CppStreamEmitter> createCppStreamEmitter(llvm::raw_ostream& ofs)
 
 void emitCode(mlir::ModuleOp module, const EmitCodeOptions& opts = {});
 void emitCodeZirgenPoly(mlir::ModuleOp module, llvm::StringRef outputDir);
+// Writes the taps, global buffer sizes, protocol info, and validity polynomial
+// of `func` in the format read by verify::artifact::CircuitArtifact.
+void emitCircuitArtifact(llvm::raw_ostream& os, mlir::func::FuncOp func);
 void emitRecursion(const std::string& path,
                    mlir::func::FuncOp func,
                    recursion::EncodeStats* stats = nullptr);
@@ -29,12 +29,34 @@ FpExt {{fn}}(size_t cycle, size_t steps, FpExt* poly_mix{{args}});
 {{/decls}}
 
 {{#funcs}}
+{{#prologue}}
+struct {{fn}}_invariants {
+{{#fields}}
+  {{.}};
+{{/fields}}
+};
+
+{{fn}}_invariants {{fn}}_prologue({{params}}) {
+{{#body}}
+  {{.}}
+{{/body}}
+}
+
+{{/prologue}}
 FpExt {{fn}}(size_t cycle, size_t steps, FpExt* poly_mix{{args}}) {
-  size_t mask = steps - 1;
 {{#body}}
   {{.}}
 {{/body}}
 }
+{{#rows}}
+
+// Evaluates rows [begin, end) into out
+void {{fn}}_rows(size_t begin, size_t end, size_t steps, FpExt* poly_mix, Fp** args, FpExt* out) {
+{{#body}}
+  {{.}}
+{{/body}}
+}
+{{/rows}}
 {{/funcs}}
 
 } // namespace risc0::circuit::{{name}}
@@ -0,0 +1,235 @@
+// Copyright 2024 RISC Zero, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "zirgen/compiler/codegen/codegen.h"
+
+#include <array>
+#include <cstring>
+#include <map>
+
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "llvm/ADT/TypeSwitch.h"
+
+#include "zirgen/Dialect/ZHLT/IR/ZHLT.h"
+#include "zirgen/Dialect/Zll/Analysis/TapsAnalysis.h"
+#include "zirgen/Dialect/Zll/IR/IR.h"
+#include "zirgen/circuit/verify/artifact/artifact.h"
+
+using namespace mlir;
+using namespace zirgen::Zll;
+
+namespace zirgen {
+
+namespace artifact = verify::artifact;
+
+namespace {
+
+class ArtifactWriter {
+public:
+  ArtifactWriter(func::FuncOp func) : func(func) {}
+
+  void write(llvm::raw_ostream& os);
+
+private:
+  void addGlobals();
+  void addTaps();
+  void addInsts();
+
+  uint32_t getConst(ConstOp op);
+  uint32_t useFp(Value value) const { return lookup(fpVals, value); }
+  uint32_t useMix(Value value) const { return lookup(mixVals, value); }
+  void defFp(Value value, artifact::Opcode op, uint32_t a = 0, uint32_t b = 0) {
+    uint32_t id = fpVals.size();
+    fpVals[value] = id;
+    insts.push_back({op, a, b, 0});
+  }
+  void defMix(Value value, artifact::Opcode op, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0) {
+    uint32_t id = mixVals.size();
+    mixVals[value] = id;
+    insts.push_back({op, a, b, c});
+  }
+
+  static uint32_t lookup(const DenseMap<Value, uint32_t>& vals, Value value) {
+    auto it = vals.find(value);
+    if (it == vals.end()) {
+      llvm::errs() << "Missing use: " << value << "\n";
+      throw std::runtime_error("Missing use");
+    }
+    return it->second;
+  }
+
+  func::FuncOp func;
+  artifact::Header header = {};
+
+  std::vector<artifact::Group> groups;
+  std::vector<artifact::Reg> regs;
+  std::vector<artifact::Combo> combos;
+  std::vector<uint32_t> backs;
+  std::vector<artifact::Const> consts;
+  std::vector<artifact::Inst> insts;
+
+  DenseMap<Value, uint32_t> globalBufs;
+  DenseMap<Value, uint32_t> fpVals;
+  DenseMap<Value, uint32_t> mixVals;
+  std::map<std::array<uint32_t, 4>, uint32_t> constIndex;
+};
+
+void ArtifactWriter::addGlobals() {
+  auto bufs = lookupModuleAttr<BuffersAttr>(func);
+  if (auto out = bufs.getBuffer("global"))
+    header.outSize = out.getRegCount();
+  if (auto mix = bufs.getBuffer("mix"))
+    header.mixSize = mix.getRegCount();
+
+  for (auto [argNum, arg] : llvm::enumerate(func.getArguments())) {
+    auto name = func.getArgAttrOfType<StringAttr>(argNum, "zirgen.argName");
+    if (!name)
+      continue;
+
+    auto buf = bufs.getBuffer(name);
+    if (!buf || !buf.isGlobal())
+      continue;
+
+    if (buf.getName() == "global") {
+      globalBufs[arg] = artifact::kGlobalOut;
+    } else if (buf.getName() == "mix") {
+      globalBufs[arg] = artifact::kGlobalMix;
+    } else {
+      throw std::runtime_error("Unknown buffer: " + buf.getName().str());
+    }
+  }
+}
+
+void ArtifactWriter::addTaps() {
+  TapsAnalysis tapsAnalysis(func);
+  const auto& tapSet = tapsAnalysis.getTapSet();
+  header.tapCount = tapSet.tapCount;
+
+  for (const auto& group : tapSet.groups) {
+    groups.push_back({uint32_t(regs.size()), uint32_t(group.regs.size())});
+    for (const auto& reg : group.regs) {
+      regs.push_back(
+          {reg.offset, reg.combo, reg.tapPos, uint32_t(backs.size()), uint32_t(reg.backs.size())});
+      backs.insert(backs.end(), reg.backs.begin(), reg.backs.end());
+    }
+  }
+  for (const auto& combo : tapSet.combos) {
+    combos.push_back({combo.combo, uint32_t(backs.size()), uint32_t(combo.backs.size())});
+    backs.insert(backs.end(), combo.backs.begin(), combo.backs.end());
+  }
+}
+
+uint32_t ArtifactWriter::getConst(ConstOp op) {
+  auto attr = op->getAttrOfType<PolynomialAttr>("coefficients");
+  std::array<uint32_t, 4> elems = {0, 0, 0, 0};
+  if (attr.size() > 4)
+    throw std::runtime_error("Constant has too many coefficients");
+  for (ssize_t i = 0; i < attr.size(); i++) {
+    elems[i] = attr[i];
+  }
+  auto [it, inserted] = constIndex.emplace(elems, consts.size());
+  if (inserted)
+    consts.push_back({{elems[0], elems[1], elems[2], elems[3]}});
+  return it->second;
+}
+
+void ArtifactWriter::addInsts() {
+  using artifact::Opcode;
+  for (Operation& origOp : func.front()) {
+    TypeSwitch<Operation*>(&origOp)
+        .Case<ConstOp>([&](ConstOp op) { defFp(op.getOut(), Opcode::Const, getConst(op)); })
+        .Case<GetOp>([&](GetOp op) {
+          auto tap = op->getAttrOfType<IntegerAttr>("tap");
+          if (!tap) {
+            llvm::errs() << op << "\n";
+            throw std::runtime_error("Missing tap");
+          }
+          defFp(op.getOut(), Opcode::Get, tap.getUInt());
+        })
+        .Case<GetGlobalOp>([&](GetGlobalOp op) {
+          defFp(op.getOut(), Opcode::GetGlobal, lookup(globalBufs, op.getBuf()), op.getOffset());
+        })
+        .Case<AddOp>([&](AddOp op) {
+          defFp(op.getOut(), Opcode::Add, useFp(op.getLhs()), useFp(op.getRhs()));
+        })
+        .Case<SubOp>([&](SubOp op) {
+          defFp(op.getOut(), Opcode::Sub, useFp(op.getLhs()), useFp(op.getRhs()));
+        })
+        .Case<MulOp>([&](MulOp op) {
+          defFp(op.getOut(), Opcode::Mul, useFp(op.getLhs()), useFp(op.getRhs()));
+        })
+        .Case<NegOp>([&](NegOp op) { defFp(op.getOut(), Opcode::Neg, useFp(op.getIn())); })
+        .Case<PowOp>([&](PowOp op) {
+          defFp(op.getOut(), Opcode::Pow, useFp(op.getIn()), op.getExponent());
+        })
+        .Case<TrueOp>([&](TrueOp op) { defMix(op.getOut(), Opcode::True); })
+        .Case<AndEqzOp>([&](AndEqzOp op) {
+          defMix(op.getOut(), Opcode::AndEqz, useMix(op.getIn()), useFp(op.getVal()));
+        })
+        .Case<AndCondOp>([&](AndCondOp op) {
+          defMix(op.getOut(),
+                 Opcode::AndCond,
+                 useMix(op.getIn()),
+                 useFp(op.getCond()),
+                 useMix(op.getInner()));
+        })
+        .Case<func::ReturnOp, Zhlt::ReturnOp>(
+            [&](auto op) { header.ret = useMix(op->getOperand(0)); })
+        .Default([&](Operation* op) {
+          if (!op->use_empty()) {
+            llvm::errs() << "Don't know how to write " << *op << " to a circuit artifact\n";
+            throw std::runtime_error("Unsupported operation in validity polynomial");
+          }
+        });
+  }
+  header.fpCount = fpVals.size();
+  header.mixStateCount = mixVals.size();
+}
+
+void ArtifactWriter::write(llvm::raw_ostream& os) {
+  header.magic = artifact::kMagic;
+  header.version = artifact::kVersion;
+  ProtocolInfo info = lookupModuleAttr<ProtocolInfoAttr>(func).getValue();
+  memcpy(header.protocolInfo, info.data(), PROTOCOL_INFO_LEN);
+
+  addGlobals();
+  addTaps();
+  addInsts();
+
+  std::string body;
+  auto addSection = [&](artifact::Section& sec, const auto& entries) {
+    sec.offset = sizeof(artifact::Header) + body.size();
+    sec.count = entries.size();
+    body.append(reinterpret_cast<const char*>(entries.data()),
+                entries.size() * sizeof(entries[0]));
+  };
+  addSection(header.groups, groups);
+  addSection(header.regs, regs);
+  addSection(header.combos, combos);
+  addSection(header.backs, backs);
+  addSection(header.consts, consts);
+  addSection(header.insts, insts);
+  header.size = sizeof(artifact::Header) + body.size();
+
+  os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  os << body;
+}
+
+} // namespace
+
+void emitCircuitArtifact(llvm::raw_ostream& os, func::FuncOp func) {
+  ArtifactWriter(func).write(os);
+}
+
+} // namespace zirgen
@@ -16,6 +16,7 @@
 
 #include <filesystem>
 #include <fstream>
+#include <set>
 
 #include "mlir/Support/DebugStringHelper.h"
 #include "mustache.h"
@@ -153,7 +154,7 @@ public:
       if ((curSplitIndex++ % splitCount) != splitIndex)
         continue;
 
-      list lines;
+      list lines = emitTapRows(calledFunc.front());
       for (Operation& op : calledFunc.front().without_terminator()) {
         LLVM_DEBUG(llvm::dbgs() << "emitPolyFunc: " << op << "\n");
         emitOperation(&op, ctx, lines, /*depth=*/0, "Fp", FuncKind::PolyFp, &mixPows);
@@ -180,15 +181,91 @@ public:
     funcProtos.push_back(object{{"args", ", Fp** args"}, {"fn", fn}});
 
     if ((curSplitIndex++ % splitCount) == splitIndex) {
-      list lines;
-      for (Operation& op : func.front().without_terminator()) {
-        LLVM_DEBUG(llvm::dbgs() << "emitPolyFunc: " << op << "\n");
-        emitOperation(&op, ctx, lines, /*depth=*/0, "Fp", FuncKind::PolyFp, &mixPows);
+      Block& block = func.front();
+      Value retVal = block.getTerminator()->getOperand(0);
+      llvm::DenseSet<Operation*> hoisted = findRowInvariants(block);
+      if (hoisted.empty()) {
+        list lines = emitTapRows(block);
+        for (Operation& op : block.without_terminator()) {
+          LLVM_DEBUG(llvm::dbgs() << "emitPolyFunc: " << op << "\n");
+          emitOperation(&op, ctx, lines, /*depth=*/0, "Fp", FuncKind::PolyFp, &mixPows);
+        }
+        lines.push_back(llvm::formatv("return {0};", ctx.use(retVal)).str());
+        list rows{"for (size_t cycle = begin; cycle < end; cycle++) {",
+                  llvm::formatv("  out[cycle - begin] = {0}(cycle, steps, poly_mix, args);", fn)
+                      .str(),
+                  "}"};
+        funcs.push_back(object{{"args", ", Fp** args"},
+                               {"fn", fn},
+                               {"body", lines},
+                               {"rows", object{{"fn", fn}, {"body", rows}}}});
+      } else {
+        // Split into a prologue computing the row invariant values once, and a
+        // kernel evaluated on every row which reads them from a struct
+        auto isHoisted = [&](Operation* op) { return hoisted.contains(op); };
+        llvm::DenseSet<Operation*> prologueOps = hoisted;
+        for (Operation* op : hoisted) {
+          for (Value operand : op->getOperands()) {
+            prologueOps.insert(operand.getDefiningOp());
+          }
+        }
+        list prologueLines;
+        for (Operation& op : block.without_terminator()) {
+          if (prologueOps.contains(&op)) {
+            emitOperation(&op, ctx, prologueLines, /*depth=*/0, "Fp", FuncKind::PolyFp, &mixPows);
+          }
+        }
+        list fields;
+        std::string fieldNames;
+        for (Operation& op : block.without_terminator()) {
+          if (!hoisted.contains(&op) || llvm::all_of(op.getUsers(), isHoisted))
+            continue;
+          Value value = op.getResult(0);
+          auto valType = llvm::cast<ValType>(value.getType());
+          std::string name = ctx.use(value);
+          fields.push_back((valType.getFieldK() > 1 ? "FpExt " : "Fp ") + name);
+          fieldNames += (fieldNames.empty() ? "" : ", ") + name;
+          ctx.vars[value] = "inv." + name;
+        }
+        prologueLines.push_back(
+            llvm::formatv("return {0}_invariants{{{1}};", fn, fieldNames).str());
+
+        list lines = emitTapRows(block);
+        for (Operation& op : block.without_terminator()) {
+          bool onlyInPrologue = prologueOps.contains(&op) && llvm::all_of(op.getUsers(), isHoisted);
+          if (!hoisted.contains(&op) && !onlyInPrologue) {
+            LLVM_DEBUG(llvm::dbgs() << "emitPolyFunc: " << op << "\n");
+            emitOperation(&op, ctx, lines, /*depth=*/0, "Fp", FuncKind::PolyFp, &mixPows);
+          }
+        }
+        lines.push_back(llvm::formatv("return {0};", ctx.use(retVal)).str());
+        // Only taps depend on the row, so the prologue needs just the buffers
+        object prologue{
+            {"params", "Fp** args"}, {"fn", fn}, {"fields", fields}, {"body", prologueLines}};
+        funcs.push_back(object{
+            {"args", llvm::formatv(", Fp** args, const {0}_invariants& inv", fn).str()},
+            {"fn", fn + "_row"},
+            {"prologue", prologue},
+            {"body", lines}});
+
+        // Keep the original entry point for callers evaluating a single row;
+        // callers evaluating many rows use the _rows entry point, which runs
+        // the prologue once for the whole range
+        list wrapper{
+            llvm::formatv("return {0}_row(cycle, steps, poly_mix, args, {0}_prologue(args));", fn)
+                .str()};
+        list rows{llvm::formatv("auto inv = {0}_prologue(args);", fn).str(),
+                  "for (size_t cycle = begin; cycle < end; cycle++) {",
+                  llvm::formatv("  out[cycle - begin] = {0}_row(cycle, steps, poly_mix, "
+                                "args, inv);",
+                                fn)
+                      .str(),
+                  "}"};
+        funcs.push_back(object{{"args", ", Fp** args"},
+                               {"fn", fn},
+                               {"body", wrapper},
+                               {"rows", object{{"fn", fn}, {"body", rows}}}});
       }
-      Value retVal = func.front().getTerminator()->getOperand(0);
-      lines.push_back(llvm::formatv("return {0};", ctx.use(retVal)).str());
-
-      funcs.push_back(object{{"args", ", Fp** args"}, {"fn", fn}, {"body", lines}});
     }
 
     tmpl.render(object{{"decls", funcProtos}, {"funcs", funcs}, {"name", func.getName().str()}},
@@ -196,6 +273,41 @@ public:
   }
 
 private:
+  // Returns the arithmetic in `block` whose value is the same on every row,
+  // because it only depends on constants and globals.
+  llvm::DenseSet<Operation*> findRowInvariants(Block& block) {
+    llvm::DenseSet<Operation*> hoisted;
+    auto isInvariant = [&](Value value) {
+      Operation* def = value.getDefiningOp();
+      return def && (isa<ConstOp, GetGlobalOp>(def) || hoisted.contains(def));
+    };
+    for (Operation& op : block.without_terminator()) {
+      if (isa<AddOp, SubOp, MulOp, NegOp, InvOp, IsZeroOp>(op) &&
+          llvm::all_of(op.getOperands(), isInvariant)) {
+        hoisted.insert(&op);
+      }
+    }
+    return hoisted;
+  }
+
+  // Returns declarations of the row index for each distance back read by a
+  // GetOp in `block`, so that each tap read is a single indexed load.
+  list emitTapRows(Block& block) {
+    std::set<uint32_t> backs;
+    for (GetOp op : block.getOps<GetOp>()) {
+      backs.insert(op.getBack());
+    }
+    list lines;
+    if (!backs.empty()) {
+      lines.push_back("size_t mask = steps - 1;");
+    }
+    for (uint32_t back : backs) {
+      lines.push_back(
+          llvm::formatv("size_t back{0} = (cycle - kInvRate * {0}) & mask;", back).str());
+    }
+    return lines;
+  }
+
   void emitStepBlock(Block& block, FileContext& ctx, list& lines, size_t depth, bool isRecursion) {
     std::string indent(depth * 2, ' ');
     for (Operation& op : block.without_terminator()) {
@@ -357,7 +469,7 @@ private:
           } else {
             lines.push_back(
                 indent +
-                llvm::formatv("auto {0} = {1}[{2} * steps + ((cycle - kInvRate * {3}) & mask)];",
+                llvm::formatv("auto {0} = {1}[{2} * steps + back{3}];",
                               out,
                               ctx.use(op->getOperand(0)),
                               emitIntAttr(op, "offset"),
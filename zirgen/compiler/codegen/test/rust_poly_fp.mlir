@@ -20,16 +20,19 @@ func.func @fib(
   ]
 } {
   // CHECK: size_t mask = steps - 1;
+  // CHECK-NEXT: size_t back0 = (cycle - kInvRate * 0) & mask;
+  // CHECK-NEXT: size_t back1 = (cycle - kInvRate * 1) & mask;
+  // CHECK-NEXT: size_t back2 = (cycle - kInvRate * 2) & mask;
   // CHECK: Fp x0(1);
   %0 = zll.const 1 {deg = 0 : ui32}
 
   // CHECK: FpExt x1 = FpExt(0);
   %1 = zll.true {deg = 0 : ui32}
 
-  // CHECK: auto x2 = args[0][0 * steps + ((cycle - kInvRate * 0) & mask)];
+  // CHECK: auto x2 = args[0][0 * steps + back0];
   %2 = zll.get %arg0[0] back 0 tap 1 : <3, constant> {deg = 1 : ui32}
 
-  // CHECK: auto x3 = args[2][0 * steps + ((cycle - kInvRate * 0) & mask)];
+  // CHECK: auto x3 = args[2][0 * steps + back0];
   %3 = zll.get %arg2[0] back 0 tap 4 : <1, mutable> {deg = 1 : ui32}
 
   // CHECK: auto x4 = x3 - x0;
@@ -41,13 +44,13 @@ func.func @fib(
   // CHECK: FpExt x6 = x1 + x2 * x5 * poly_mix[0];
   %6 = zll.and_cond %1, %2 : <BabyBear>, %5 {deg = 2 : ui32}
 
-  // CHECK: auto x7 = args[0][1 * steps + ((cycle - kInvRate * 0) & mask)];
+  // CHECK: auto x7 = args[0][1 * steps + back0];
   %7 = zll.get %arg0[1] back 0 tap 2 : <3, constant> {deg = 1 : ui32}
 
-  // CHECK: auto x8 = args[2][0 * steps + ((cycle - kInvRate * 1) & mask)];
+  // CHECK: auto x8 = args[2][0 * steps + back1];
   %8 = zll.get %arg2[0] back 1 tap 5 : <1, mutable> {deg = 1 : ui32}
 
-  // CHECK: auto x9 = args[2][0 * steps + ((cycle - kInvRate * 2) & mask)];
+  // CHECK: auto x9 = args[2][0 * steps + back2];
   %9 = zll.get %arg2[0] back 2 tap 6 : <1, mutable> {deg = 1 : ui32}
 
   // CHECK: auto x10 = x8 + x9;
@@ -62,7 +65,7 @@ func.func @fib(
   // CHECK: FpExt x13 = x6 + x7 * x12 * poly_mix[1];
   %13 = zll.and_cond %6, %7 : <BabyBear>, %12 {deg = 2 : ui32}
 
-  // CHECK: auto x14 = args[0][2 * steps + ((cycle - kInvRate * 0) & mask)];
+  // CHECK: auto x14 = args[0][2 * steps + back0];
   %14 = zll.get %arg0[2] back 0 tap 3 : <3, constant> {deg = 1 : ui32}
 
   // CHECK: auto x15 = args[1][0];
@@ -83,7 +86,7 @@ func.func @fib(
   // CHECK: auto x20 = x19 + x14;
   %20 = zll.add %19 : <BabyBear>, %14 : <BabyBear> {deg = 1 : ui32}
 
-  // CHECK: auto x21 = args[4][0 * steps + ((cycle - kInvRate * 0) & mask)];
+  // CHECK: auto x21 = args[4][0 * steps + back0];
   %21 = zll.get %arg4[0] back 0 tap 0 : <1, mutable> {deg = 1 : ui32}
 
   // CHECK: auto x22 = x21 - x0;
@@ -96,5 +99,9 @@ func.func @fib(
   %24 = zll.and_cond %18, %20 : <BabyBear>, %23 {deg = 2 : ui32}
 
   // CHECK: return x24;
+  // CHECK-LABEL: void poly_fp_rows(size_t begin, size_t end, size_t steps, FpExt* poly_mix, Fp** args, FpExt* out) {
+  // CHECK-NEXT: for (size_t cycle = begin; cycle < end; cycle++) {
+  // CHECK-NEXT: out[cycle - begin] = poly_fp(cycle, steps, poly_mix, args);
+  // CHECK-NEXT: }
   return {deg = 2 : ui32} %24 : !zll.constraint
 }
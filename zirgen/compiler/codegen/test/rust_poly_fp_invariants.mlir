@@ -0,0 +1,45 @@
+// RUN: zirgen-translate -zirgen-to-rust-poly-fp --function=fib --stage=exec %s | FileCheck %s
+
+// Arithmetic on globals is the same on every row, so it moves to the prologue.
+
+// CHECK-LABEL: struct poly_fp_invariants {
+// CHECK-NEXT: Fp x2;
+// CHECK-NEXT: };
+// CHECK: poly_fp_invariants poly_fp_prologue(Fp** args) {
+// CHECK: auto x0 = args[1][0];
+// CHECK: auto x1 = args[1][1];
+// CHECK: auto x2 = x0 * x1;
+// CHECK: return poly_fp_invariants{x2};
+// CHECK-LABEL: FpExt poly_fp_row(size_t cycle, size_t steps, FpExt* poly_mix, Fp** args, const poly_fp_invariants& inv) {
+// CHECK-NEXT: size_t mask = steps - 1;
+// CHECK-NEXT: size_t back0 = (cycle - kInvRate * 0) & mask;
+// CHECK: FpExt x3 = FpExt(0);
+// CHECK: auto x4 = args[0][0 * steps + back0];
+// CHECK: auto x5 = x4 - inv.x2;
+// CHECK: FpExt x6 = x3 + x5 * poly_mix[0];
+// CHECK: return x6;
+// CHECK-LABEL: FpExt poly_fp(size_t cycle, size_t steps, FpExt* poly_mix, Fp** args) {
+// CHECK-NEXT: return poly_fp_row(cycle, steps, poly_mix, args, poly_fp_prologue(args));
+// CHECK-LABEL: void poly_fp_rows(size_t begin, size_t end, size_t steps, FpExt* poly_mix, Fp** args, FpExt* out) {
+// CHECK-NEXT: auto inv = poly_fp_prologue(args);
+// CHECK-NEXT: for (size_t cycle = begin; cycle < end; cycle++) {
+// CHECK-NEXT: out[cycle - begin] = poly_fp_row(cycle, steps, poly_mix, args, inv);
+// CHECK-NEXT: }
+func.func @fib(
+  %arg0: !zll.buffer<1, mutable>,
+  %arg1: !zll.buffer<2, global>
+) -> !zll.constraint attributes {
+  deg = 1 : ui32,
+  taps = [
+    #zll.tap<0, 0, 0>
+  ]
+} {
+  %0 = zll.true {deg = 0 : ui32}
+  %1 = zll.get %arg0[0] back 0 tap 0 : <1, mutable> {deg = 1 : ui32}
+  %2 = zll.get_global %arg1[0] : <2, global> {deg = 0 : ui32}
+  %3 = zll.get_global %arg1[1] : <2, global> {deg = 0 : ui32}
+  %4 = zll.mul %2 : <BabyBear>, %3 : <BabyBear> {deg = 0 : ui32}
+  %5 = zll.sub %1 : <BabyBear>, %4 : <BabyBear> {deg = 1 : ui32}
+  %6 = zll.and_eqz %0, %5 : <BabyBear> {deg = 1 : ui32}
+  return {deg = 1 : ui32} %6 : !zll.constraint
+}
@@ -267,7 +267,8 @@ private:
     // The null value in valuesToSignals corresponds to the pre-declared output
     // of the component. Unify those signals with those of the return value.
     AnySignal outputSignal = valuesToSignals.at(Value());
-    AnySignal returnSignal = valuesToSignals.at(ret.getValue());
+    Value retVal = ret.getValues().empty() ? Value() : ret.getValues()[0];
+    AnySignal returnSignal = valuesToSignals.at(retVal);
     for (auto [outs, rets] : llvm::zip(flatten(outputSignal), flatten(returnSignal))) {
       os << "(assert (= " << outs.str() << " " << rets.str() << "))\n";
     }
@@ -15,6 +15,7 @@
 #include "zirgen/Dialect/BigInt/IR/BigInt.h"
 #include "zirgen/Dialect/BigInt/Transforms/Passes.h"
 #include "zirgen/Dialect/ZHLT/IR/ZHLT.h"
+#include "zirgen/Dialect/ZHLT/Transforms/Passes.h"
 #include "zirgen/Dialect/ZStruct/IR/ZStruct.h"
 #include "zirgen/Dialect/ZStruct/Transforms/Passes.h"
 #include "zirgen/Dialect/Zll/Conversion/ZStructToZll/Passes.h"
@@ -38,6 +39,7 @@ int main(int argc, char** argv) {
   zirgen::Zll::registerPasses();
   zirgen::ZStructToZll::registerPasses();
   zirgen::ZStruct::registerPasses();
+  zirgen::Zhlt::registerPasses();
   zirgen::dsl::registerPasses();
   registry.insert<mlir::func::FuncDialect>();
   registry.insert<BigInt::BigIntDialect>();
@@ -17,9 +17,190 @@
 #include "llvm/include/llvm/ADT/StringExtras.h"
 
 #include "zirgen/components/plonk.h"
+#include "risc0/core/parallel.h"
+
+#include <limits>
 
 namespace zirgen {
 
+namespace {
+
+// Below this many rows, a comparison sort beats the radix sort's fixed costs.
+constexpr size_t kRadixSortMinRows = 4096;
+// Rows handled by each block of the parallel radix sort.
+constexpr size_t kRadixBlockRows = 16 * 1024;
+// Extension field elements handled by each block of the parallel prefix product.
+constexpr size_t kScanBlockElems = 16 * 1024;
+
+// Sorts `perm`, a permutation of row indices, by one 8-bit digit of one column
+// of the rows.  Stable, so that successive passes from the least significant
+// digit to the most significant sort the rows lexicographically.
+void radixPass(const uint64_t* data,
+               size_t width,
+               size_t col,
+               size_t shift,
+               const std::vector<uint32_t>& perm,
+               std::vector<uint32_t>& out) {
+  size_t rows = perm.size();
+  size_t blocks = (rows + kRadixBlockRows - 1) / kRadixBlockRows;
+  auto digit = [&](uint32_t row) { return (data[row * width + col] >> shift) & 0xff; };
+
+  std::vector<std::array<size_t, 256>> counts(blocks);
+  risc0::parallelFor(0, blocks, [&](size_t block) {
+    auto& count = counts[block];
+    count.fill(0);
+    size_t end = std::min(rows, (block + 1) * kRadixBlockRows);
+    for (size_t i = block * kRadixBlockRows; i < end; i++) {
+      count[digit(perm[i])]++;
+    }
+  });
+
+  // Turn the counts into the output offset of each digit within each block.
+  size_t offset = 0;
+  for (size_t d = 0; d < 256; d++) {
+    for (size_t block = 0; block < blocks; block++) {
+      size_t count = counts[block][d];
+      counts[block][d] = offset;
+      offset += count;
+    }
+  }
+
+  risc0::parallelFor(0, blocks, [&](size_t block) {
+    auto& next = counts[block];
+    size_t end = std::min(rows, (block + 1) * kRadixBlockRows);
+    for (size_t i = block * kRadixBlockRows; i < end; i++) {
+      out[next[digit(perm[i])]++] = perm[i];
+    }
+  });
+}
+
+} // namespace
+
+void PlonkRows::push(llvm::ArrayRef<uint64_t> row) {
+  if (empty()) {
+    data.clear();
+    head = 0;
+    width = row.size();
+  } else if (row.size() != width) {
+    throw std::runtime_error(llvm::formatv("Plonk row width mismatch: expected {0}, got {1}",
+                                           width,
+                                           row.size())
+                                 .str());
+  }
+  data.insert(data.end(), row.begin(), row.end());
+}
+
+llvm::ArrayRef<uint64_t> PlonkRows::front() const {
+  assert(!empty());
+  return llvm::ArrayRef(data).slice(head, width);
+}
+
+void PlonkRows::pop() {
+  assert(!empty());
+  head += width;
+  if (empty()) {
+    data.clear();
+    head = 0;
+  }
+}
+
+void PlonkRows::sort() {
+  size_t rows = size();
+  if (rows < 2) {
+    return;
+  }
+  if (rows > std::numeric_limits<uint32_t>::max()) {
+    throw std::runtime_error("Too many plonk rows to sort");
+  }
+  const uint64_t* base = data.data() + head;
+
+  std::vector<uint32_t> perm(rows);
+  for (size_t i = 0; i < rows; i++) {
+    perm[i] = i;
+  }
+
+  if (rows < kRadixSortMinRows) {
+    std::sort(perm.begin(), perm.end(), [&](uint32_t a, uint32_t b) {
+      return std::lexicographical_compare(
+          base + a * width, base + (a + 1) * width, base + b * width, base + (b + 1) * width);
+    });
+  } else {
+    // Find which bits vary within each column, so that passes over digits
+    // which are the same in every row can be skipped.
+    std::vector<uint64_t> varying(width);
+    std::mutex varyingLock;
+    risc0::parallelForBlocks(
+        1,
+        rows,
+        [&](size_t begin, size_t end) {
+          std::vector<uint64_t> local(width);
+          for (size_t row = begin; row < end; row++) {
+            for (size_t col = 0; col < width; col++) {
+              local[col] |= base[row * width + col] ^ base[col];
+            }
+          }
+          std::lock_guard<std::mutex> guard(varyingLock);
+          for (size_t col = 0; col < width; col++) {
+            varying[col] |= local[col];
+          }
+        },
+        kRadixBlockRows);
+
+    std::vector<uint32_t> scratch(rows);
+    for (size_t col = width; col-- > 0;) {
+      for (size_t shift = 0; shift < 64; shift += 8) {
+        if ((varying[col] >> shift) & 0xff) {
+          radixPass(base, width, col, shift, perm, scratch);
+          std::swap(perm, scratch);
+        }
+      }
+    }
+  }
+
+  std::vector<uint64_t> sorted(rows * width);
+  risc0::parallelFor(
+      0,
+      rows,
+      [&](size_t i) {
+        std::copy_n(base + size_t(perm[i]) * width, width, sorted.data() + i * width);
+      },
+      kRadixBlockRows);
+  data = std::move(sorted);
+  head = 0;
+}
+
+void PlonkRows::prefixProducts(const Zll::ExtensionField& f) {
+  assert((width % f.degree) == 0);
+  uint64_t* base = data.data() + head;
+  size_t elems = (data.size() - head) / f.degree;
+  size_t blocks = std::min(risc0::getParallelism(),
+                           std::max<size_t>(1, elems / kScanBlockElems));
+  auto blockBegin = [&](size_t block) { return elems * block / blocks; };
+  auto elem = [&](size_t i) { return llvm::ArrayRef<uint64_t>(base + i * f.degree, f.degree); };
+
+  // Each block's starting accumulator is the product of all preceding blocks.
+  std::vector<Zll::ExtensionField::FieldResult> carry(blocks, f.One());
+  if (blocks > 1) {
+    std::vector<Zll::ExtensionField::FieldResult> products(blocks, f.One());
+    risc0::parallelFor(0, blocks - 1, [&](size_t block) {
+      for (size_t i = blockBegin(block); i != blockBegin(block + 1); i++) {
+        products[block] = f.Mul(products[block], elem(i));
+      }
+    });
+    for (size_t block = 1; block < blocks; block++) {
+      carry[block] = f.Mul(carry[block - 1], products[block - 1]);
+    }
+  }
+
+  risc0::parallelFor(0, blocks, [&](size_t block) {
+    auto accum = carry[block];
+    for (size_t i = blockBegin(block); i != blockBegin(block + 1); i++) {
+      accum = f.Mul(accum, elem(i));
+      std::copy(accum.begin(), accum.end(), base + i * f.degree);
+    }
+  });
+}
+
 std::optional<std::vector<uint64_t>>
 PlonkExternHandler::doExtern(llvm::StringRef name,
                              llvm::StringRef extra,
@@ -27,55 +208,45 @@ PlonkExternHandler::doExtern(llvm::StringRef name,
                              size_t outCount) {
   if (name == "plonkWrite") {
     assert(outCount == 0);
-    plonkRows[extra.str()].emplace_back(asFpArray(args));
+    plonkRows[extra].push(asFpArray(args));
     return std::vector<uint64_t>{};
   }
   if (name == "plonkRead") {
-    assert(!plonkRows[extra.str()].empty());
-    std::vector<uint64_t> top = plonkRows[extra.str()].front();
+    PlonkRows& rows = plonkRows[extra];
+    assert(!rows.empty());
+    std::vector<uint64_t> top = rows.front();
     assert(top.size() == outCount);
-    plonkRows[extra.str()].pop_front();
+    rows.pop();
     return top;
   }
 
   if (name == "plonkWriteAccum") {
     assert(outCount == 0);
-    plonkAccumRows[extra.str()].emplace_back(asFpArray(args));
+    plonkAccumRows[extra].push(asFpArray(args));
     return std::vector<uint64_t>{};
   }
   if (name == "plonkReadAccum") {
-    assert(!plonkAccumRows[extra.str()].empty());
-    std::vector<uint64_t> top = plonkAccumRows[extra.str()].front();
+    PlonkRows& rows = plonkAccumRows[extra];
+    assert(!rows.empty());
+    std::vector<uint64_t> top = rows.front();
     assert(top.size() == outCount);
-    plonkAccumRows[extra.str()].pop_front();
+    rows.pop();
     return top;
   }
   return ExternHandler::doExtern(name, extra, args, outCount);
 }
 
 void PlonkExternHandler::sort(llvm::StringRef name) {
-  FpMat& mat = plonkRows.at(name.str());
-  std::sort(mat.begin(), mat.end());
+  auto it = plonkRows.find(name);
+  if (it == plonkRows.end()) {
+    throw std::out_of_range(("Unknown plonk table: " + name).str());
+  }
+  it->second.sort();
 }
 
 void PlonkExternHandler::calcPrefixProducts(Zll::ExtensionField f) {
   for (auto& kv : plonkAccumRows) {
-    FpMat& mat = kv.second;
-
-    auto accum = f.One();
-
-    std::vector<uint64_t> newRow;
-    for (auto& row : mat) {
-      assert((row.size() % f.degree) == 0);
-      newRow.clear();
-      for (size_t i = 0; i != row.size(); i += f.degree) {
-        auto val = llvm::ArrayRef(row).slice(i, f.degree);
-        accum = f.Mul(accum, val);
-        newRow.insert(newRow.end(), accum.begin(), accum.end());
-      }
-      assert(newRow.size() == row.size());
-      std::swap(newRow, row);
-    }
+    kv.second.prefixProducts(f);
   }
 }
 
@@ -17,8 +17,7 @@
 #include "zirgen/Dialect/Zll/IR/Interpreter.h"
 #include "zirgen/components/fpext.h"
 #include "zirgen/components/mux.h"
-
-#include <deque>
+#include "llvm/ADT/StringMap.h"
 
 namespace zirgen {
 
@@ -315,6 +314,30 @@ public:
 template <typename Element, typename Verifier, typename Header>
 using PlonkBody = Comp<PlonkBodyImpl<Element, Verifier, Header>>;
 
+// A queue of fixed width rows of field elements, stored contiguously.
+class PlonkRows {
+public:
+  void push(llvm::ArrayRef<uint64_t> row);
+  llvm::ArrayRef<uint64_t> front() const;
+  void pop();
+  bool empty() const { return head == data.size(); }
+  size_t size() const { return width ? (data.size() - head) / width : 0; }
+  size_t getWidth() const { return width; }
+
+  // Sorts the remaining rows lexicographically.
+  void sort();
+
+  // Replaces the remaining rows, taken as a flat sequence of extension field
+  // elements, with their running product.
+  void prefixProducts(const Zll::ExtensionField& f);
+
+private:
+  size_t width = 0;
+  // Offset of the first unread row in `data`
+  size_t head = 0;
+  std::vector<uint64_t> data;
+};
+
 class PlonkExternHandler : public Zll::ExternHandler {
 public:
   std::optional<std::vector<uint64_t>> doExtern(llvm::StringRef name,
@@ -325,10 +348,8 @@ public:
   void calcPrefixProducts(Zll::ExtensionField f);
 
 private:
-  using FpVec = std::vector<uint64_t>;
-  using FpMat = std::deque<FpVec>;
-  std::map<std::string, FpMat> plonkRows;
-  std::map<std::string, FpMat> plonkAccumRows;
+  llvm::StringMap<PlonkRows> plonkRows;
+  llvm::StringMap<PlonkRows> plonkAccumRows;
 };
 
 } // namespace zirgen
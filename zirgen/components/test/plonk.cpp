@@ -19,6 +19,7 @@
 
 #include <deque>
 #include <gtest/gtest.h>
+#include <random>
 
 using namespace zirgen::Zll;
 
@@ -258,4 +259,51 @@ TEST(Plonk, Basic) {
   }
 }
 
+// Large tables take the radix sort and blocked prefix product paths; check
+// they agree with a plain comparison sort and a sequential running product.
+TEST(Plonk, LargeTables) {
+  std::mt19937_64 rng(2);
+  for (size_t count : {100, 4096, 50000}) {
+    // Few distinct values in the first column so later columns break ties, a
+    // constant column whose digits are skipped, and a full width column.
+    PlonkRows rows;
+    std::vector<std::vector<uint64_t>> expected;
+    for (size_t i = 0; i < count; i++) {
+      std::vector<uint64_t> row = {rng() % 4, 7, rng() % 8, rng() % kFieldPrimeDefault};
+      rows.push(row);
+      expected.push_back(row);
+    }
+    rows.sort();
+    std::sort(expected.begin(), expected.end());
+    ASSERT_EQ(rows.size(), count);
+    for (const auto& row : expected) {
+      ASSERT_EQ(rows.front(), llvm::ArrayRef(row));
+      rows.pop();
+    }
+    EXPECT_TRUE(rows.empty());
+  }
+
+  ExtensionField f(kFieldPrimeDefault, kExtSize);
+  PlonkRows accum;
+  std::vector<std::vector<uint64_t>> accumRows;
+  for (size_t i = 0; i < 100000; i++) {
+    std::vector<uint64_t> row(2 * kExtSize);
+    for (auto& val : row) {
+      val = rng() % kFieldPrimeDefault;
+    }
+    accum.push(row);
+    accumRows.push_back(row);
+  }
+  accum.prefixProducts(f);
+  auto product = f.One();
+  for (const auto& row : accumRows) {
+    for (size_t i = 0; i < row.size(); i += kExtSize) {
+      product = f.Mul(product, llvm::ArrayRef(row).slice(i, kExtSize));
+      ASSERT_EQ(accum.front().slice(i, kExtSize), llvm::ArrayRef<uint64_t>(product));
+    }
+    accum.pop();
+  }
+  EXPECT_TRUE(accum.empty());
+}
+
 } // namespace zirgen
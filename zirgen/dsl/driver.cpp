@@ -66,6 +66,7 @@ enum Action {
   PrintRust,
   PrintCpp,
   PrintStats,
+  PrintCost,
   PrintPicus,
 };
 } // namespace
@@ -85,6 +86,7 @@ static cl::opt<enum Action> emitAction(
         clEnumValN(PrintRust, "rust", "Output generated rust code"),
         clEnumValN(PrintCpp, "cpp", "Output generated cpp code"),
         clEnumValN(PrintStats, "stats", "Display statistics on generated circuit"),
+        clEnumValN(PrintCost, "cost", "Estimate per-row evaluation cost as JSON"),
         clEnumValN(PrintPicus, "picus", "Output code for determinism verification with Picus")));
 
 static cl::list<std::string> includeDirs("I", cl::desc("Add include path"), cl::value_desc("path"));
@@ -144,17 +146,24 @@ int main(int argc, char* argv[]) {
     return 0;
   }
 
-  std::optional<mlir::ModuleOp> zhlModule = zirgen::dsl::lower(context, sourceManager, ast.get());
-  if (!zhlModule) {
-    return 1;
-  }
-
   if (emitAction == Action::PrintZHL) {
+    std::optional<mlir::ModuleOp> zhlModule = zirgen::dsl::lower(context, sourceManager, ast.get());
+    if (!zhlModule) {
+      return 1;
+    }
     zhlModule->print(llvm::outs());
     return 0;
   }
 
-  std::optional<mlir::ModuleOp> typedModule = zirgen::Typing::typeCheck(context, zhlModule.value());
+  std::optional<mlir::ModuleOp> typedModule =
+      zirgen::typeCheckCached(context, sourceManager, [&]() -> std::optional<mlir::ModuleOp> {
+        std::optional<mlir::ModuleOp> zhlModule =
+            zirgen::dsl::lower(context, sourceManager, ast.get());
+        if (!zhlModule) {
+          return std::nullopt;
+        }
+        return zirgen::Typing::typeCheck(context, zhlModule.value());
+      });
   if (!typedModule) {
     return 1;
   }
@@ -294,6 +303,11 @@ int main(int argc, char* argv[]) {
     return 1;
   }
 
+  if (emitAction == Action::PrintCost) {
+    zirgen::dsl::printCostModel(*typedModule, stepFuncs, llvm::outs());
+    return 0;
+  }
+
   if (emitAction == Action::PrintStepFuncs) {
     stepFuncs.print(llvm::outs());
     return 0;
@@ -18,8 +18,13 @@
 #include "zirgen/Dialect/ZStruct/Analysis/DegreeAnalysis.h"
 #include "zirgen/Dialect/Zll/Analysis/TapsAnalysis.h"
 #include "zirgen/Dialect/Zll/IR/IR.h"
+#include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/bit.h"
 #include "llvm/Support/Format.h"
 #include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MathExtras.h"
 
 using namespace mlir;
 
@@ -27,6 +32,63 @@ namespace zirgen::dsl {
 
 namespace {
 
+// Calls `fn` with each location an operation at `topLoc` is attributed to: the
+// location with its outermost callers stripped off, and each call site it was
+// inlined through.
+void forEachAttributedLoc(Location topLoc, llvm::function_ref<void(Location)> fn) {
+  Attribute walkLoc = topLoc;
+  while (auto scLoc = llvm::dyn_cast<CallSiteLoc>(walkLoc)) {
+    AttrTypeReplacer replacer;
+    replacer.addReplacement([&](LocationAttr attr) -> LocationAttr {
+      if (attr == scLoc.getCaller()) {
+        return UnknownLoc::get(scLoc.getContext());
+      } else {
+        return attr;
+      }
+    });
+    if (auto nameLoc = llvm::dyn_cast<NameLoc>(scLoc.getCallee())) {
+      replacer.addReplacement([&](LocationAttr attr) -> LocationAttr {
+        if (attr == nameLoc.getChildLoc()) {
+          return UnknownLoc::get(scLoc.getContext());
+        } else {
+          return attr;
+        }
+      });
+    }
+    auto replaced = replacer.replace(topLoc);
+    fn(llvm::cast<Location>(replaced));
+
+    walkLoc = scLoc.getCaller();
+    fn(CallSiteLoc::get(UnknownLoc::get(topLoc.getContext()), llvm::cast<Location>(walkLoc)));
+  }
+}
+
+void displayLoc(llvm::raw_ostream& os, Location loc) {
+  TypeSwitch<Location>(loc)
+      .Case<FileLineColLoc>([&](auto loc) {
+        StringRef fn = loc.getFilename();
+        fn.consume_front("../risczero-wip/");
+        fn.consume_front("zirgen/");
+        os << fn << ":" << loc.getLine() << ":" << loc.getColumn();
+      })
+      .Case<NameLoc>([&](auto loc) {
+        os << loc.getName().strref() << "(";
+        displayLoc(os, loc.getChildLoc());
+        os << ")";
+      })
+      .Case<UnknownLoc>([&](auto loc) { os << "*"; })
+      .Case<CallSiteLoc>([&](auto loc) {
+        os << "(";
+        displayLoc(os, loc.getCallee());
+        os << " at ";
+        displayLoc(os, loc.getCaller());
+        os << ")";
+      })
+      .Default([&](auto loc) {
+        os << "Unknown " << loc->getAbstractAttribute().getName() << ": " << loc;
+      });
+}
+
 struct StatsPrinter {
   StatsPrinter(ModuleOp moduleOp) : moduleOp(moduleOp) {}
 
@@ -93,33 +155,7 @@ struct StatsPrinter {
   void printDetailedConstraints(Zhlt::CheckFuncOp check, size_t totalConstraints) {
     DenseMap<Location, size_t> counts;
     check.walk([&](Zll::EqualZeroOp eqzOp) {
-      Location topLoc = eqzOp.getLoc();
-      Attribute walkLoc = topLoc;
-      while (auto scLoc = llvm::dyn_cast<CallSiteLoc>(walkLoc)) {
-        AttrTypeReplacer replacer;
-        replacer.addReplacement([&](LocationAttr attr) -> LocationAttr {
-          if (attr == scLoc.getCaller()) {
-            return UnknownLoc::get(scLoc.getContext());
-          } else {
-            return attr;
-          }
-        });
-        if (auto nameLoc = llvm::dyn_cast<NameLoc>(scLoc.getCallee())) {
-          replacer.addReplacement([&](LocationAttr attr) -> LocationAttr {
-            if (attr == nameLoc.getChildLoc()) {
-              return UnknownLoc::get(scLoc.getContext());
-            } else {
-              return attr;
-            }
-          });
-        }
-        auto replaced = replacer.replace(topLoc);
-        counts[llvm::cast<Location>(replaced)]++;
-
-        walkLoc = scLoc.getCaller();
-        counts[CallSiteLoc::get(UnknownLoc::get(eqzOp.getContext()),
-                                llvm::cast<Location>(walkLoc))]++;
-      }
+      forEachAttributedLoc(eqzOp.getLoc(), [&](Location loc) { counts[loc]++; });
     });
 
     auto countsVec = llvm::to_vector(counts);
@@ -135,32 +171,6 @@ struct StatsPrinter {
     }
   }
 
-  void displayLoc(llvm::raw_ostream& os, Location loc) {
-    TypeSwitch<Location>(loc)
-        .Case<FileLineColLoc>([&](auto loc) {
-          StringRef fn = loc.getFilename();
-          fn.consume_front("../risczero-wip/");
-          fn.consume_front("zirgen/");
-          os << fn << ":" << loc.getLine() << ":" << loc.getColumn();
-        })
-        .Case<NameLoc>([&](auto loc) {
-          os << loc.getName().strref() << "(";
-          displayLoc(os, loc.getChildLoc());
-          os << ")";
-        })
-        .Case<UnknownLoc>([&](auto loc) { os << "*"; })
-        .Case<CallSiteLoc>([&](auto loc) {
-          os << "(";
-          displayLoc(os, loc.getCallee());
-          os << " at ";
-          displayLoc(os, loc.getCaller());
-          os << ")";
-        })
-        .Default([&](auto loc) {
-          os << "Unknown " << loc->getAbstractAttribute().getName() << ": " << loc;
-        });
-  }
-
   // Print statistics on evaluating the validity polynomial.  This
   // analyzes ValidityTapsFunc, which as of this writing has all its
   // callees inlined, and CSE performed.  This allows us to count
@@ -215,6 +225,223 @@ void StatsPrinter::printOpCounts(FunctionOpInterface funcOp) {
   llvm::outs() << "\n";
 }
 
+// The field operations needed to evaluate some code once.
+struct Cost {
+  size_t add = 0;
+  size_t mul = 0;
+  size_t extAdd = 0;
+  size_t extMul = 0;
+  size_t inv = 0;
+  size_t load = 0;
+  size_t store = 0;
+  size_t externs = 0;
+
+  Cost& operator+=(const Cost& rhs) {
+    add += rhs.add;
+    mul += rhs.mul;
+    extAdd += rhs.extAdd;
+    extMul += rhs.extMul;
+    inv += rhs.inv;
+    load += rhs.load;
+    store += rhs.store;
+    externs += rhs.externs;
+    return *this;
+  }
+
+  Cost operator*(size_t count) const {
+    Cost out;
+    out.add = add * count;
+    out.mul = mul * count;
+    out.extAdd = extAdd * count;
+    out.extMul = extMul * count;
+    out.inv = inv * count;
+    out.load = load * count;
+    out.store = store * count;
+    out.externs = externs * count;
+    return out;
+  }
+
+  // A single figure to rank costs by, in units of a base field
+  // multiplication.  The weights are rough costs for BabyBear and its degree 4
+  // extension on a CPU; memory traffic and externs are not weighed.
+  size_t weight() const { return add / 2 + mul + extAdd * 2 + extMul * 16 + inv * 40; }
+
+  void print(llvm::json::OStream& json) const {
+    json.attribute("add", add);
+    json.attribute("mul", mul);
+    json.attribute("ext_add", extAdd);
+    json.attribute("ext_mul", extMul);
+    json.attribute("inv", inv);
+    json.attribute("load", load);
+    json.attribute("store", store);
+    json.attribute("extern", externs);
+    json.attribute("weight", weight());
+  }
+};
+
+// Estimates the cost of evaluating a function on one row.  Every op inside a
+// map or reduce is counted once per array element.  Only the most expensive
+// arm of a mux is counted, so step function costs are for the worst case row;
+// ops in other regions (such as nondet blocks) are always counted.
+class CostModel {
+public:
+  void addFunc(FunctionOpInterface funcOp) {
+    if (!funcOp.isExternal())
+      addRegion(funcOp.getFunctionBody(), /*count=*/1, /*attribute=*/true);
+  }
+
+  void print(llvm::json::OStream& json) {
+    json.attributeObject("cost", [&] { total.print(json); });
+
+    // As with constraint locations, leave out anything too small to matter
+    size_t threshold = total.weight() / 300;
+
+    auto components = llvm::to_vector(byComponent);
+    llvm::sort(components,
+               [](auto& a, auto& b) { return a.second.weight() > b.second.weight(); });
+    json.attributeArray("components", [&] {
+      for (auto& [name, cost] : components) {
+        if (cost.weight() < threshold)
+          break;
+        json.object([&, &name = name, &cost = cost] {
+          json.attribute("name", name);
+          cost.print(json);
+        });
+      }
+    });
+
+    auto locs = llvm::to_vector(byLoc);
+    llvm::sort(locs, [](auto& a, auto& b) { return a.second.weight() > b.second.weight(); });
+    json.attributeArray("locations", [&] {
+      for (auto& [loc, cost] : locs) {
+        if (cost.weight() < threshold)
+          break;
+        std::string locStr;
+        llvm::raw_string_ostream os(locStr);
+        displayLoc(os, loc);
+        json.object([&, &cost = cost] {
+          json.attribute("loc", os.str());
+          cost.print(json);
+        });
+      }
+    });
+  }
+
+private:
+  static Cost getOpCost(Operation* op) {
+    Cost cost;
+    bool ext = false;
+    if (op->getNumResults() == 1) {
+      auto valType = llvm::dyn_cast<Zll::ValType>(op->getResult(0).getType());
+      ext = valType && valType.getFieldK() > 1;
+    }
+    TypeSwitch<Operation*>(op)
+        .Case<Zll::AddOp, Zll::SubOp, Zll::NegOp, Zll::IsZeroOp>(
+            [&](auto) { (ext ? cost.extAdd : cost.add)++; })
+        .Case<Zll::MulOp>([&](auto) { (ext ? cost.extMul : cost.mul)++; })
+        .Case<Zll::PowOp>([&](Zll::PowOp op) {
+          // Square and multiply
+          uint32_t exp = op.getExponent();
+          size_t muls = exp > 1 ? llvm::Log2_32(exp) + llvm::popcount(exp) - 1 : 0;
+          (ext ? cost.extMul : cost.mul) += muls;
+        })
+        .Case<Zll::InvOp>([&](auto) { cost.inv++; })
+        .Case<Zll::AndEqzOp>([&](auto) {
+          cost.extAdd++;
+          cost.extMul++;
+        })
+        .Case<Zll::AndCondOp>([&](auto) {
+          cost.extAdd++;
+          cost.extMul += 2;
+        })
+        .Case<Zll::GetOp, Zll::GetGlobalOp, ZStruct::LoadOp>([&](auto) { cost.load++; })
+        .Case<Zll::SetOp, Zll::SetGlobalOp, ZStruct::StoreOp>([&](auto) { cost.store++; })
+        .Case<Zll::ExternOp>([&](auto) { cost.externs++; });
+    return cost;
+  }
+
+  // Adds the cost of evaluating `region` `count` times to `total`, and to the
+  // per location and component costs if `attribute` is set.  Returns the cost
+  // of a single evaluation.
+  Cost addRegion(Region& region, size_t count, bool attribute) {
+    Cost regionCost;
+    for (Block& block : region) {
+      for (Operation& op : block) {
+        regionCost += addOp(&op, count, attribute);
+      }
+    }
+    return regionCost;
+  }
+
+  Cost addOp(Operation* op, size_t count, bool attribute) {
+    Cost opCost = getOpCost(op);
+    if (attribute) {
+      Cost cost = opCost * count;
+      total += cost;
+      forEachAttributedLoc(op->getLoc(), [&](Location loc) { byLoc[loc] += cost; });
+      llvm::SmallSetVector<StringRef, 8> components;
+      collectComponents(op->getLoc(), components);
+      for (StringRef component : components) {
+        byComponent[component] += cost;
+      }
+    }
+
+    if (auto switchOp = llvm::dyn_cast<ZStruct::SwitchOp>(op)) {
+      Region* worstArm = nullptr;
+      Cost worstCost;
+      for (Region& arm : switchOp.getArms()) {
+        Cost armCost = addRegion(arm, count, /*attribute=*/false);
+        if (!worstArm || armCost.weight() > worstCost.weight()) {
+          worstArm = &arm;
+          worstCost = armCost;
+        }
+      }
+      if (worstArm && attribute)
+        addRegion(*worstArm, count, attribute);
+      opCost += worstCost;
+    } else if (llvm::isa<ZStruct::MapOp, ZStruct::ReduceOp>(op)) {
+      auto arrayType = llvm::cast<ZStruct::ArrayLikeTypeInterface>(op->getOperand(0).getType());
+      size_t size = arrayType.getSize();
+      opCost += addRegion(op->getRegion(0), count * size, attribute) * size;
+    } else if (auto callOp = llvm::dyn_cast<CallOpInterface>(op)) {
+      auto callee = llvm::dyn_cast_if_present<FunctionOpInterface>(callOp.resolveCallable());
+      if (callee && !callee.isExternal() && active.insert(callee).second) {
+        opCost += addRegion(callee.getFunctionBody(), count, attribute);
+        active.erase(callee);
+      }
+    } else {
+      for (Region& region : op->getRegions()) {
+        opCost += addRegion(region, count, attribute);
+      }
+    }
+    return opCost;
+  }
+
+  // Collects the names of the components `loc` was inlined from
+  static void collectComponents(Location loc, llvm::SmallSetVector<StringRef, 8>& components) {
+    TypeSwitch<Location>(loc)
+        .Case<NameLoc>([&](auto loc) {
+          components.insert(loc.getName().strref());
+          collectComponents(loc.getChildLoc(), components);
+        })
+        .Case<CallSiteLoc>([&](auto loc) {
+          collectComponents(loc.getCallee(), components);
+          collectComponents(loc.getCaller(), components);
+        })
+        .Case<FusedLoc>([&](auto loc) {
+          for (Location inner : loc.getLocations()) {
+            collectComponents(inner, components);
+          }
+        });
+  }
+
+  Cost total;
+  DenseMap<Location, Cost> byLoc;
+  llvm::MapVector<StringRef, Cost> byComponent;
+  // Functions currently being costed, to stop on recursive calls
+  DenseSet<Operation*> active;
+};
+
 } // namespace
 
 void printStats(mlir::ModuleOp moduleOp) {
@@ -225,4 +452,30 @@ void printStats(mlir::ModuleOp moduleOp) {
   printer.printValidityStats();
 }
 
+void printCostModel(mlir::ModuleOp moduleOp, mlir::ModuleOp stepFuncs, llvm::raw_ostream& os) {
+  llvm::SmallVector<std::pair<std::string, FunctionOpInterface>> funcs;
+  for (StringRef name : {"step$Top", "step$Top$accum"}) {
+    if (auto funcOp = stepFuncs.lookupSymbol<FunctionOpInterface>(name))
+      funcs.emplace_back(name.str(), funcOp);
+  }
+  moduleOp.walk([&](Zhlt::ValidityTapsFuncOp funcOp) {
+    funcs.emplace_back(SymbolTable::getSymbolName(funcOp).str(), funcOp);
+  });
+
+  llvm::json::OStream json(os, /*IndentSize=*/2);
+  json.object([&] {
+    json.attributeArray("functions", [&] {
+      for (auto& [name, funcOp] : funcs) {
+        CostModel model;
+        model.addFunc(funcOp);
+        json.object([&, &name = name] {
+          json.attribute("name", name);
+          model.print(json);
+        });
+      }
+    });
+  });
+  os << "\n";
+}
+
 } // namespace zirgen::dsl
@@ -19,4 +19,10 @@ namespace zirgen::dsl {
 // Displays some circuit-wide statistics for the given module.
 void printStats(mlir::ModuleOp moduleOp);
 
+// Writes a JSON estimate of the field operations needed to evaluate one row of
+// step$Top and step$Top$accum (from the lowered `stepFuncs`) and of the
+// validity polynomial (from `moduleOp`), attributed to the source locations and
+// components they come from.
+void printCostModel(mlir::ModuleOp moduleOp, mlir::ModuleOp stepFuncs, llvm::raw_ostream& os);
+
 } // namespace zirgen::dsl